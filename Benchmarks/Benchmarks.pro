@@ -0,0 +1,26 @@
+# benchmarks of every stage of the terrain and forest pipeline, on fixed fixtures, for measuring optimisations and
+# catching regressions. Results are written to benchmark_results.json as well as the console
+unix: LIBS+=-L/public/devel/lib -L/usr/local/lib -lbenchmark
+
+TARGET=Benchmarks
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG += thread
+CONFIG -= qt
+OBJECTS_DIR=obj
+DESTDIR=./
+
+SOURCES += main.cpp
+
+include($$PWD/../ForestCore/UseForestCore.pri)
+
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+        message("including $HOME/NGL")
+        include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+        message("Using custom NGL location")
+        include($(NGLDIR)/UseNGL.pri)
+}
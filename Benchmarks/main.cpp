@@ -0,0 +1,462 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file main.cpp
+/// @brief benchmarks of every stage of the terrain and forest pipeline. The fixtures are fixed - the two default
+/// species of NGLScene::initializeLSystems(), a larger stochastic grammar, and 1025, 2049 and 4097 terrains - so runs
+/// can be compared against each other. Each benchmark reports how many items per second it gets through, and the
+/// results are written to benchmark_results.json unless --benchmark_out says otherwise. With --count_allocations
+/// each benchmark also reports the heap allocations and bytes allocated per iteration and the peak resident set size
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+#include "Forest.h"
+#include "TerrainData.h"
+#include "TerrainGenerator.h"
+
+namespace
+{
+  //FIXTURES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief species 0 and 1 are the defaults of NGLScene::initializeLSystems(), and species 2 is a larger stochastic
+  /// grammar with several weighted choices per symbol - around 60000 symbols and 10000 vertices, which stays under
+  /// the GLshort index limit
+  //--------------------------------------------------------------------------------------------------------------------
+  LSystem species(int _index)
+  {
+    LSystem result;
+    switch(_index)
+    {
+      case 0:
+        result = LSystem("FFFA", {"A=\"[B]////[B]////B","B=&FFFA"}, 2, 0.9f, 30, 0.9f, 4);
+        break;
+      case 1:
+        result = LSystem("///A", {"A=F&[[A]^A]^F^[^FA]&A","F=FF"}, 1, 0.9f, 25, 0.9f, 6);
+        break;
+      default:
+        result = LSystem("FA", {"A=F[&A]/[^A]A:3", "A=F&[//A][^^A]A:2", "A=F[+A][-A]^A:2", "A=FA:1",
+                                "F=FF:1", "F=F:2"}, 3, 0.9f, 28, 0.95f, 18);
+        break;
+    }
+    result.m_useSeed = true;
+    result.m_seed = 1;
+    return result;
+  }
+
+  const int s_numHeroTrees = 10;
+  const float s_forestWidth = 2000.0f;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the default species with their instance caches filled, shared by the forest benchmarks
+  //--------------------------------------------------------------------------------------------------------------------
+  const std::vector<LSystem> &forestSpecies()
+  {
+    static std::vector<LSystem> treeTypes = []
+    {
+      std::vector<LSystem> types = {species(0), species(1)};
+      for(auto &type : types)
+      {
+        type.fillInstanceCache(s_numHeroTrees);
+      }
+      return types;
+    }();
+    return treeTypes;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a generated terrain of each dimension, made the first time it's asked for
+  //--------------------------------------------------------------------------------------------------------------------
+  TerrainGenerator &terrain(int _dimension)
+  {
+    static std::map<int, std::unique_ptr<TerrainGenerator>> terrains;
+    std::unique_ptr<TerrainGenerator> &result = terrains[_dimension];
+    if(!result)
+    {
+      result.reset(new TerrainGenerator(_dimension, s_forestWidth));
+      result->generate();
+    }
+    return *result;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a forest of _numTrees trees on the 1025 terrain, scattered by _scatterMode, with everything up to
+  /// createForest() done
+  //--------------------------------------------------------------------------------------------------------------------
+  Forest scatteredForest(size_t _numTrees, Forest::ScatterMode _scatterMode)
+  {
+    Forest forest;
+    forest.m_treeTypes = forestSpecies();
+    forest.m_width = s_forestWidth;
+    forest.m_length = s_forestWidth;
+    forest.m_numTrees = _numTrees;
+    forest.m_numHeroTrees = s_numHeroTrees;
+    forest.m_scatterMode = _scatterMode;
+    forest.m_terrainGen = terrain(1025);
+    forest.m_useSeed = true;
+    forest.m_seed = 1;
+    forest.scatterForest();
+    return forest;
+  }
+
+  void setRate(benchmark::State &_state, const char * _name, double _itemsPerIteration)
+  {
+    _state.counters[_name] = benchmark::Counter(_itemsPerIteration, benchmark::Counter::kIsIterationInvariantRate);
+  }
+
+  //ALLOCATION COUNTING
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief set by --count_allocations. The replaced operator new only counts while s_counting is set, which
+  /// AllocationCounter does around the timed loop of a benchmark
+  //--------------------------------------------------------------------------------------------------------------------
+  bool s_countAllocations = false;
+  std::atomic<bool> s_counting(false);
+  std::atomic<size_t> s_numAllocations(0);
+  std::atomic<size_t> s_allocatedBytes(0);
+
+  void countAllocation(size_t _bytes)
+  {
+    if(s_counting.load(std::memory_order_relaxed))
+    {
+      s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+      s_allocatedBytes.fetch_add(_bytes, std::memory_order_relaxed);
+    }
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief starts the peak resident set size again from the current one. Only Linux can do this, so elsewhere the
+  /// peak is that of the whole run so far
+  //--------------------------------------------------------------------------------------------------------------------
+  void resetPeakRSS()
+  {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs<<"5";
+#endif
+  }
+
+  double peakRSS()
+  {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    for(std::string line; std::getline(status, line);)
+    {
+      if(line.compare(0, 6, "VmHWM:") == 0)
+      {
+        return std::stod(line.substr(6))*1024.0;
+      }
+    }
+#endif
+#ifdef __unix__
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return double(usage.ru_maxrss)*1024.0;
+#else
+    return 0.0;
+#endif
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief made just before the timed loop of a benchmark, and adds the allocs, allocatedBytes and peakRSS counters
+  /// when it goes out of scope. Allocations between pause() and resume() aren't counted, which is for the untimed
+  /// set up some benchmarks do each iteration. Does nothing without --count_allocations
+  //--------------------------------------------------------------------------------------------------------------------
+  class AllocationCounter
+  {
+  public:
+    AllocationCounter(benchmark::State &_state) : m_state(_state)
+    {
+      if(s_countAllocations)
+      {
+        resetPeakRSS();
+        m_startAllocations = s_numAllocations.load();
+        m_startBytes = s_allocatedBytes.load();
+        resume();
+      }
+    }
+
+    ~AllocationCounter()
+    {
+      if(s_countAllocations)
+      {
+        pause();
+        m_state.counters["allocs"] = benchmark::Counter(double(s_numAllocations.load()-m_startAllocations),
+                                                        benchmark::Counter::kAvgIterations);
+        m_state.counters["allocatedBytes"] = benchmark::Counter(double(s_allocatedBytes.load()-m_startBytes),
+                                                                benchmark::Counter::kAvgIterations,
+                                                                benchmark::Counter::OneK::kIs1024);
+        m_state.counters["peakRSS"] = benchmark::Counter(peakRSS(), benchmark::Counter::kDefaults,
+                                                         benchmark::Counter::OneK::kIs1024);
+      }
+    }
+
+    void pause() { s_counting.store(false); }
+    void resume() { s_counting.store(s_countAllocations); }
+
+  private:
+    benchmark::State &m_state;
+    size_t m_startAllocations = 0;
+    size_t m_startBytes = 0;
+  };
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the global allocation functions, replaced so that --count_allocations sees every allocation. The sized,
+/// array and nothrow forms all end up in these two. GCC takes the free() in delete to be mismatched with new wherever
+/// it inlines one, but both are replaced together here
+//----------------------------------------------------------------------------------------------------------------------
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void * operator new(size_t _bytes)
+{
+  countAllocation(_bytes);
+  if(void * result = std::malloc(_bytes ? _bytes : 1))
+  {
+    return result;
+  }
+  throw std::bad_alloc();
+}
+
+void * operator new(size_t _bytes, std::align_val_t _alignment)
+{
+  countAllocation(_bytes);
+  //aligned_alloc wants a size that's a multiple of the alignment
+  size_t alignment = size_t(_alignment);
+  size_t size = (_bytes+alignment-1)/alignment*alignment;
+  if(void * result = std::aligned_alloc(alignment, size ? size : alignment))
+  {
+    return result;
+  }
+  throw std::bad_alloc();
+}
+
+void * operator new[](size_t _bytes) { return operator new(_bytes); }
+void * operator new[](size_t _bytes, std::align_val_t _alignment) { return operator new(_bytes, _alignment); }
+void operator delete(void * _p) noexcept { std::free(_p); }
+void operator delete[](void * _p) noexcept { std::free(_p); }
+void operator delete(void * _p, size_t) noexcept { std::free(_p); }
+void operator delete[](void * _p, size_t) noexcept { std::free(_p); }
+void operator delete(void * _p, std::align_val_t) noexcept { std::free(_p); }
+void operator delete[](void * _p, std::align_val_t) noexcept { std::free(_p); }
+void operator delete(void * _p, size_t, std::align_val_t) noexcept { std::free(_p); }
+void operator delete[](void * _p, size_t, std::align_val_t) noexcept { std::free(_p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+//L-SYSTEM BENCHMARKS
+//----------------------------------------------------------------------------------------------------------------------
+
+static void BM_generateTreeString(benchmark::State &_state)
+{
+  LSystem L = species(int(_state.range(0)));
+  size_t length = 0;
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    std::string tree = L.generateTreeString();
+    length = tree.size();
+    benchmark::DoNotOptimize(tree.data());
+  }
+  setRate(_state, "symbols", double(length));
+}
+BENCHMARK(BM_generateTreeString)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+static void BM_createGeometry(benchmark::State &_state)
+{
+  LSystem L = species(int(_state.range(0)));
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    L.createGeometry();
+    benchmark::DoNotOptimize(L.geometry().m_vertices.data());
+  }
+  setRate(_state, "vertices", double(L.geometry().m_vertices.size()));
+}
+BENCHMARK(BM_createGeometry)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+static void BM_addInstancingCommands(benchmark::State &_state)
+{
+  const LSystem original = species(int(_state.range(0)));
+  size_t numRHS = 0;
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    //the rules are rewritten in place, so each iteration starts from a fresh copy
+    _state.PauseTiming();
+    allocations.pause();
+    LSystem L = original;
+    allocations.resume();
+    _state.ResumeTiming();
+    L.addInstancingCommands();
+    numRHS = 0;
+    for(auto &rule : L.m_rules)
+    {
+      numRHS += rule.m_RHS.size();
+    }
+  }
+  setRate(_state, "rules", double(numRHS));
+}
+BENCHMARK(BM_addInstancingCommands)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+static void BM_fillInstanceCache(benchmark::State &_state)
+{
+  const LSystem original = species(int(_state.range(0)));
+  size_t numInstances = 0;
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    _state.PauseTiming();
+    allocations.pause();
+    LSystem L = original;
+    allocations.resume();
+    _state.ResumeTiming();
+    L.fillInstanceCache(s_numHeroTrees);
+    numInstances = L.heroTrees().m_instanceCache.size();
+  }
+  setRate(_state, "instances", double(numInstances));
+}
+BENCHMARK(BM_fillInstanceCache)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+//FOREST BENCHMARKS
+//----------------------------------------------------------------------------------------------------------------------
+
+static void BM_scatterForest(benchmark::State &_state)
+{
+  Forest forest = scatteredForest(size_t(_state.range(0)), Forest::ScatterMode(_state.range(1)));
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    forest.scatterForest();
+    benchmark::DoNotOptimize(forest.m_treeData.data());
+  }
+  setRate(_state, "trees", double(forest.m_treeData.size()));
+}
+BENCHMARK(BM_scatterForest)
+  ->ArgNames({"trees", "mode"})
+  ->ArgsProduct({{1000, 10000, 100000}, {Forest::UNIFORM, Forest::POISSON_DISK, Forest::DENSITY_MAP}})
+  ->Unit(benchmark::kMillisecond);
+
+static void BM_createForest(benchmark::State &_state)
+{
+  Forest forest = scatteredForest(size_t(_state.range(0)), Forest::UNIFORM);
+  size_t numInstances = 0;
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    forest.createForest();
+    numInstances = 0;
+    for(auto &cache : forest.m_transformCache)
+    {
+      numInstances += cache.m_transforms.size();
+    }
+  }
+  setRate(_state, "instances", double(numInstances));
+}
+BENCHMARK(BM_createForest)->ArgName("trees")->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+//TERRAIN BENCHMARKS
+//----------------------------------------------------------------------------------------------------------------------
+
+static void BM_TerrainGenerator_generate(benchmark::State &_state)
+{
+  int dimension = int(_state.range(0));
+  TerrainGenerator generator(dimension, s_forestWidth);
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    generator.generate();
+    benchmark::DoNotOptimize(generator.m_heightMap.data());
+  }
+  setRate(_state, "samples", double(dimension)*dimension);
+}
+BENCHMARK(BM_TerrainGenerator_generate)->ArgName("dimension")->Arg(1025)->Arg(2049)->Arg(4097)
+  ->Unit(benchmark::kMillisecond);
+
+static void BM_TerrainData_ctor(benchmark::State &_state)
+{
+  TerrainGenerator &generator = terrain(int(_state.range(0)));
+  size_t numVertices = 0;
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    TerrainData data(generator);
+    numVertices = data.m_vertices.size();
+    benchmark::DoNotOptimize(data.m_vertices.data());
+  }
+  setRate(_state, "vertices", double(numVertices));
+}
+BENCHMARK(BM_TerrainData_ctor)->ArgName("dimension")->Arg(1025)->Arg(2049)->Arg(4097)
+  ->Unit(benchmark::kMillisecond);
+
+static void BM_meshRefine(benchmark::State &_state)
+{
+  static std::map<int, std::unique_ptr<TerrainData>> terrainData;
+  int dimension = int(_state.range(0));
+  std::unique_ptr<TerrainData> &data = terrainData[dimension];
+  if(!data)
+  {
+    data.reset(new TerrainData(terrain(dimension)));
+  }
+  //the camera and tolerance NGLScene refines with, looking over the terrain from above one quadrant
+  ngl::Vec3 camera(s_forestWidth/4, s_forestWidth/4, 150);
+  AllocationCounter allocations(_state);
+  for(auto _ : _state)
+  {
+    data->meshRefine(camera, 0.02f, 100.0f);
+    benchmark::DoNotOptimize(data->m_indices.data());
+  }
+  //the refined mesh is a triangle strip, so every index after the first two adds a triangle
+  setRate(_state, "triangles", double(data->m_indices.size() > 2 ? data->m_indices.size()-2 : 0));
+}
+BENCHMARK(BM_meshRefine)->ArgName("dimension")->Arg(1025)->Arg(2049)->Arg(4097)->Unit(benchmark::kMillisecond);
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  //write JSON results next to the console output unless the caller chose where they go
+  std::vector<char *> arguments = {argv[0]};
+  bool hasOutput = false;
+  for(int i=1; i<argc; i++)
+  {
+    if(std::strcmp(argv[i], "--count_allocations") == 0)
+    {
+      s_countAllocations = true;
+      continue;
+    }
+    hasOutput |= std::strncmp(argv[i], "--benchmark_out=", 16) == 0;
+    arguments.push_back(argv[i]);
+  }
+  char out[] = "--benchmark_out=benchmark_results.json";
+  char format[] = "--benchmark_out_format=json";
+  if(!hasOutput)
+  {
+    arguments.push_back(out);
+    arguments.push_back(format);
+  }
+  int numArguments = int(arguments.size());
+
+  benchmark::Initialize(&numArguments, arguments.data());
+  if(benchmark::ReportUnrecognizedArguments(numArguments, arguments.data()))
+  {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
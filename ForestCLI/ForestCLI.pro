@@ -0,0 +1,26 @@
+# command line forest generator - runs the whole terrain and forest pipeline without a display, eg. on render farm
+# nodes, and writes the results to disk
+TARGET=ForestCLI
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG += thread
+# where to put the .o files
+OBJECTS_DIR=obj
+DESTDIR=./
+
+SOURCES += main.cpp
+
+# ForestCore has to come before NGL on the link line, since it uses the ngl maths types
+include($$PWD/../ForestCore/UseForestCore.pri)
+
+#add UseNGL.pri
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+        message("including $HOME/NGL")
+        include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+        message("Using custom NGL location")
+        include($(NGLDIR)/UseNGL.pri)
+}
@@ -0,0 +1,398 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file main.cpp
+/// @brief command line forest generator - runs the terrain and forest pipeline of ForestCore without a window or an
+/// OpenGL context, writes the results to disk and prints how long each stage took
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Forest.h"
+#include "InstanceCacheFile.h"
+#include "Trace.h"
+
+namespace
+{
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief everything read from the command line and the parameter file
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Parameters
+  {
+    std::string m_outputDirectory = "forestOutput";
+    std::string m_cacheDirectory;
+    std::string m_traceFile;
+    bool m_printMemory = false;
+    float m_width = 2000;
+    float m_length = 2000;
+    size_t m_numTrees = 1000;
+    int m_numHeroTrees = 10;
+    Forest::ScatterMode m_scatterMode = Forest::UNIFORM;
+    size_t m_numThreads = 0;
+    float m_tileSize = 250;
+    ForestTileWriter::Compression m_compression = ForestTileWriter::ZLIB;
+    bool m_useSeed = false;
+    size_t m_seed = 0;
+    TerrainGenerator m_terrain = TerrainGenerator(1025, 2000);
+    std::vector<LSystem> m_species;
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the grammar and turtle parameters of a species, gathered before its LSystem is built
+  //--------------------------------------------------------------------------------------------------------------------
+  struct SpeciesParameters
+  {
+    std::string m_name;
+    std::string m_axiom;
+    std::vector<std::string> m_rules;
+    float m_stepSize = 1;
+    float m_stepScale = 0.9f;
+    float m_angle = 30;
+    float m_angleScale = 0.9f;
+    int m_generation = 4;
+    bool m_useSeed = false;
+    size_t m_seed = 0;
+    float m_instancingProb = 0.6f;
+    float m_scatterRadius = 50.0f;
+
+    LSystem build() const
+    {
+      LSystem species(m_axiom, m_rules, m_stepSize, m_stepScale, m_angle, m_angleScale, m_generation);
+      species.m_name = m_name;
+      species.m_useSeed = m_useSeed;
+      species.m_seed = m_seed;
+      species.m_instancingProb = m_instancingProb;
+      species.m_scatterRadius = m_scatterRadius;
+      return species;
+    }
+  };
+
+  void printUsage()
+  {
+    std::cout<<"usage: ForestCLI [options]\n"
+             <<"  -p, --parameters FILE   read terrain, forest and species parameters from FILE\n"
+             <<"  -o, --output DIR        directory to write results to (default forestOutput)\n"
+             <<"  -c, --cache DIR         reuse the instance caches of seeded species from DIR\n"
+             <<"  -t, --threads N         worker threads, 0 for one per hardware thread (default 0)\n"
+             <<"  -s, --tile-size SIZE    side of the exported forest tiles (default 250)\n"
+             <<"      --no-compression    store the exported tiles uncompressed\n"
+             <<"      --trace FILE        write a Chrome trace of the run to FILE (builds with tracing only)\n"
+             <<"      --memory            print the memory held by each part of the forest\n"
+             <<"  -h, --help              show this message\n\n"
+             <<"The parameter file has one \"key value\" pair per line, and # starts a comment. Keys before the first\n"
+             <<"\"species NAME\" line set up the terrain and forest:\n"
+             <<"  width length trees heroTrees seed scatter(uniform|poisson|density)\n"
+             <<"  terrainDimension terrainSeed octaves frequency persistence lacunarity amplitude\n"
+             <<"and keys after it set up that species:\n"
+             <<"  axiom rule(repeatable) stepSize stepScale angle angleScale generation seed instancingProb\n"
+             <<"  scatterRadius\n"
+             <<"Without a parameter file, the two default species of the GUI are grown.\n";
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the default species of NGLScene::initializeLSystems()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<LSystem> defaultSpecies()
+  {
+    SpeciesParameters species0;
+    species0.m_name = "tree0";
+    species0.m_axiom = "FFFA";
+    species0.m_rules = {"A=\"[B]////[B]////B","B=&FFFA"};
+    species0.m_stepSize = 2;
+    species0.m_generation = 4;
+
+    SpeciesParameters species1;
+    species1.m_name = "tree1";
+    species1.m_axiom = "///A";
+    species1.m_rules = {"A=F&[[A]^A]^F^[^FA]&A","F=FF"};
+    species1.m_stepSize = 1;
+    species1.m_angle = 25;
+    species1.m_generation = 6;
+
+    return {species0.build(), species1.build()};
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief reads the parameter file at _path into _parameters, printing the problem and returning false if it
+  /// can't be read
+  //--------------------------------------------------------------------------------------------------------------------
+  bool readParameters(const std::string &_path, Parameters &_parameters)
+  {
+    std::ifstream file(_path);
+    if(!file)
+    {
+      std::cerr<<"can't open parameter file "<<_path<<"\n";
+      return false;
+    }
+    std::vector<SpeciesParameters> species;
+    std::string line;
+    for(int lineNumber=1; std::getline(file, line); lineNumber++)
+    {
+      line = line.substr(0, line.find('#'));
+      std::istringstream stream(line);
+      std::string key;
+      if(!(stream>>key))
+      {
+        continue;
+      }
+      std::string value;
+      std::getline(stream>>std::ws, value);
+      while(!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+      {
+        value.pop_back();
+      }
+      std::istringstream valueStream(value);
+      auto read = [&](auto &_value){ return bool(valueStream>>_value); };
+
+      bool ok = true;
+      if(key == "species")
+      {
+        species.push_back(SpeciesParameters());
+        species.back().m_name = value.empty() ? "tree"+std::to_string(species.size()-1) : value;
+      }
+      else if(!species.empty())
+      {
+        SpeciesParameters &s = species.back();
+        if(key == "axiom") { s.m_axiom = value; ok = !value.empty(); }
+        else if(key == "rule") { s.m_rules.push_back(value); ok = !value.empty(); }
+        else if(key == "stepSize") { ok = read(s.m_stepSize); }
+        else if(key == "stepScale") { ok = read(s.m_stepScale); }
+        else if(key == "angle") { ok = read(s.m_angle); }
+        else if(key == "angleScale") { ok = read(s.m_angleScale); }
+        else if(key == "generation") { ok = read(s.m_generation); }
+        else if(key == "seed") { ok = read(s.m_seed); s.m_useSeed = true; }
+        else if(key == "instancingProb") { ok = read(s.m_instancingProb); }
+        else if(key == "scatterRadius") { ok = read(s.m_scatterRadius); }
+        else { ok = false; }
+      }
+      else
+      {
+        TerrainGenerator &terrain = _parameters.m_terrain;
+        if(key == "width") { ok = read(_parameters.m_width); }
+        else if(key == "length") { ok = read(_parameters.m_length); }
+        else if(key == "trees") { ok = read(_parameters.m_numTrees); }
+        else if(key == "heroTrees") { ok = read(_parameters.m_numHeroTrees); }
+        else if(key == "seed") { ok = read(_parameters.m_seed); _parameters.m_useSeed = true; }
+        else if(key == "scatter")
+        {
+          if(value == "uniform") { _parameters.m_scatterMode = Forest::UNIFORM; }
+          else if(value == "poisson") { _parameters.m_scatterMode = Forest::POISSON_DISK; }
+          else if(value == "density") { _parameters.m_scatterMode = Forest::DENSITY_MAP; }
+          else { ok = false; }
+        }
+        else if(key == "terrainDimension") { ok = read(terrain.m_dimension); }
+        else if(key == "terrainSeed") { ok = read(terrain.m_seed); }
+        else if(key == "octaves") { ok = read(terrain.m_octaves); }
+        else if(key == "frequency") { ok = read(terrain.m_frequency); }
+        else if(key == "persistence") { ok = read(terrain.m_persistence); }
+        else if(key == "lacunarity") { ok = read(terrain.m_lacunarity); }
+        else if(key == "amplitude") { ok = read(terrain.m_amplitude); }
+        else { ok = false; }
+      }
+      if(!ok)
+      {
+        std::cerr<<_path<<":"<<lineNumber<<": can't use \""<<key<<" "<<value<<"\"\n";
+        return false;
+      }
+    }
+
+    for(auto &s : species)
+    {
+      if(s.m_axiom.empty())
+      {
+        std::cerr<<_path<<": species "<<s.m_name<<" has no axiom\n";
+        return false;
+      }
+      _parameters.m_species.push_back(s.build());
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief reads the command line into _parameters, returning false if the program should stop, with _exitCode
+  //--------------------------------------------------------------------------------------------------------------------
+  bool readArguments(int _argc, char **_argv, Parameters &_parameters, int &_exitCode)
+  {
+    _exitCode = EXIT_FAILURE;
+    for(int i=1; i<_argc; i++)
+    {
+      std::string argument = _argv[i];
+      if(argument == "-h" || argument == "--help")
+      {
+        printUsage();
+        _exitCode = EXIT_SUCCESS;
+        return false;
+      }
+      if(argument == "--no-compression")
+      {
+        _parameters.m_compression = ForestTileWriter::NONE;
+        continue;
+      }
+      if(argument == "--memory")
+      {
+        _parameters.m_printMemory = true;
+        continue;
+      }
+
+      std::vector<std::string> valueOptions = {"-p", "--parameters", "-o", "--output", "-c", "--cache",
+                                               "-t", "--threads", "-s", "--tile-size", "--trace"};
+      if(std::find(valueOptions.begin(), valueOptions.end(), argument) == valueOptions.end())
+      {
+        std::cerr<<"unknown option "<<argument<<"\n";
+        printUsage();
+        return false;
+      }
+      if(i+1 >= _argc)
+      {
+        std::cerr<<argument<<" needs a value\n";
+        return false;
+      }
+      std::string value = _argv[++i];
+      if(argument == "-p" || argument == "--parameters")
+      {
+        if(!readParameters(value, _parameters))
+        {
+          return false;
+        }
+      }
+      else if(argument == "-o" || argument == "--output") { _parameters.m_outputDirectory = value; }
+      else if(argument == "-c" || argument == "--cache") { _parameters.m_cacheDirectory = value; }
+      else if(argument == "--trace") { _parameters.m_traceFile = value; }
+      else if(argument == "-t" || argument == "--threads") { _parameters.m_numThreads = std::stoul(value); }
+      else { _parameters.m_tileSize = std::stof(value); }
+    }
+    return true;
+  }
+
+  void printTime(const std::string &_stage, double _milliseconds)
+  {
+    std::cout<<"  "<<std::left<<std::setw(20)<<_stage<<std::right<<std::setw(12)<<std::fixed<<std::setprecision(2)
+             <<_milliseconds<<" ms\n";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+  Parameters parameters;
+  int exitCode;
+  try
+  {
+    if(!readArguments(argc, argv, parameters, exitCode))
+    {
+      return exitCode;
+    }
+  }
+  catch(const std::exception &)
+  {
+    std::cerr<<"bad numeric option\n";
+    return EXIT_FAILURE;
+  }
+  if(parameters.m_species.empty())
+  {
+    parameters.m_species = defaultSpecies();
+  }
+  //the terrain spans the forest's width, with m_dimension heightmap samples along each side
+  parameters.m_terrain.m_scale = parameters.m_width/parameters.m_terrain.m_dimension;
+
+  std::error_code error;
+  std::filesystem::create_directories(parameters.m_outputDirectory, error);
+  if(error)
+  {
+    std::cerr<<"can't create output directory "<<parameters.m_outputDirectory<<"\n";
+    return EXIT_FAILURE;
+  }
+
+  //keys have to come from the species as given, since growing their hero trees rewrites their rules
+  std::vector<uint64_t> keys;
+  for(auto &species : parameters.m_species)
+  {
+    keys.push_back(InstanceCacheFile::key(species, parameters.m_numHeroTrees));
+  }
+
+  //a default forest, so the seed and thread count can be set before the pipeline runs
+  Forest forest;
+  forest.m_treeTypes = parameters.m_species;
+  forest.m_width = parameters.m_width;
+  forest.m_length = parameters.m_length;
+  forest.m_numTrees = parameters.m_numTrees;
+  forest.m_numHeroTrees = parameters.m_numHeroTrees;
+  forest.m_scatterMode = parameters.m_scatterMode;
+  forest.m_cacheDirectory = parameters.m_cacheDirectory;
+  forest.m_terrainGen = parameters.m_terrain;
+  forest.m_useSeed = parameters.m_useSeed;
+  forest.m_seed = parameters.m_seed;
+  forest.m_numThreads = parameters.m_numThreads;
+  auto start = std::chrono::steady_clock::now();
+  forest.generate();
+  std::chrono::duration<double,std::milli> total = std::chrono::steady_clock::now()-start;
+
+  std::vector<std::pair<std::string,double>> stageTimes = forest.m_stageTimes;
+  auto timeStage = [&](const char * _stage, auto _function)
+  {
+    FOREST_TRACE_ZONE(_stage);
+    auto stageStart = std::chrono::steady_clock::now();
+    bool ok = _function();
+    std::chrono::duration<double,std::milli> time = std::chrono::steady_clock::now()-stageStart;
+    stageTimes.push_back({_stage, time.count()});
+    total += time;
+    return ok;
+  };
+
+  std::filesystem::path output(parameters.m_outputDirectory);
+  bool ok = timeStage("write terrain", [&]
+  {
+    std::ofstream file(output/"terrain.f32", std::ios::binary | std::ios::trunc);
+    const std::vector<float> &heights = forest.m_terrainGen.m_heightMap;
+    file.write(reinterpret_cast<const char *>(heights.data()), std::streamsize(heights.size()*sizeof(float)));
+    return bool(file);
+  });
+  ok = timeStage("write species", [&]
+  {
+    bool written = true;
+    for(size_t i=0; i<forest.m_treeTypes.size(); i++)
+    {
+      const LSystem &species = forest.m_treeTypes[i];
+      std::string name = species.m_name.empty() ? "tree"+std::to_string(i) : species.m_name;
+      written &= InstanceCacheFile::write((output/(name+".ficache")).string(), keys[i], species);
+    }
+    return written;
+  }) && ok;
+  ok = timeStage("write forest", [&]
+  {
+    return forest.exportTiles((output/"forest.fgtiles").string(), parameters.m_tileSize, parameters.m_compression);
+  }) && ok;
+
+  std::cout<<"terrain "<<forest.m_terrainGen.m_dimension<<"x"<<forest.m_terrainGen.m_dimension<<", "
+           <<forest.m_treeData.size()<<" trees of "<<forest.m_treeTypes.size()<<" species\n";
+  for(auto &stage : stageTimes)
+  {
+    printTime(stage.first, stage.second);
+  }
+  printTime("total", total.count());
+  if(parameters.m_printMemory)
+  {
+    std::cout<<"memory:\n";
+    forest.memoryUsage().print(std::cout);
+  }
+
+  if(!ok)
+  {
+    std::cerr<<"failed to write some results to "<<parameters.m_outputDirectory<<"\n";
+    return EXIT_FAILURE;
+  }
+  if(!parameters.m_traceFile.empty() && !Trace::write(parameters.m_traceFile))
+  {
+    std::cerr<<"failed to write trace file "<<parameters.m_traceFile<<"\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
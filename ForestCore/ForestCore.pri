@@ -0,0 +1,61 @@
+# the sources of the ForestCore library - everything that generates terrain and forests, without Qt widgets or an
+# OpenGL context. Paths are cleaned so that projects can remove these from their own lists of sources
+FOREST_CORE_DIR = $$clean_path($$PWD/../ForestGenerator)
+
+FOREST_CORE_SOURCES = $$FOREST_CORE_DIR/src/DensityMap.cpp \
+                      $$FOREST_CORE_DIR/src/Forest.cpp \
+                      $$FOREST_CORE_DIR/src/ForestTileReader.cpp \
+                      $$FOREST_CORE_DIR/src/ForestTileWriter.cpp \
+                      $$FOREST_CORE_DIR/src/Frustum.cpp \
+                      $$FOREST_CORE_DIR/src/Heightmap.cpp \
+                      $$FOREST_CORE_DIR/src/Instance.cpp \
+                      $$FOREST_CORE_DIR/src/InstanceCacheFile.cpp \
+                      $$FOREST_CORE_DIR/src/LSystem.cpp \
+                      $$FOREST_CORE_DIR/src/LSystem_CreateGeometry.cpp \
+                      $$FOREST_CORE_DIR/src/LSystem_InstanceMethods.cpp \
+                      $$FOREST_CORE_DIR/src/MemoryReport.cpp \
+                      $$FOREST_CORE_DIR/src/PoissonDiskSampler.cpp \
+                      $$FOREST_CORE_DIR/src/ScratchArena.cpp \
+                      $$FOREST_CORE_DIR/src/SpatialGrid.cpp \
+                      $$FOREST_CORE_DIR/src/TerrainData.cpp \
+                      $$FOREST_CORE_DIR/src/TerrainGenerator.cpp \
+                      $$FOREST_CORE_DIR/src/Trace.cpp
+
+FOREST_CORE_HEADERS = $$FOREST_CORE_DIR/include/AffineTransform.h \
+                      $$FOREST_CORE_DIR/include/BackgroundBuild.h \
+                      $$FOREST_CORE_DIR/include/DensityMap.h \
+                      $$FOREST_CORE_DIR/include/Forest.h \
+                      $$FOREST_CORE_DIR/include/ForestTileReader.h \
+                      $$FOREST_CORE_DIR/include/ForestTileWriter.h \
+                      $$FOREST_CORE_DIR/include/Frustum.h \
+                      $$FOREST_CORE_DIR/include/Hash.h \
+                      $$FOREST_CORE_DIR/include/Heightmap.h \
+                      $$FOREST_CORE_DIR/include/Instance.h \
+                      $$FOREST_CORE_DIR/include/InstanceCache.h \
+                      $$FOREST_CORE_DIR/include/InstanceCacheFile.h \
+                      $$FOREST_CORE_DIR/include/LSystem.h \
+                      $$FOREST_CORE_DIR/include/MemoryReport.h \
+                      $$FOREST_CORE_DIR/include/ParallelFor.h \
+                      $$FOREST_CORE_DIR/include/PoissonDiskSampler.h \
+                      $$FOREST_CORE_DIR/include/PreferenceCurve.h \
+                      $$FOREST_CORE_DIR/include/RandomStream.h \
+                      $$FOREST_CORE_DIR/include/ScratchArena.h \
+                      $$FOREST_CORE_DIR/include/SpatialGrid.h \
+                      $$FOREST_CORE_DIR/include/TerrainData.h \
+                      $$FOREST_CORE_DIR/include/TerrainGenerator.h \
+                      $$FOREST_CORE_DIR/include/Trace.h
+
+# the core headers, and the boost and noiseutils headers they use
+INCLUDEPATH += $$FOREST_CORE_DIR/include \
+               $$FOREST_CORE_DIR/include/boost \
+               $$FOREST_CORE_DIR/include/noiseutils
+
+# libnoise headers
+unix: INCLUDEPATH += $$(HOME)/libnoise/include
+win32:INCLUDEPATH += $(HOME)/Users/Ben/Libnoise/include
+
+# zlib compresses the chunks of forest exports, which are stored uncompressed without it
+unix: DEFINES += FOREST_USE_ZLIB
+
+# qmake CONFIG+=forest_tracing compiles in the FOREST_TRACE_ZONE and FOREST_TRACE_COUNTER instrumentation (see Trace.h)
+forest_tracing: DEFINES += FOREST_TRACING
@@ -0,0 +1,27 @@
+# static library of the terrain and forest generation code, shared by the GUI and the command line generator
+TARGET=ForestCore
+TEMPLATE=lib
+CONFIG+=staticlib
+# where to put the .o files
+OBJECTS_DIR=obj
+# the library goes in the build directory, where UseForestCore.pri looks for it
+DESTDIR=./
+
+# std::pmr (used for the L-system scratch arenas) and std::filesystem need c++17
+CONFIG += c++17
+CONFIG -= app_bundle
+
+include($$PWD/ForestCore.pri)
+SOURCES += $$FOREST_CORE_SOURCES
+HEADERS += $$FOREST_CORE_HEADERS
+
+#add UseNGL.pri
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+        message("including $HOME/NGL")
+        include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+        message("Using custom NGL location")
+        include($(NGLDIR)/UseNGL.pri)
+}
@@ -0,0 +1,16 @@
+# include this to build against the ForestCore static library - it adds the core headers and links the library
+# along with the libraries it depends on, which have to come after it on the link line
+include($$PWD/ForestCore.pri)
+
+FOREST_CORE_LIB_DIR = $$clean_path($$OUT_PWD/../ForestCore)
+LIBS += -L$$FOREST_CORE_LIB_DIR -lForestCore
+unix: PRE_TARGETDEPS += $$FOREST_CORE_LIB_DIR/libForestCore.a
+win32: PRE_TARGETDEPS += $$FOREST_CORE_LIB_DIR/ForestCore.lib
+
+#add libnoise library
+unix: LIBS += -L$$(HOME)/libnoise/lib -lnoise -lnoiseutils
+
+win32:CONFIG(release, debug|release): LIBS += -L$(HOME)/Users/Ben/Libnoise/bin/ -llibnoise
+else:win32:CONFIG(debug, debug|release): LIBS += -L$(HOME)/Users/Ben/Libnoise/bin/ -llibnoised
+
+unix: LIBS += -lz
@@ -19,11 +19,13 @@ isEqual(QT_MAJOR_VERSION, 5) {
 CONFIG-=app_bundle
 # were are going to default to a console app
 CONFIG += console
+# std::pmr (used for the L-system scratch arenas) needs c++17
+CONFIG += c++17
 
-# Auto include all .cpp files in the project src directory
-SOURCES+= $$PWD/src/*.cpp
+# Auto include all .cpp files in the project src directory, apart from the ones built into ForestCore
+SOURCES+= $$files($$PWD/src/*.cpp)
 # same for the .h files
-HEADERS+= $$PWD/include/*.h
+HEADERS+= $$files($$PWD/include/*.h)
 #and for .ui files
 FORMS += $$PWD/ui/*.ui
 OTHER_FILES+= README.md \
@@ -45,11 +47,7 @@ else{ # note brace must be here
         include($(NGLDIR)/UseNGL.pri)
 }
 
-#add libnoise library
-unix: LIBS += -L$$(HOME)/libnoise/lib -lnoise -lnoiseutils
-unix: INCLUDEPATH += $$(HOME)/libnoise/include
-
-win32:CONFIG(release, debug|release): LIBS += -L$(HOME)/Users/Ben/Libnoise/bin/ -llibnoise
-else:win32:CONFIG(debug, debug|release): LIBS += -L$(HOME)/Users/Ben/Libnoise/bin/ -llibnoised
-
-win32:INCLUDEPATH += $(HOME)/Users/Ben/Libnoise/include
+#link the terrain and forest generation code from ForestCore, which brings libnoise and zlib with it
+include($$PWD/../ForestCore/UseForestCore.pri)
+SOURCES -= $$FOREST_CORE_SOURCES
+HEADERS -= $$FOREST_CORE_HEADERS
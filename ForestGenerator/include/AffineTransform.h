@@ -0,0 +1,122 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AffineTransform.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef AFFINETRANSFORM_H_
+#define AFFINETRANSFORM_H_
+
+#include <algorithm>
+#include <cmath>
+#include <ngl/Mat4.h>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class AffineTransform
+/// @brief compact storage for an affine ngl::Mat4. Every transform built by the turtle or the forest scatter has
+/// (0,0,0,1) as its last column, so only the 4x3 block of basis vectors and translation is kept - 48 bytes instead of
+/// 64. This is also the per-instance layout of the forest's GPU instance buffers, where ForestVertex.glsl rebuilds the
+/// mat4 from the four rows
+//----------------------------------------------------------------------------------------------------------------------
+
+struct AffineTransform
+{
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for AffineTransform struct - gives the identity
+  //--------------------------------------------------------------------------------------------------------------------
+  AffineTransform() : AffineTransform(ngl::Mat4()) {}
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor for AffineTransform struct, dropping the last column of _m
+  //--------------------------------------------------------------------------------------------------------------------
+  AffineTransform(const ngl::Mat4 &_m)
+  {
+    for(int i=0; i<4; i++)
+    {
+      for(int j=0; j<3; j++)
+      {
+        m_m[i][j] = _m.m_m[i][j];
+      }
+    }
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief expands back to an ngl::Mat4 with (0,0,0,1) as the last column
+  //--------------------------------------------------------------------------------------------------------------------
+  ngl::Mat4 toMat4() const
+  {
+    return ngl::Mat4(m_m[0][0], m_m[0][1], m_m[0][2], 0,
+                     m_m[1][0], m_m[1][1], m_m[1][2], 0,
+                     m_m[2][0], m_m[2][1], m_m[2][2], 0,
+                     m_m[3][0], m_m[3][1], m_m[3][2], 1);
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief transforms _p the same way the forest shader does: _p.x*row0 + _p.y*row1 + _p.z*row2 + row3
+  //--------------------------------------------------------------------------------------------------------------------
+  ngl::Vec3 transformPoint(const ngl::Vec3 &_p) const
+  {
+    return ngl::Vec3(_p.m_x*m_m[0][0] + _p.m_y*m_m[1][0] + _p.m_z*m_m[2][0] + m_m[3][0],
+                     _p.m_x*m_m[0][1] + _p.m_y*m_m[1][1] + _p.m_z*m_m[2][1] + m_m[3][1],
+                     _p.m_x*m_m[0][2] + _p.m_y*m_m[1][2] + _p.m_z*m_m[2][2] + m_m[3][2]);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the length of the longest basis vector - the most the transform can scale a bounding sphere by
+  //--------------------------------------------------------------------------------------------------------------------
+  float maxScale() const
+  {
+    float scale = 0.0f;
+    for(int i=0; i<3; i++)
+    {
+      scale = std::max(scale, m_m[i][0]*m_m[i][0] + m_m[i][1]*m_m[i][1] + m_m[i][2]*m_m[i][2]);
+    }
+    return std::sqrt(scale);
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief scales the basis vectors by _scale, so that the transform first scales uniformly about the origin
+  //--------------------------------------------------------------------------------------------------------------------
+  void scaleBasis(float _scale)
+  {
+    for(int i=0; i<3; i++)
+    {
+      for(int j=0; j<3; j++)
+      {
+        m_m[i][j] *= _scale;
+      }
+    }
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief rows are the same as those of ngl::Mat4: three basis vectors then the translation
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_m[4][3];
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief computes _out[i] = _root * _in[i] for _n transforms, using ngl's multiplication convention.
+/// Written out over plain float arrays rather than calling ngl::Mat4::operator* so that the compiler can vectorise it
+/// across the batch, and so the known (0,0,0,1) columns aren't multiplied through
+//----------------------------------------------------------------------------------------------------------------------
+inline void multiplyBatch(const AffineTransform &_root, const AffineTransform * _in, size_t _n,
+                          AffineTransform * _out)
+{
+  const float (&root)[4][3] = _root.m_m;
+  for(size_t n=0; n<_n; n++)
+  {
+    const float (&in)[4][3] = _in[n].m_m;
+    float (&out)[4][3] = _out[n].m_m;
+    for(int i=0; i<4; i++)
+    {
+      for(int j=0; j<3; j++)
+      {
+        out[i][j] = in[i][0]*root[0][j] + in[i][1]*root[1][j] + in[i][2]*root[2][j];
+      }
+    }
+    for(int j=0; j<3; j++)
+    {
+      out[3][j] += root[3][j];
+    }
+  }
+}
+
+#endif //AFFINETRANSFORM_H_
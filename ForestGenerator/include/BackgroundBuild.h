@@ -0,0 +1,240 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file BackgroundBuild.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef BACKGROUNDBUILD_H_
+#define BACKGROUNDBUILD_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class BuildProgress
+/// @brief shared between a build running on a worker thread and the thread that started it. The build reports which
+/// stage it's on and how far through it is, and checks cancelled() between steps so it can give up early. _stage
+/// must be a string literal, since only the pointer is kept
+//----------------------------------------------------------------------------------------------------------------------
+
+class BuildProgress
+{
+public:
+  void set(const char * _stage, float _fraction)
+  {
+    m_stage.store(_stage, std::memory_order_relaxed);
+    m_fraction.store(_fraction, std::memory_order_relaxed);
+  }
+  const char * stage() const { return m_stage.load(std::memory_order_relaxed); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief how much of the whole build is done, from 0 to 1
+  //--------------------------------------------------------------------------------------------------------------------
+  float fraction() const { return m_fraction.load(std::memory_order_relaxed); }
+
+  void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+  bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief set by BackgroundBuild once the worker has finished, whether or not the result was kept
+  //--------------------------------------------------------------------------------------------------------------------
+  void finish() { m_finished.store(true, std::memory_order_release); }
+  bool finished() const { return m_finished.load(std::memory_order_acquire); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief set by BackgroundBuild before finish() if the job threw, with what it threw. Only read it once finished()
+  /// is true, which makes the write visible
+  //--------------------------------------------------------------------------------------------------------------------
+  void fail(const std::string &_error) { m_error = _error; m_failed = true; }
+  bool failed() const { return finished() && m_failed; }
+  const std::string &error() const { return m_error; }
+
+private:
+  std::atomic<const char *> m_stage{""};
+  std::atomic<float> m_fraction{0.0f};
+  std::atomic<bool> m_cancelled{false};
+  std::atomic<bool> m_finished{false};
+  bool m_failed = false;
+  std::string m_error;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class BackgroundBuild
+/// @brief runs jobs that build a T on worker threads, for keeping slow rebuilds off the GUI thread. Starting a job
+/// cancels the one before it, so only the newest job's result is ever handed over. The finished T is published with
+/// an atomic pointer swap and the owner picks it up with take() whenever it next looks, for example once a frame,
+/// so it never waits on the worker. Jobs must capture everything they use by value, as they run alongside the owner.
+/// A job that throws publishes nothing, and its progress reports the error instead
+//----------------------------------------------------------------------------------------------------------------------
+
+template <class T>
+class BackgroundBuild
+{
+public:
+  using Job = std::function<T(BuildProgress &)>;
+
+  BackgroundBuild() = default;
+  BackgroundBuild(const BackgroundBuild &) = delete;
+  BackgroundBuild &operator=(const BackgroundBuild &) = delete;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief cancels the running job and waits for every worker, so jobs should check for cancellation often
+  //--------------------------------------------------------------------------------------------------------------------
+  ~BackgroundBuild()
+  {
+    cancel();
+    for(auto &worker : m_workers)
+    {
+      worker.m_thread.join();
+    }
+    delete m_result.exchange(nullptr);
+  }
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief cancels the current job, throws away any result that hasn't been taken, and starts _job on a new thread
+  //--------------------------------------------------------------------------------------------------------------------
+  void start(Job _job)
+  {
+    std::shared_ptr<BuildProgress> progress = std::make_shared<BuildProgress>();
+    uint64_t generation;
+    T * stale;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_progress)
+      {
+        m_progress->cancel();
+      }
+      m_progress = progress;
+      generation = ++m_generation;
+      stale = m_result.exchange(nullptr);
+    }
+    delete stale;
+    joinFinishedWorkers();
+    m_workers.push_back({std::thread(&BackgroundBuild::run, this, std::move(_job), progress, generation), progress});
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief cancels the current job, without waiting for it to stop, and throws away any result that hasn't been taken
+  //--------------------------------------------------------------------------------------------------------------------
+  void cancel()
+  {
+    T * stale;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_progress)
+      {
+        m_progress->cancel();
+        m_progress.reset();
+      }
+      m_generation++;
+      stale = m_result.exchange(nullptr);
+    }
+    delete stale;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the finished result of the newest job, or nothing if it isn't ready or has already been taken
+  //--------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<T> take()
+  {
+    std::unique_ptr<T> result(m_result.exchange(nullptr, std::memory_order_acquire));
+    if(result)
+    {
+      joinFinishedWorkers();
+    }
+    return result;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief whether the newest job is still running, and its progress if so
+  //--------------------------------------------------------------------------------------------------------------------
+  bool running() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress && !m_progress->finished();
+  }
+  std::shared_ptr<const BuildProgress> progress() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress;
+  }
+
+private:
+  struct Worker
+  {
+    std::thread m_thread;
+    std::shared_ptr<BuildProgress> m_progress;
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the body of each worker thread. The result is only published if no newer job has been started or the job
+  /// cancelled by the time it's ready, which is checked under m_mutex so that a stale job can't slip in after start().
+  /// Nothing may escape a std::thread, so anything the job throws is caught and recorded in _progress
+  //--------------------------------------------------------------------------------------------------------------------
+  void run(Job _job, std::shared_ptr<BuildProgress> _progress, uint64_t _generation)
+  {
+    std::unique_ptr<T> result;
+    if(!_progress->cancelled())
+    {
+      try
+      {
+        result.reset(new T(_job(*_progress)));
+      }
+      catch(const std::exception &_error)
+      {
+        _progress->fail(_error.what());
+      }
+      catch(...)
+      {
+        _progress->fail("unknown error");
+      }
+    }
+    T * replaced = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(result && !_progress->cancelled() && _generation == m_generation)
+      {
+        _progress->set(_progress->stage(), 1.0f);
+        replaced = m_result.exchange(result.release(), std::memory_order_release);
+      }
+    }
+    delete replaced;
+    result.reset();
+    _progress->finish();
+  }
+
+  void joinFinishedWorkers()
+  {
+    for(auto worker = m_workers.begin(); worker != m_workers.end();)
+    {
+      if(worker->m_progress->finished())
+      {
+        worker->m_thread.join();
+        worker = m_workers.erase(worker);
+      }
+      else
+      {
+        ++worker;
+      }
+    }
+  }
+
+  mutable std::mutex m_mutex;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the progress of the newest job and a count of the jobs started or cancelled, which a worker has to match
+  /// to publish its result
+  //--------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<BuildProgress> m_progress;
+  uint64_t m_generation = 0;
+  std::atomic<T *> m_result{nullptr};
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief every thread that hasn't been joined yet, only touched by the owner
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<Worker> m_workers;
+};
+
+#endif //BACKGROUNDBUILD_H_
@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DensityMap.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef DENSITYMAP_H_
+#define DENSITYMAP_H_
+
+#include <cstdint>
+#include <vector>
+#include "RandomStream.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class DensityMap
+/// @brief a raster of non-negative weights over a rectangle in the xz plane, eg. how likely a tree is to grow in each
+/// cell. Once buildSampler() has made an alias table over the cells (Vose's method), sample() draws a cell in
+/// proportion to its weight with one index and one coin flip, then jitters the point inside the cell, so placing a
+/// tree costs the same however uneven the weights are
+//----------------------------------------------------------------------------------------------------------------------
+
+class DensityMap
+{
+public:
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sets the size of the raster to _numX by _numZ cells covering [_minX,_maxX] x [_minZ,_maxZ], with every
+  /// weight 0
+  //--------------------------------------------------------------------------------------------------------------------
+  void resize(size_t _numX, size_t _numZ, float _minX, float _maxX, float _minZ, float _maxZ);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the weight of cell (_x,_z)
+  //--------------------------------------------------------------------------------------------------------------------
+  float &at(size_t _x, size_t _z) { return m_values[_z*m_numX+_x]; }
+  float at(size_t _x, size_t _z) const { return m_values[_z*m_numX+_x]; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the centre of cell (_x,_z)
+  //--------------------------------------------------------------------------------------------------------------------
+  float cellX(size_t _x) const { return m_minX + (float(_x)+0.5f)*m_cellWidth; }
+  float cellZ(size_t _z) const { return m_minZ + (float(_z)+0.5f)*m_cellLength; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the flat index of the cell containing (_x,_z), clamped to the raster
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t cellIndex(float _x, float _z) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief builds the alias table from the current weights - call again after changing them
+  //--------------------------------------------------------------------------------------------------------------------
+  void buildSampler();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief draws a flat cell index with probability proportional to its weight
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t sampleCell(RandomStream &_stream) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief draws a point with probability proportional to the weight of the cell it's in, uniform within the cell.
+  /// Returns false, leaving _x and _z alone, if every weight is 0
+  //--------------------------------------------------------------------------------------------------------------------
+  bool sample(RandomStream &_stream, float &_x, float &_z) const;
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief raster dimensions and the rectangle it covers
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numX = 0;
+  size_t m_numZ = 0;
+  float m_minX = 0.0f;
+  float m_minZ = 0.0f;
+  float m_cellWidth = 1.0f;
+  float m_cellLength = 1.0f;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the weights, in row major order (index z*m_numX + x)
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_values;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the alias table - cell i is kept with probability m_probability[i], otherwise m_alias[i] is used instead
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_probability;
+  std::vector<uint32_t> m_alias;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sum of the weights when the alias table was built
+  //--------------------------------------------------------------------------------------------------------------------
+  double m_total = 0.0;
+};
+
+#endif //DENSITYMAP_H_
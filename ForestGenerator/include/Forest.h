@@ -9,11 +9,20 @@
 #define FOREST_H_
 
 #include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
-#include <random>
 #include <ngl/Vec3.h>
 #include <ngl/Mat4.h>
 #include "LSystem.h"
+#include "BackgroundBuild.h"
+#include "DensityMap.h"
+#include "ForestTileWriter.h"
+#include "InstanceCacheFile.h"
+#include "ParallelFor.h"
+#include "PoissonDiskSampler.h"
+#include "SpatialGrid.h"
+#include "RandomStream.h"
 #include "TerrainGenerator.h"
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -25,6 +34,17 @@
 class Forest
 {
 public:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief how scatterForest() places trees - independently and uniformly, as a Poisson-disk set where no two
+  /// trees are closer than their types' m_scatterRadius allows, or independently from density maps built from the
+  /// terrain and the tree types' altitude and slope preferences
+  //--------------------------------------------------------------------------------------------------------------------
+  enum ScatterMode
+  {
+    UNIFORM,
+    POISSON_DISK,
+    DENSITY_MAP
+  };
 
   //CONSTRUCTOR
   //--------------------------------------------------------------------------------------------------------------------
@@ -37,7 +57,17 @@ public:
   Forest(const std::vector<LSystem> &_treeTypes,
          float _width, float _length,
          size_t _numTrees, int _numHeroTrees,
-         int _terrainDimension);
+         int _terrainDimension, ScatterMode _scatterMode=UNIFORM,
+         const std::string &_cacheDirectory="");
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief user ctor for Forest class on the terrain _terrain, whose heightmap it generates - for setting the noise
+  /// parameters of the terrain as well
+  //--------------------------------------------------------------------------------------------------------------------
+  Forest(const std::vector<LSystem> &_treeTypes,
+         float _width, float _length,
+         size_t _numTrees, int _numHeroTrees,
+         const TerrainGenerator &_terrain, ScatterMode _scatterMode=UNIFORM,
+         const std::string &_cacheDirectory="");
 
   //TREE STRUCT
   //--------------------------------------------------------------------------------------------------------------------
@@ -54,9 +84,14 @@ public:
     //--------------------------------------------------------------------------------------------------------------------
     size_t m_type;
     //--------------------------------------------------------------------------------------------------------------------
-    /// @brief transform matrix for tree, representing position and orientation
+    /// @brief transform for tree, representing position, orientation and scale
     //--------------------------------------------------------------------------------------------------------------------
-    ngl::Mat4 m_transform;
+    AffineTransform m_transform;
+    //--------------------------------------------------------------------------------------------------------------------
+    /// @brief random value in [0,1) fixed when the tree is scattered - when the forest is thinned out in the distance,
+    /// the trees with the highest importance are the ones kept, so the same trees survive from frame to frame
+    //--------------------------------------------------------------------------------------------------------------------
+    float m_importance = 0.0f;
   };
 
   //OUTPUT DATA STRUCT
@@ -74,6 +109,66 @@ public:
     size_t m_treeType, m_id, m_age, m_innerIndex;
   };
 
+  //PROTOTYPE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a whole tree baked from the instance cache of one tree type: for every instance it uses, the flat index of
+  /// its slot in the instance cache and its transform relative to the root of the tree. Placing a tree from a
+  /// prototype is then one batch of matrix multiplies, rather than a walk through the exit points
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Prototype
+  {
+    std::vector<uint32_t> m_slots;
+    std::vector<AffineTransform> m_transforms;
+    //------------------------------------------------------------------------------------------------------------------
+    /// @brief for each instance, the oldest age on the path of exit points from the root of the tree to it. Leaving
+    /// out the instances with an age over some limit gives the same tree without its younger branches
+    //------------------------------------------------------------------------------------------------------------------
+    std::vector<uint32_t> m_ages;
+    //------------------------------------------------------------------------------------------------------------------
+    /// @brief bounding sphere of the whole tree, relative to its root
+    //------------------------------------------------------------------------------------------------------------------
+    ngl::Vec3 m_centre;
+    float m_radius = 0.0f;
+  };
+
+  //TRANSFORM CACHE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the transforms of every copy of every instance of one tree type in the forest. The copies of the instance
+  /// at flat index k of the tree type's instance cache are the size(k) transforms starting at data(k), so all of
+  /// them are in one allocation that createForest() can fill from several threads at once
+  //--------------------------------------------------------------------------------------------------------------------
+  struct TransformCache
+  {
+    size_t size(size_t _k) const;
+    const AffineTransform * data(size_t _k) const;
+
+    //--------------------------------------------------------------------------------------------------------------------
+    /// @brief m_offsets[k] is the index into m_transforms of the first copy of instance k, with one final entry equal
+    /// to m_transforms.size()
+    //--------------------------------------------------------------------------------------------------------------------
+    std::vector<size_t> m_offsets = {0};
+    std::vector<AffineTransform> m_transforms;
+  };
+
+  //BUILD KEYS STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief hashes of the parameters each stage of generate() depends on. Each key folds in the keys of the stages it
+  /// builds on, so a change to the terrain invalidates the scatter and a change to the scatter invalidates the forest.
+  /// The tree types are keyed separately, by InstanceCacheFile::key(), so one species can be regrown on its own, and
+  /// so are the prototypes, which don't depend on where the trees stand
+  //--------------------------------------------------------------------------------------------------------------------
+  struct BuildKeys
+  {
+    bool operator==(const BuildKeys &_other) const;
+    bool operator!=(const BuildKeys &_other) const { return !(*this == _other); }
+
+    uint64_t m_terrain = 0;
+    uint64_t m_scatter = 0;
+    std::vector<uint64_t> m_treeTypes;
+    uint64_t m_prototypes = 0;
+    uint64_t m_forest = 0;
+  };
+
   //PUBLIC MEMBER VARIABLES
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief base tree types for the forest
@@ -85,10 +180,28 @@ public:
   float m_width;
   float m_length;
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief number of trees in forest
+  /// @brief number of trees in forest - a Poisson-disk scatter places as many as fit, and sets this to that number
   //--------------------------------------------------------------------------------------------------------------------
   size_t m_numTrees;
   //--------------------------------------------------------------------------------------------------------------------
+  /// @brief scattering method used by scatterForest()
+  //--------------------------------------------------------------------------------------------------------------------
+  ScatterMode m_scatterMode = UNIFORM;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief optional relative density of a Poisson-disk scatter at (x,z), in (0,1] - see PoissonDiskSampler
+  //--------------------------------------------------------------------------------------------------------------------
+  std::function<float(float,float)> m_scatterDensity;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of cells along each side of the density maps
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_densityResolution = 256;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief how suitable each cell of the terrain is for each tree type, and their sum, which trees are drawn from,
+  /// filled by buildDensityMaps()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<DensityMap> m_typeDensity;
+  DensityMap m_density;
+  //--------------------------------------------------------------------------------------------------------------------
   /// @brief stores positions and types of all trees in the forest
   //--------------------------------------------------------------------------------------------------------------------
   std::vector<Tree> m_treeData;
@@ -105,32 +218,243 @@ public:
 
   ///@brief this is the number of hero trees PER tree type
   int m_numHeroTrees;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief directory of InstanceCacheFiles that fillInstanceCaches() reads the hero trees of seeded tree types from,
+  /// and writes them to when they're missing - empty to always grow them
+  //--------------------------------------------------------------------------------------------------------------------
+  std::string m_cacheDirectory;
 
-  //outputCache arranged to mimic the instanceCaches of each treeType
-  //separated by: treeType / id / age / innerIndex / different-branches-using-the-same-instance
-  std::vector<CACHE_STRUCTURE(std::vector<ngl::Mat4>)> m_transformCache;
+  //outputCache separated by treeType, then arranged to mimic the instanceCache of that treeType
+  std::vector<TransformCache> m_transformCache;
 
-  //the random number generator
-  std::default_random_engine m_gen;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of threads createForest() uses - 0 means one per hardware thread
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numThreads = 0;
 
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of prototypes baked per tree type - each tree in the forest is one of these, so more prototypes
+  /// gives more variety at the cost of a longer bake
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numPrototypes = 32;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief prototypes for each tree type, filled by bakePrototypes()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<Prototype>> m_prototypes;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the index into m_prototypes[type] of the prototype used by each tree in m_treeData
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_treePrototypes;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief level of detail versions of m_prototypes, which stop following exit points past m_lodAge, so each one is
+  /// the trunk and older branches of the matching prototype, filled by bakeLODPrototypes()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<Prototype>> m_lodPrototypes;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the oldest age kept in m_lodPrototypes - an instance at this age is drawn as it is in the instance cache,
+  /// with whatever sub-branches were generated inside it, in place of the instances hanging off its exit points
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_lodAge = 2;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief trees whose bounding spheres are centred further than this from the camera are drawn from
+  /// m_lodPrototypes by cull() - 0 turns level of detail off
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_lodDistance = 0.0f;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief distances from the camera over which cull() thins the forest out, from every tree drawn at
+  /// m_thinningStart down to m_minDensity of them at m_thinningEnd and beyond - a start of 0 turns thinning off
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_thinningStart = 0.0f;
+  float m_thinningEnd = 0.0f;
+  float m_minDensity = 0.1f;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief range of importance over which a tree shrinks away as the density drops, rather than disappearing, as a
+  /// fraction of the range of importance drawn whole
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_thinningFadeBand = 0.1f;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief grid over the bounding spheres of the trees in m_treeData, for culling
+  //--------------------------------------------------------------------------------------------------------------------
+  SpatialGrid m_treeGrid;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief side length of the cells of m_treeGrid - 0 picks one giving around 32 trees per cell
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_gridCellSize = 0.0f;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the trees that passed the last cull(), whether each one was drawn at the lower level of detail, the
+  /// scale each one was drawn at after thinning, and their transforms, arranged like m_transformCache
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<uint32_t> m_visibleTrees;
+  std::vector<uint8_t> m_visibleLOD;
+  std::vector<float> m_visibleScales;
+  std::vector<TransformCache> m_visibleCache;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the seed used for this forest's random streams - either m_seed or taken from the time by
+  /// seedRandomEngine()
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t m_randomSeed = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ids used to key the random streams, so that each (tree index, purpose) pair gets an independent stream
+  //--------------------------------------------------------------------------------------------------------------------
+  enum RandomPurpose : uint64_t
+  {
+    SCATTER,
+    INSTANCE_SELECTION,
+    PROTOTYPE,
+    IMPORTANCE,
+    POISSON_DISK_TILE
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the terrain the forest stands on - the ctor generates its heightmap, which scatterForest() reads the
+  /// ground height of each tree from
+  //--------------------------------------------------------------------------------------------------------------------
   TerrainGenerator m_terrainGen;
 
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief how long each stage of generate() took, in milliseconds, in the order they ran
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<std::pair<std::string,double>> m_stageTimes;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief where generate() reports its progress, for forests built on a worker thread, or null. generate() stops
+  /// between steps once it's cancelled, leaving the forest half built
+  //--------------------------------------------------------------------------------------------------------------------
+  BuildProgress * m_progress = nullptr;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the keys of the parameters the forest's current results were built from, which generate() compares
+  /// against buildKeys() to skip the stages that are still valid. Zero for stages that haven't been run, and a tree
+  /// type's entry is zero until it has been grown
+  //--------------------------------------------------------------------------------------------------------------------
+  BuildKeys m_builtKeys;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the tree types whose transforms the last generate() changed, and the ones among them whose instance caches
+  /// it grew as well, for callers keeping copies of them such as GPU buffers
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<bool> m_changedTreeTypes;
+  std::vector<bool> m_regrownTreeTypes;
+
   //PUBLIC METHODS
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief fill m_treePositions
+  /// @brief runs the whole pipeline from the current parameters - generates the heightmap of m_terrainGen, scatters
+  /// the trees, fills the instance caches and creates the forest, timing each stage into m_stageTimes. The user ctors
+  /// call this; build a default Forest and call it to set parameters the ctors don't take, like m_seed. Stages whose
+  /// keys match m_builtKeys are skipped, so after reuse() only what has changed is rebuilt. A tree type is only grown
+  /// once per Forest, since growing the hero trees rewrites its rules - to change one, build a new Forest and reuse()
+  /// the old. Returns false if it was cancelled through m_progress
+  //--------------------------------------------------------------------------------------------------------------------
+  bool generate();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the keys of the current parameters. The tree type keys are only right for tree types that haven't been
+  /// grown yet, so take them before generate()
+  //--------------------------------------------------------------------------------------------------------------------
+  BuildKeys buildKeys() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief takes whatever of _previous, a generated forest, is still valid for this forest's parameters - its
+  /// heightmap, its scatter, the tree types that haven't changed and their prototypes - and marks it built in
+  /// m_builtKeys, so that generate() only reruns the rest. Call it before generate(), with m_treeTypes not yet grown.
+  /// Only what's kept is copied, and nothing in _previous is written, so it can be read from a worker thread while
+  /// the thread that owns it goes on culling it
+  //--------------------------------------------------------------------------------------------------------------------
+  void reuse(const Forest &_previous);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief fill m_treeData, standing each tree on the heightmap of m_terrainGen
   //--------------------------------------------------------------------------------------------------------------------
   void scatterForest();
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief create geometry of tree by taking instances from the instance cache
+  /// @brief fills the instance cache of each tree type flagged in _treeTypes, or of every one if it's empty, from its
+  /// file in m_cacheDirectory when there is one
   //--------------------------------------------------------------------------------------------------------------------
-  void createTree(size_t _treeType, ngl::Mat4 _transform, size_t _id, size_t _age);
-
-  Instance * getInstance(LSystem &_treeType, size_t _id, size_t _age, size_t &_innerIndex);
+  void fillInstanceCaches(const std::vector<bool> &_treeTypes = {});
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief fills m_typeDensity and m_density from the altitude and slope of _heightmap at the centre of each cell
+  //--------------------------------------------------------------------------------------------------------------------
+  void buildDensityMaps(const Heightmap &_heightmap);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief picks a tree type for cell _cell of the density maps, in proportion to how well each type suits it
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t pickTreeType(size_t _cell, RandomStream &_stream) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief add a tree to _prototype by taking instances from the instance cache, starting from the instance (_id,_age)
+  /// at _transform relative to the root of the tree, and following its exit points. _pathAge is the oldest age on the
+  /// way to this instance
+  //--------------------------------------------------------------------------------------------------------------------
+  void createTree(size_t _treeType, ngl::Mat4 _transform, size_t _id, size_t _age, RandomStream &_stream,
+                  Prototype &_prototype, size_t _pathAge = 0);
 
-  void createForest();
+  const Instance * getInstance(const LSystem &_treeType, size_t _id, size_t _age, size_t &_innerIndex,
+                               RandomStream &_stream);
 
-  void resizeTransformCache();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief fills m_prototypes with m_numPrototypes trees per tree type, for the tree types flagged in _treeTypes or
+  /// for every one if it's empty. Each tree type has its own random streams, so the others' prototypes are unchanged
+  //--------------------------------------------------------------------------------------------------------------------
+  void bakePrototypes(const std::vector<bool> &_treeTypes = {});
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sets the bounding sphere of _prototype from the bounding boxes of its instances
+  //--------------------------------------------------------------------------------------------------------------------
+  void computePrototypeBounds(size_t _treeType, Prototype &_prototype);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief fills m_lodPrototypes by taking the instances of each prototype up to m_lodAge, for the tree types flagged
+  /// in _treeTypes or for every one if it's empty - this doesn't use any random numbers, so it can be rerun after
+  /// changing m_lodAge without changing the trees
+  //--------------------------------------------------------------------------------------------------------------------
+  void bakeLODPrototypes(const std::vector<bool> &_treeTypes = {});
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the prototype tree _tree in m_treeData is drawn with, at the lower level of detail if _lod is true
+  //--------------------------------------------------------------------------------------------------------------------
+  const Prototype &treePrototype(size_t _tree, bool _lod) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief bakes the prototypes, picks one for each tree in m_treeData, builds m_treeGrid, then fills m_transformCache
+  /// with every tree. Only the prototypes of the tree types flagged in _rebake are baked, unless it's empty
+  //--------------------------------------------------------------------------------------------------------------------
+  void createForest(const std::vector<bool> &_rebake = {});
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory held by the forest's own structures, followed by the reports of each tree type and of
+  /// the terrain
+  //--------------------------------------------------------------------------------------------------------------------
+  MemoryReport memoryUsage() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes every instance of the forest to _path with a ForestTileWriter, in square tiles of side _tileSize.
+  /// Each tree goes in the tile holding its root, and the tiles are built from the prototypes one at a time while the
+  /// writer thread writes the ones before, so this never holds more than a few tiles of instances. Returns false if
+  /// the file couldn't be written
+  //--------------------------------------------------------------------------------------------------------------------
+  bool exportTiles(const std::string &_path, float _tileSize,
+                   ForestTileWriter::Compression _compression=ForestTileWriter::ZLIB) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief builds m_treeGrid from the trees in m_treeData and their prototypes
+  //--------------------------------------------------------------------------------------------------------------------
+  void buildTreeGrid();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief finds the trees that are at least partly inside the view frustum of _MVP, and fills m_visibleTrees and
+  /// m_visibleCache with them. _MVP is the matrix the forest is drawn with, so the test is done in forest space, and
+  /// _eye is the camera position in forest space, which picks the level of detail of each tree
+  //--------------------------------------------------------------------------------------------------------------------
+  void cull(const ngl::Mat4 &_MVP, const ngl::Vec3 &_eye);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the fraction of trees drawn at _distance from the camera
+  //--------------------------------------------------------------------------------------------------------------------
+  float thinningDensity(float _distance) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the scale to draw a tree with importance _importance at when a fraction _density of trees are drawn whole,
+  /// or 0 if it isn't drawn. Trees just below the cut off shrink as the density drops, and the rest are scaled up by
+  /// 1/sqrt(_density) so the canopy covers the same area with fewer trees
+  //--------------------------------------------------------------------------------------------------------------------
+  float thinningScale(float _importance, float _density) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief fills _cache with the transforms of the trees in _trees, using the threads given by m_numThreads. If _lod
+  /// isn't empty, the trees with a non-zero entry in it are taken from m_lodPrototypes, and if _scales isn't empty,
+  /// each tree is scaled about its root by its entry
+  //--------------------------------------------------------------------------------------------------------------------
+  void fillTransformCache(const std::vector<uint32_t> &_trees, const std::vector<uint8_t> &_lod,
+                          const std::vector<float> &_scales, std::vector<TransformCache> &_cache) const;
 
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sets m_randomSeed from m_seed, or from the time if m_useSeed is false
+  //--------------------------------------------------------------------------------------------------------------------
   void seedRandomEngine();
 
 };
@@ -0,0 +1,51 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ForestTileReader.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef FORESTTILEREADER_H_
+#define FORESTTILEREADER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "ForestTileWriter.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ForestTileReader
+/// @brief reads files written by ForestTileWriter. open() only reads the header and the tile index, and each tile is
+/// then read on its own by seeking to its chunk
+//----------------------------------------------------------------------------------------------------------------------
+
+class ForestTileReader
+{
+public:
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief opens the file at _path and reads its index, returning false if it isn't a complete tile file of this
+  /// version
+  //--------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the header and tile index of the open file
+  //--------------------------------------------------------------------------------------------------------------------
+  const ForestTileWriter::Header &header() const { return m_header; }
+  const std::vector<ForestTileWriter::TileEntry> &tiles() const { return m_index; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the position in tiles() of tile (_x,_z), or tiles().size() if the file has no such tile
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t findTile(int32_t _x, int32_t _z) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief reads tile _index of tiles() into _tile, returning false if its chunk can't be read or decompressed
+  //--------------------------------------------------------------------------------------------------------------------
+  bool readTile(size_t _index, ForestTileWriter::Tile &_tile);
+
+private:
+  std::ifstream m_file;
+  ForestTileWriter::Header m_header = {};
+  std::vector<ForestTileWriter::TileEntry> m_index;
+};
+
+#endif //FORESTTILEREADER_H_
@@ -0,0 +1,189 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ForestTileWriter.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef FORESTTILEWRITER_H_
+#define FORESTTILEWRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "AffineTransform.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ForestTileWriter
+/// @brief streams the instances of a forest to disk as square tiles of the xz plane, for renderers that take point
+/// instancer data. Each instance is a prototype - a tree type and the flat index of an instance in its instance cache,
+/// whose geometry is that range of the type's hero indices - and a transform.
+///
+/// The file is a Header, then one chunk per tile in the order they were written, then the tile index, which the
+/// header points to once close() has written it. A chunk holds the tile's tree types (uint32 each), then its
+/// prototypes (uint32 each), then its transforms (in the 48 byte layout of AffineTransform), and is deflated with zlib
+/// if that was asked for and makes it smaller. Grouping each field together like this compresses much better than
+/// whole records. ForestTileReader finds a tile from the index and reads just its chunk.
+///
+/// writeTile() only queues the tile; a background thread compresses and writes it, so the caller can build the next
+/// tile in the meantime. At most m_maxQueuedTiles are held at once - writeTile() waits for the writer when the queue
+/// is full - so a forest of any size can be exported a tile at a time.
+//----------------------------------------------------------------------------------------------------------------------
+
+class ForestTileWriter
+{
+public:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief bumped whenever the layout changes
+  //--------------------------------------------------------------------------------------------------------------------
+  static constexpr uint32_t s_version = 1;
+  static constexpr char s_magic[8] = {'F','G','T','I','L','E','S','\0'};
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief how chunks are stored - ZLIB falls back to NONE when the project is built without zlib
+  //--------------------------------------------------------------------------------------------------------------------
+  enum Compression : uint32_t
+  {
+    NONE,
+    ZLIB
+  };
+
+  //HEADER STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the start of the file - m_indexOffset and m_numTiles are 0 until the file has been closed
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Header
+  {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_headerSize;
+    float m_tileSize;
+    uint32_t m_tileEntrySize;
+    uint64_t m_indexOffset;
+    uint64_t m_numTiles;
+    uint64_t m_numInstances;
+  };
+
+  //TILE ENTRY STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief an entry of the tile index - tile (x,z) covers [x*tileSize, (x+1)*tileSize) in x, and its chunk is
+  /// m_storedSize bytes from m_offset
+  //--------------------------------------------------------------------------------------------------------------------
+  struct TileEntry
+  {
+    int32_t m_x;
+    int32_t m_z;
+    uint64_t m_offset;
+    uint64_t m_storedSize;
+    uint64_t m_numInstances;
+    uint32_t m_compression;
+    uint32_t m_padding;
+  };
+
+  //TILE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the instances of one tile, as parallel arrays
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Tile
+  {
+    int32_t m_x = 0;
+    int32_t m_z = 0;
+    std::vector<uint32_t> m_treeTypes;
+    std::vector<uint32_t> m_prototypes;
+    std::vector<AffineTransform> m_transforms;
+  };
+
+  //CONSTRUCTORS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for ForestTileWriter class - nothing is open
+  //--------------------------------------------------------------------------------------------------------------------
+  ForestTileWriter() = default;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief dtor for ForestTileWriter class, closes the file if it's still open
+  //--------------------------------------------------------------------------------------------------------------------
+  ~ForestTileWriter();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the writer owns a thread, so it can't be copied
+  //--------------------------------------------------------------------------------------------------------------------
+  ForestTileWriter(const ForestTileWriter &) = delete;
+  ForestTileWriter &operator=(const ForestTileWriter &) = delete;
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief creates the file at _path for tiles of side _tileSize and starts the writer thread, returning false if the
+  /// file couldn't be created
+  //--------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path, float _tileSize, Compression _compression=ZLIB);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief queues _tile to be written, waiting first if m_maxQueuedTiles are already queued. Every tile should be
+  /// written once. Returns false straight away if the writer isn't open or something has already failed to write,
+  /// since the tile would never be written
+  //--------------------------------------------------------------------------------------------------------------------
+  bool writeTile(Tile _tile);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief waits for the queued tiles to be written, then writes the index and header and closes the file. Returns
+  /// false if anything failed to write, in which case the file is incomplete and error() says why
+  //--------------------------------------------------------------------------------------------------------------------
+  bool close();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief what went wrong with the last file, once close() has returned false
+  //--------------------------------------------------------------------------------------------------------------------
+  const std::string &error() const { return m_error; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the coordinate along x or z of the tile of side _tileSize holding _position
+  //--------------------------------------------------------------------------------------------------------------------
+  static int32_t tileCoordinate(float _position, float _tileSize);
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the most tiles writeTile() holds before waiting for the writer thread
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_maxQueuedTiles = 4;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief zlib compression level, from 1 (fastest) to 9 (smallest)
+  //--------------------------------------------------------------------------------------------------------------------
+  int m_compressionLevel = 6;
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief body of the writer thread - writes queued tiles until close() is called and the queue is empty, or until
+  /// writing one throws, which stops the thread and fails the file
+  //--------------------------------------------------------------------------------------------------------------------
+  void writerLoop();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief packs, compresses and writes one tile, and adds it to m_index
+  //--------------------------------------------------------------------------------------------------------------------
+  void writeChunk(const Tile &_tile);
+
+  std::ofstream m_file;
+  Header m_header = {};
+  Compression m_compression = ZLIB;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the index entries of the tiles written so far - only touched by the writer thread until it's joined
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<TileEntry> m_index;
+  uint64_t m_offset = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief set by either thread once anything fails, with m_error saying what - m_error is only written by the
+  /// writer thread before it stops, or by the owner while it isn't running
+  //--------------------------------------------------------------------------------------------------------------------
+  std::atomic<bool> m_failed{false};
+  std::string m_error;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief queue of tiles waiting for the writer thread, guarded by m_mutex
+  //--------------------------------------------------------------------------------------------------------------------
+  std::thread m_writer;
+  std::mutex m_mutex;
+  std::condition_variable m_queueChanged;
+  std::deque<Tile> m_queue;
+  bool m_closing = false;
+};
+
+#endif //FORESTTILEWRITER_H_
@@ -0,0 +1,96 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameStats.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef FRAMESTATS_H_
+#define FRAMESTATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class FrameStats
+/// @brief per-frame rendering counters for the performance readout of NGLScene. paintGL() and the VAO builds add to
+/// m_current as they go and endFrame() closes the frame off. The GPU time of a frame is only known a few frames later,
+/// when its timer query comes back, so a frame that waits for one is held until setGPUTime() gives it. Finished
+/// frames are kept for averaging and, while a log is open, written to it as CSV
+//----------------------------------------------------------------------------------------------------------------------
+
+class FrameStats
+{
+public:
+  //FRAME STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the counters of one frame. Times are in milliseconds, and m_gpuTime is negative if it wasn't measured
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Frame
+  {
+    uint64_t m_index = 0;
+    double m_cpuTime = 0.0;
+    double m_gpuTime = -1.0;
+    size_t m_triangles = 0;
+    size_t m_lines = 0;
+    size_t m_instances = 0;
+    size_t m_drawCalls = 0;
+    size_t m_uploadedBytes = 0;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief finishes m_current, taking _cpuTime as its time on the CPU, and starts a new one. If _waitForGPU is set
+  /// the frame is held until setGPUTime() is called with its index, which this returns
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t endFrame(double _cpuTime, bool _waitForGPU);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief gives frame _index its GPU time. Frames held from before it are taken to have lost their query and are
+  /// finished without one
+  //--------------------------------------------------------------------------------------------------------------------
+  void setGPUTime(uint64_t _index, double _gpuTime);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the mean of every counter over the finished frames in the history, with a negative m_gpuTime if none of
+  /// them were timed on the GPU
+  //--------------------------------------------------------------------------------------------------------------------
+  Frame average() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief one line summary of average(), for a status bar
+  //--------------------------------------------------------------------------------------------------------------------
+  std::string summary() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief starts writing every finished frame to a CSV file at _path, returning false if it can't be opened
+  //--------------------------------------------------------------------------------------------------------------------
+  bool openLog(const std::string &_path);
+  void closeLog();
+  bool logging() const { return m_log.is_open(); }
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief counters of the frame being drawn
+  //--------------------------------------------------------------------------------------------------------------------
+  Frame m_current;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of finished frames average() is taken over
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_historySize = 60;
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief adds _frame to the history and the log
+  //--------------------------------------------------------------------------------------------------------------------
+  void finish(const Frame &_frame);
+
+  uint64_t m_numFrames = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief frames waiting for their GPU time, oldest first
+  //--------------------------------------------------------------------------------------------------------------------
+  std::deque<Frame> m_pending;
+  std::deque<Frame> m_history;
+  std::ofstream m_log;
+};
+
+#endif //FRAMESTATS_H_
@@ -0,0 +1,63 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Frustum.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#include <array>
+#include <ngl/Mat4.h>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class Frustum
+/// @brief the six planes of a view frustum, extracted from a model-view-projection matrix, for culling bounding
+/// volumes on the CPU. The planes are in the space the matrix transforms from, so passing the full MVP used to draw
+/// the forest gives planes in forest space
+//----------------------------------------------------------------------------------------------------------------------
+
+class Frustum
+{
+public:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief result of testing a volume against the frustum
+  //--------------------------------------------------------------------------------------------------------------------
+  enum Result
+  {
+    OUTSIDE,
+    INTERSECTS,
+    INSIDE
+  };
+
+  //CONSTRUCTORS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for Frustum class - every plane accepts everything
+  //--------------------------------------------------------------------------------------------------------------------
+  Frustum();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor for Frustum class, taking the planes from _MVP as it is uploaded to the shaders
+  //--------------------------------------------------------------------------------------------------------------------
+  Frustum(const ngl::Mat4 &_MVP);
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns false if the sphere is entirely outside the frustum
+  //--------------------------------------------------------------------------------------------------------------------
+  bool sphereVisible(const ngl::Vec3 &_centre, float _radius) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief tests an axis aligned box against the frustum
+  //--------------------------------------------------------------------------------------------------------------------
+  Result classifyBox(const ngl::Vec3 &_min, const ngl::Vec3 &_max) const;
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief normalised planes (a,b,c,d), with a point p inside when a*p.x + b*p.y + c*p.z + d >= 0
+  /// ordered left, right, bottom, top, near, far
+  //--------------------------------------------------------------------------------------------------------------------
+  std::array<std::array<float,4>,6> m_planes;
+};
+
+#endif //FRUSTUM_H_
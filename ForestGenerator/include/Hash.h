@@ -0,0 +1,47 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Hash.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class Hash
+/// @brief 64 bit FNV-1a hash, fed one value at a time. Used for the keys of InstanceCacheFiles and of the stages of
+/// Forest::generate(), so values are hashed by their bytes and the result is only stable on one platform
+//----------------------------------------------------------------------------------------------------------------------
+
+struct Hash
+{
+  void bytes(const void * _data, size_t _size)
+  {
+    const unsigned char * data = static_cast<const unsigned char *>(_data);
+    for(size_t i=0; i<_size; i++)
+    {
+      m_hash = (m_hash ^ data[i]) * 0x100000001b3ull;
+    }
+  }
+  template <class T>
+  void value(const T &_value)
+  {
+    static_assert(std::is_arithmetic<T>::value, "hash values by their bytes");
+    bytes(&_value, sizeof(T));
+  }
+  //strings are prefixed by their length, so "ab","c" and "a","bc" hash differently
+  void string(const std::string &_string)
+  {
+    value(uint64_t(_string.size()));
+    bytes(_string.data(), _string.size());
+  }
+  uint64_t m_hash = 0xcbf29ce484222325ull;
+};
+
+#endif //HASH_H_
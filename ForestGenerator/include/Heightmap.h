@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Heightmap.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef HEIGHTMAP_H_
+#define HEIGHTMAP_H_
+
+#include <cstddef>
+#include <vector>
+#include <ngl/Vec3.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class Heightmap
+/// @brief read only view of a square heightmap laid out as TerrainGenerator fills it - m_dimension rows of
+/// m_dimension heights, where heightmap index i is at scene x = (i%m_dimension - m_dimension/2)*m_scale and scene
+/// z = (i/m_dimension - m_dimension/2)*m_scale. Queries interpolate bilinearly between the four surrounding samples,
+/// so they agree with the terrain mesh wherever it's at full detail, and clamp to the edge outside the map. An empty
+/// map is flat at height 0
+//----------------------------------------------------------------------------------------------------------------------
+
+class Heightmap
+{
+public:
+  //CONSTRUCTORS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for Heightmap class - an empty map
+  //--------------------------------------------------------------------------------------------------------------------
+  Heightmap() = default;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor for Heightmap class, viewing _heights, which must outlive it
+  //--------------------------------------------------------------------------------------------------------------------
+  Heightmap(const std::vector<float> &_heights, int _dimension, float _scale);
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the height of the terrain at (_x,_z)
+  //--------------------------------------------------------------------------------------------------------------------
+  float height(float _x, float _z) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the unit normal of the terrain at (_x,_z)
+  //--------------------------------------------------------------------------------------------------------------------
+  ngl::Vec3 normal(float _x, float _z) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the slope of the terrain at (_x,_z), in degrees from horizontal
+  //--------------------------------------------------------------------------------------------------------------------
+  float slope(float _x, float _z) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes the height at (_x[i],_z[i]) to _heights[i] for _n points. The points are in separate arrays and the
+  /// loop has no branches, so the compiler can vectorise the arithmetic across points
+  //--------------------------------------------------------------------------------------------------------------------
+  void heights(const float * _x, const float * _z, size_t _n, float * _heights) const;
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the viewed heights, and the layout they're in
+  //--------------------------------------------------------------------------------------------------------------------
+  const float * m_heights = nullptr;
+  int m_dimension = 0;
+  float m_scale = 1.0f;
+
+private:
+  //PRIVATE MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief finds the cell of the map containing (_x,_z): the heightmap index of its lower corner, and the position
+  /// inside it in [0,1]
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t locate(float _x, float _z, float &_u, float &_v) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the gradient of the height, (dh/dx, dh/dz), at (_x,_z)
+  //--------------------------------------------------------------------------------------------------------------------
+  void gradient(float _x, float _z, float &_dx, float &_dz) const;
+};
+
+#endif //HEIGHTMAP_H_
@@ -8,7 +8,11 @@
 #ifndef INSTANCE_H_
 #define INSTANCE_H_
 
+#include <cstdint>
+#include <vector>
 #include <ngl/Mat4.h>
+#include <ngl/Vec3.h>
+#include "AffineTransform.h"
 
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -26,6 +30,10 @@ struct Instance
   /// @brief ctor for Instance struct
   //--------------------------------------------------------------------------------------------------------------------
   Instance(ngl::Mat4 _transform);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sets m_boundsMin and m_boundsMax from the vertices used by m_instanceStart to m_instanceEnd of _indices
+  //--------------------------------------------------------------------------------------------------------------------
+  void computeBounds(const std::vector<ngl::Vec3> &_vertices, const std::vector<GLshort> &_indices);
 
   ngl::Mat4 m_transform;
   //GLshort * m_instanceStart;
@@ -33,16 +41,31 @@ struct Instance
   size_t m_instanceStart;
   size_t m_instanceEnd;
   //std::vector<GLshort> m_indices;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief axis aligned bounding box of the instance's geometry, in the space of the hero tree it was taken from
+  //--------------------------------------------------------------------------------------------------------------------
+  ngl::Vec3 m_boundsMin;
+  ngl::Vec3 m_boundsMax;
 
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a point on the instance where another instance of (id, age) is attached, with the transform to it
+  /// relative to this instance. Packed to 56 bytes since forest creation reads one for every instance it places
+  //--------------------------------------------------------------------------------------------------------------------
   struct ExitPoint
   {
+    ExitPoint() = default;
     ExitPoint(size_t _exitId, size_t _exitAge, ngl::Mat4 _transform);
-    size_t m_exitId;
-    size_t m_exitAge;
-    ngl::Mat4 m_exitTransform;
+    uint32_t m_exitId;
+    uint32_t m_exitAge;
+    AffineTransform m_exitTransform;
   };
 
-  std::vector<ExitPoint> m_exitPoints;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the exit points of all the instances of a tree type are stored together in the m_exitPoints of its
+  /// LSystem::HeroTrees, and this instance's are the m_numExitPoints starting from m_exitPointStart
+  //--------------------------------------------------------------------------------------------------------------------
+  uint32_t m_exitPointStart = 0;
+  uint32_t m_numExitPoints = 0;
 };
 
 
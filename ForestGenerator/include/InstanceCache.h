@@ -0,0 +1,266 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file InstanceCache.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef INSTANCECACHE_H_
+#define INSTANCECACHE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class InstanceCache
+/// @brief container for data that is arranged like the instance cache of an LSystem:
+/// (1) the outer index separates elements by id of the branch
+/// (2) the middle index separates elements of the same id by the age of tree generation they're introduced in
+/// (3) the inner index separates different elements of the same id and age
+/// Rather than nesting std::vectors, every element lives in one contiguous array ordered by (id, age, index), with a
+/// table of offsets marking where each (id, age) slot starts. This means one allocation for the payload, one size_t of
+/// overhead per slot, and traversal of the whole cache is a linear walk.
+/// Caches with the same shape (see resizeLike) have the same flat ordering, so element k of one cache corresponds to
+/// element k of the other.
+/// None of the methods copy elements, so T can be move-only (eg. std::unique_ptr).
+/// @note push_back appends to a list per slot, which finalize() merges into the flat array in one pass, so filling a
+/// cache is linear in its size. Until then the flat accessors (offsets, flat indices and iterators) only see the
+/// elements that were there at the last finalize(), while size(id, age) and at() see every element. push_back may
+/// invalidate references and pointers to elements of the same slot; refer to elements being built by
+/// (id, age, index) instead.
+//----------------------------------------------------------------------------------------------------------------------
+
+template <class T>
+class InstanceCache
+{
+public:
+  typedef typename std::vector<T>::iterator iterator;
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  //CONSTRUCTOR
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for InstanceCache class - gives an empty cache with no slots
+  //--------------------------------------------------------------------------------------------------------------------
+  InstanceCache() = default;
+
+  //RESIZING
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief clears the cache and gives it _numIds*_numAges empty slots
+  //--------------------------------------------------------------------------------------------------------------------
+  void resize(size_t _numIds, size_t _numAges)
+  {
+    m_numIds = _numIds;
+    m_numAges = _numAges;
+    m_data.clear();
+    m_offsets.assign(_numIds*_numAges+1, 0);
+    clearPending();
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief clears the cache and gives it the same shape as _other, filled with default constructed elements
+  //--------------------------------------------------------------------------------------------------------------------
+  template <class U>
+  void resizeLike(const InstanceCache<U> &_other)
+  {
+    m_numIds = _other.numIds();
+    m_numAges = _other.numAges();
+    m_offsets = _other.offsets();
+    m_data.clear();
+    m_data.resize(_other.offsets().back());
+    clearPending();
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief replaces the cache with _numIds*_numAges slots whose elements are _data, in flat order, with _offsets
+  /// laid out as offsets() returns them - eg. to restore a cache that was saved element by element
+  //--------------------------------------------------------------------------------------------------------------------
+  void assign(size_t _numIds, size_t _numAges, std::vector<size_t> _offsets, std::vector<T> _data)
+  {
+    if(_offsets.size() != _numIds*_numAges+1 || _offsets.front() != 0 || _offsets.back() != _data.size() ||
+       !std::is_sorted(_offsets.begin(), _offsets.end()))
+    {
+      throw std::invalid_argument("InstanceCache::assign offsets don't match the data");
+    }
+    m_numIds = _numIds;
+    m_numAges = _numAges;
+    m_offsets = std::move(_offsets);
+    m_data = std::move(_data);
+    clearPending();
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief removes all elements but keeps the slots
+  //--------------------------------------------------------------------------------------------------------------------
+  void clear()
+  {
+    m_data.clear();
+    m_offsets.assign(m_offsets.size(), 0);
+    clearPending();
+  }
+
+  //SIZES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of ids, ages and elements in the whole cache
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t numIds() const { return m_numIds; }
+  size_t numAges() const { return m_numAges; }
+  size_t size() const { return m_data.size()+m_numPending; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of elements in the (_id, _age) slot
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t size(size_t _id, size_t _age) const
+  {
+    size_t slot = slotIndex(_id, _age);
+    size_t size = m_offsets[slot+1]-m_offsets[slot];
+    return m_pending.empty() ? size : size+m_pending[slot].size();
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the flat index of the first element in the (_id, _age) slot
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t offset(size_t _id, size_t _age) const { return m_offsets[slotIndex(_id, _age)]; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the offset table - entry s is the flat index of the first element of slot s = id*numAges+age, and the
+  /// last entry is size()
+  //--------------------------------------------------------------------------------------------------------------------
+  const std::vector<size_t> &offsets() const { return m_offsets; }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory reserved for the elements and the offset table
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t heapBytes() const
+  {
+    size_t bytes = m_data.capacity()*sizeof(T) + m_offsets.capacity()*sizeof(size_t) +
+                   m_pending.capacity()*sizeof(std::vector<T>);
+    for(auto &pending : m_pending)
+    {
+      bytes += pending.capacity()*sizeof(T);
+    }
+    return bytes;
+  }
+
+  //ELEMENT ACCESS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief bounds checked access to element _index of the (_id, _age) slot
+  //--------------------------------------------------------------------------------------------------------------------
+  T &at(size_t _id, size_t _age, size_t _index)
+  {
+    return const_cast<T &>(static_cast<const InstanceCache &>(*this).at(_id, _age, _index));
+  }
+  const T &at(size_t _id, size_t _age, size_t _index) const
+  {
+    if(_index >= size(_id, _age))
+    {
+      throw std::out_of_range("InstanceCache::at index out of range");
+    }
+    size_t slot = slotIndex(_id, _age);
+    size_t finalized = m_offsets[slot+1]-m_offsets[slot];
+    return _index < finalized ? m_data[m_offsets[slot]+_index] : m_pending[slot][_index-finalized];
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief access by flat index, for walking caches of the same shape together
+  //--------------------------------------------------------------------------------------------------------------------
+  T &operator[](size_t _flatIndex) { return m_data[_flatIndex]; }
+  const T &operator[](size_t _flatIndex) const { return m_data[_flatIndex]; }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief appends an element to the (_id, _age) slot and returns its index within the slot. It isn't in the flat
+  /// array until finalize()
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t push_back(size_t _id, size_t _age, T _value)
+  {
+    size_t slot = slotIndex(_id, _age);
+    size_t index = size(_id, _age);
+    if(m_pending.empty())
+    {
+      m_pending.resize(m_offsets.size()-1);
+    }
+    m_pending[slot].push_back(std::move(_value));
+    m_numPending++;
+    return index;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief moves the elements added by push_back() since the last finalize() into the flat array, behind the ones
+  /// already in their slots, and rebuilds the offset table - one pass over the cache, however many were added
+  //--------------------------------------------------------------------------------------------------------------------
+  void finalize()
+  {
+    if(m_numPending == 0)
+    {
+      clearPending();
+      return;
+    }
+    std::vector<T> data;
+    data.reserve(size());
+    std::vector<size_t> offsets(m_offsets.size(), 0);
+    for(size_t slot=0; slot+1<m_offsets.size(); slot++)
+    {
+      offsets[slot] = data.size();
+      std::move(m_data.begin()+long(m_offsets[slot]), m_data.begin()+long(m_offsets[slot+1]),
+                std::back_inserter(data));
+      std::move(m_pending[slot].begin(), m_pending[slot].end(), std::back_inserter(data));
+    }
+    offsets.back() = data.size();
+    m_data = std::move(data);
+    m_offsets = std::move(offsets);
+    clearPending();
+  }
+
+  //ITERATION
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief iterators over every element of the cache, in (id, age, index) order
+  //--------------------------------------------------------------------------------------------------------------------
+  iterator begin() { return m_data.begin(); }
+  iterator end() { return m_data.end(); }
+  const_iterator begin() const { return m_data.begin(); }
+  const_iterator end() const { return m_data.end(); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief iterators over the elements of the (_id, _age) slot
+  //--------------------------------------------------------------------------------------------------------------------
+  iterator begin(size_t _id, size_t _age) { return m_data.begin()+long(offset(_id, _age)); }
+  iterator end(size_t _id, size_t _age) { return m_data.begin()+long(m_offsets[slotIndex(_id, _age)+1]); }
+  const_iterator begin(size_t _id, size_t _age) const { return m_data.begin()+long(offset(_id, _age)); }
+  const_iterator end(size_t _id, size_t _age) const { return m_data.begin()+long(m_offsets[slotIndex(_id, _age)+1]); }
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief drops the elements waiting for finalize()
+  //--------------------------------------------------------------------------------------------------------------------
+  void clearPending()
+  {
+    std::vector<std::vector<T>>().swap(m_pending);
+    m_numPending = 0;
+  }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the index into m_offsets of the (_id, _age) slot
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t slotIndex(size_t _id, size_t _age) const
+  {
+    if(_id >= m_numIds || _age >= m_numAges)
+    {
+      throw std::out_of_range("InstanceCache slot out of range");
+    }
+    return _id*m_numAges+_age;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of ids and ages the cache has slots for
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numIds = 0;
+  size_t m_numAges = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief every element of the cache, ordered by (id, age, index)
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<T> m_data;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief offsets into m_data of the start of each slot, plus one final entry equal to m_data.size()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<size_t> m_offsets = {0};
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the elements push_back() has added to each slot since the last finalize(), and how many there are -
+  /// empty when there are none
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<T>> m_pending;
+  size_t m_numPending = 0;
+};
+
+#endif //INSTANCECACHE_H_
@@ -0,0 +1,142 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file InstanceCacheFile.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef INSTANCECACHEFILE_H_
+#define INSTANCECACHEFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "LSystem.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class InstanceCacheFile
+/// @brief binary file holding everything LSystem::fillInstanceCache() produces for a tree type - the hero geometry,
+/// the instance cache and the exit points - so a forest can skip growing its hero trees when nothing that shapes
+/// them has changed. Files are keyed by key(), a hash of the grammar, the turtle parameters, the seed and the number
+/// of hero trees, and a file whose key or version doesn't match is ignored.
+///
+/// The file is a fixed size header followed by one section per array, each starting on a 16 byte boundary:
+/// vertices (3 floats each), indices (int16), slot offsets (uint64, numIds*numAges+1 of them), instances (see
+/// InstanceRecord) and exit points (in the 56 byte layout of Instance::ExitPoint). open() reads and checks the header
+/// and section sizes, and read() then reads each section straight into the tree type's vectors with one read per
+/// array. The file isn't memory mapped, since the tree type owns its arrays as std::vectors and would need copying
+/// out of the mapping anyway.
+//----------------------------------------------------------------------------------------------------------------------
+
+class InstanceCacheFile
+{
+public:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief bumped whenever the layout changes, so old files are regenerated instead of misread
+  //--------------------------------------------------------------------------------------------------------------------
+  static constexpr uint32_t s_version = 1;
+
+  //HEADER STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the start of the file - the element count of every section, from which their offsets follow
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Header
+  {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_headerSize;
+    uint64_t m_key;
+    uint64_t m_numIds;
+    uint64_t m_numAges;
+    uint64_t m_numVertices;
+    uint64_t m_numIndices;
+    uint64_t m_numInstances;
+    uint64_t m_numExitPoints;
+  };
+
+  //INSTANCE RECORD STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief an Instance as it's stored on disk, with fixed width fields
+  //--------------------------------------------------------------------------------------------------------------------
+  struct InstanceRecord
+  {
+    float m_transform[16];
+    uint64_t m_instanceStart;
+    uint64_t m_instanceEnd;
+    float m_boundsMin[3];
+    float m_boundsMax[3];
+    uint32_t m_exitPointStart;
+    uint32_t m_numExitPoints;
+  };
+
+  //CONSTRUCTORS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief default ctor for InstanceCacheFile class - nothing is open
+  //--------------------------------------------------------------------------------------------------------------------
+  InstanceCacheFile() = default;
+
+  //STATIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief content hash of everything that shapes the instance cache _treeType.fillInstanceCache(_numHeroTrees)
+  /// would build. Call it before fillInstanceCache(), which rewrites the rules
+  //--------------------------------------------------------------------------------------------------------------------
+  static uint64_t key(const LSystem &_treeType, int _numHeroTrees);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the path of the file for _key inside _directory
+  //--------------------------------------------------------------------------------------------------------------------
+  static std::string path(const std::string &_directory, uint64_t _key);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes the instance cache of _treeType, which fillInstanceCache() has filled, to _path under _key. The
+  /// file is written next to _path, under a name unique to the process and thread, and renamed into place, so
+  /// readers never see a partial file and concurrent writers don't clobber each other. Returns false if it couldn't
+  /// be written
+  //--------------------------------------------------------------------------------------------------------------------
+  static bool write(const std::string &_path, uint64_t _key, const LSystem &_treeType);
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief opens the file at _path and reads its header, returning false (and leaving nothing open) if it's missing,
+  /// was written under a different key or version, or is too short for the sizes in its header
+  //--------------------------------------------------------------------------------------------------------------------
+  bool open(const std::string &_path, uint64_t _key);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief closes the file
+  //--------------------------------------------------------------------------------------------------------------------
+  void close();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief replaces the hero geometry, instance cache and exit points of _treeType with the open file's. Returns
+  /// false, leaving _treeType untouched, if its branches and generation don't match the shape of the file, the file
+  /// can't be read, or its sections don't agree with each other - an index past the last vertex, an instance whose
+  /// indices or exit points run past the end of their arrays, or an exit point to an id or age with no slot
+  //--------------------------------------------------------------------------------------------------------------------
+  bool read(LSystem &_treeType) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief whether a file is open
+  //--------------------------------------------------------------------------------------------------------------------
+  bool isOpen() const { return m_file.is_open(); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the header of the open file
+  //--------------------------------------------------------------------------------------------------------------------
+  const Header &header() const { return m_header; }
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the byte offset of each section, from the element counts in _header, plus the total file size
+  //--------------------------------------------------------------------------------------------------------------------
+  static std::vector<size_t> sectionOffsets(const Header &_header);
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the open file, kept open between open() and read() so the sections read are the ones the header checked.
+  /// Seeking and reading change its state, hence mutable
+  //--------------------------------------------------------------------------------------------------------------------
+  mutable std::ifstream m_file;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief copy of the header of the open file, and the byte offsets of its sections
+  //--------------------------------------------------------------------------------------------------------------------
+  Header m_header = {};
+  std::vector<size_t> m_offsets;
+};
+
+#endif //INSTANCECACHEFILE_H_
@@ -7,6 +7,7 @@
 /// Revision History :
 /// 6/4/16: This was originally copied from the SimpleIndexVAO class in the ngl library
 /// 26/09/19: rewritten by Ben Carey for use in ForestGenerator project
+/// 18/10/26: one VAO per tree type, drawing every instance in its cache with a single multi-draw-indirect call
 //----------------------------------------------------------------------------------------------------------------------
 
 
@@ -15,24 +16,47 @@
 
 #include "ngl/AbstractVAO.h"
 #include "ngl/Mat4.h"
+#include "AffineTransform.h"
+#include <vector>
 
 namespace ngl
 {
 
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief draws every instance in the instance cache of a tree type. The hero tree geometry of the tree type is uploaded
+/// once into a shared vertex and index buffer, and the transforms of every instance into one instance buffer. Each
+/// instance in the cache is then one command of a glMultiDrawElementsIndirect call, which picks out the instance's
+/// range of the index buffer and, through its base instance, its range of the instance buffer
+//----------------------------------------------------------------------------------------------------------------------
+
 class NGL_DLLEXPORT InstanceCacheVAO : public AbstractVAO
 {
   public :
 
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief one draw command, laid out as GL expects in the indirect buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    struct DrawCommand
+    {
+      GLuint m_count;
+      GLuint m_instanceCount;
+      GLuint m_firstIndex;
+      GLint m_baseVertex;
+      GLuint m_baseInstance;
+    };
+
     class VertexData : public AbstractVAO::VertexData
     {
     public :
       VertexData(size_t _size, const GLfloat &_data,
                  unsigned int _indexSize,const GLvoid *_indexData,
-                 unsigned int _instanceCount, const GLvoid * _transformData,
+                 unsigned int _instanceCount, const AffineTransform * _transformData,
+                 unsigned int _commandCount, const DrawCommand * _commandData,
                  GLenum _mode=GL_STATIC_DRAW) :
           AbstractVAO::VertexData(_size,_data,_mode),
           m_indexSize(_indexSize), m_indexData(_indexData),
-          m_instanceCount(_instanceCount), m_transformData(_transformData)
+          m_instanceCount(_instanceCount), m_transformData(_transformData),
+          m_commandCount(_commandCount), m_commandData(_commandData)
       {}
 
       unsigned int m_indexSize;
@@ -40,7 +64,10 @@ class NGL_DLLEXPORT InstanceCacheVAO : public AbstractVAO
       GLenum m_indexType = GL_UNSIGNED_SHORT;
 
       unsigned int m_instanceCount;
-      const GLvoid * m_transformData;
+      const AffineTransform * m_transformData;
+
+      unsigned int m_commandCount;
+      const DrawCommand * m_commandData;
     };
 
     //----------------------------------------------------------------------------------------------------------------------
@@ -50,7 +77,7 @@ class NGL_DLLEXPORT InstanceCacheVAO : public AbstractVAO
     //----------------------------------------------------------------------------------------------------------------------
     static std::unique_ptr<AbstractVAO> create(GLenum _mode=GL_TRIANGLES) { return std::unique_ptr<AbstractVAO>(new InstanceCacheVAO(_mode)); }
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief draw the VAO using glDrawArrays
+    /// @brief draw every command with glMultiDrawElementsIndirect
     //----------------------------------------------------------------------------------------------------------------------
     virtual void draw()  const override;
     //----------------------------------------------------------------------------------------------------------------------
@@ -87,6 +114,22 @@ class NGL_DLLEXPORT InstanceCacheVAO : public AbstractVAO
      /// @param _mode the access more
      //----------------------------------------------------------------------------------------------------------------------
      Real * mapBuffer(unsigned int _index=0, GLenum _accessMode=GL_READ_WRITE) override;
+     //----------------------------------------------------------------------------------------------------------------------
+     /// @brief replaces the instance buffer and draw commands, keeping the geometry - used to draw only the
+     /// instances that survive culling each frame
+     /// @param _instanceCount the number of transforms in _transformData
+     /// @param _commandCount the number of commands in _commandData
+     //----------------------------------------------------------------------------------------------------------------------
+     void setInstanceData(unsigned int _instanceCount, const AffineTransform * _transformData,
+                          unsigned int _commandCount, const DrawCommand * _commandData);
+     //----------------------------------------------------------------------------------------------------------------------
+     /// @brief the commands that draw() submits
+     //----------------------------------------------------------------------------------------------------------------------
+     const std::vector<DrawCommand> &commands() const { return m_commands; }
+     //----------------------------------------------------------------------------------------------------------------------
+     /// @brief the number of GL draw calls draw() makes - one multi-draw, or one per command where there is none
+     //----------------------------------------------------------------------------------------------------------------------
+     size_t numDrawCalls() const;
 
 
   protected :
@@ -105,12 +148,17 @@ class NGL_DLLEXPORT InstanceCacheVAO : public AbstractVAO
     GLuint m_buffer=0;
     GLuint m_idxBuffer=0;
     GLuint m_transformBuffer=0;
+    GLuint m_indirectBuffer=0;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief data type of the index data (e.g. GL_UNSIGNED_INT)
     //----------------------------------------------------------------------------------------------------------------------
     GLenum m_indexType;
 
     GLuint m_instanceCount;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the draw commands - also kept on the CPU for contexts without multi-draw-indirect (GL < 4.3, ie. macOS)
+    //----------------------------------------------------------------------------------------------------------------------
+    std::vector<DrawCommand> m_commands;
 
 
 };
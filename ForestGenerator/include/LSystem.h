@@ -8,13 +8,20 @@
 #ifndef LSYSTEM_H_
 #define LSYSTEM_H_
 
+#include <array>
+#include <bitset>
+#include <memory>
 #include <vector>
-#include <random>
+#include <memory_resource>
 #include <ngl/Vec3.h>
 #include <ngl/Mat4.h>
 #include "Instance.h"
-#include "InstanceCacheMacros.h"
+#include "InstanceCache.h"
+#include "MemoryReport.h"
+#include "PreferenceCurve.h"
 #include "PrintFunctions.h"
+#include "RandomStream.h"
+#include "ScratchArena.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 /// @class LSystem
@@ -72,6 +79,53 @@ public://-----------------------------------------------------------------------
     void normalizeProbabilities();
   };
 
+  //BRANCH STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @struct Branch
+  /// @brief indices of the matching '[' and ']' of a branch in a rule's RHS
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Branch
+  {
+    size_t m_open;
+    size_t m_close;
+  };
+
+  //GEOMETRY STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @struct Geometry
+  /// @brief the line geometry of one tree, as drawn by the tree tabs
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Geometry
+  {
+    std::vector<ngl::Vec3> m_vertices;
+    std::vector<GLshort> m_indices;
+  };
+
+  //HERO TREES STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @struct HeroTrees
+  /// @brief everything fillInstanceCache() grows for a forest - the geometry of the hero trees, the instances cut from
+  /// them, and their exit points
+  //--------------------------------------------------------------------------------------------------------------------
+  struct HeroTrees
+  {
+    //------------------------------------------------------------------------------------------------------------------
+    /// @brief the geometry of every hero tree, which each instance is a range of indices into
+    //------------------------------------------------------------------------------------------------------------------
+    std::vector<ngl::Vec3> m_vertices;
+    std::vector<GLshort> m_indices;
+    //------------------------------------------------------------------------------------------------------------------
+    /// @brief instances separated by id, then by age, then by inner index for multiple possible instances of the same
+    /// id and age, so accessing an instance is done by m_instanceCache.at(id,age,randomizer)
+    //------------------------------------------------------------------------------------------------------------------
+    InstanceCache<Instance> m_instanceCache;
+    //------------------------------------------------------------------------------------------------------------------
+    /// @brief exit points of every instance in m_instanceCache, grouped by instance so that each instance's exit points
+    /// are contiguous (see Instance::m_exitPointStart)
+    //------------------------------------------------------------------------------------------------------------------
+    std::vector<Instance::ExitPoint> m_exitPoints;
+  };
+
   std::string m_name;
 
   //PUBLIC MEMBER VARIABLES
@@ -92,6 +146,10 @@ public://-----------------------------------------------------------------------
   //--------------------------------------------------------------------------------------------------------------------
   std::string m_nonTerminals;
   //--------------------------------------------------------------------------------------------------------------------
+  /// @brief set of all characters appearing in a LHS, indexed by character, for constant time non-terminal lookups
+  //--------------------------------------------------------------------------------------------------------------------
+  std::bitset<256> m_nonTerminalSet;
+  //--------------------------------------------------------------------------------------------------------------------
   /// @brief the branches introduced by rules in the L-system
   //--------------------------------------------------------------------------------------------------------------------
   std::vector<std::string> m_branches;  
@@ -125,8 +183,15 @@ public://-----------------------------------------------------------------------
   //--------------------------------------------------------------------------------------------------------------------
   bool m_useSeed = false;
 
-  //the random number generator
-  std::default_random_engine m_gen;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the seed used for this generation's random streams - either m_seed or taken from the time by
+  /// seedRandomEngine()
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t m_randomSeed = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief index of the tree currently being generated, so each hero tree in the instance cache gets its own streams
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_treeIndex = 0;
 
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief bool to tell if an error was thrown while parsing brackets when creating geometry
@@ -137,34 +202,44 @@ public://-----------------------------------------------------------------------
   /// @brief probability of instancing a given branch
   //--------------------------------------------------------------------------------------------------------------------
   float m_instancingProb = 0.6f;
-
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief vertex list to store the vertices of L-system geometry
+  /// @brief the closest that trees of this type are placed to other trees by a Poisson-disk forest scatter
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_scatterRadius = 50.0f;
   //--------------------------------------------------------------------------------------------------------------------
-  std::vector<ngl::Vec3> m_vertices;
+  /// @brief how well trees of this type grow at each altitude, and on each slope in degrees, for a forest scattered
+  /// from density maps
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief index list to tell ngl how to draw the order to draw the L-system vertices in
+  PreferenceCurve m_altitudePreference;
+  PreferenceCurve m_slopePreference = {0.0f, 25.0f, 15.0f};
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief what createGeometry() and fillInstanceCache() last generated. These are never changed once made - each
+  /// regeneration makes new ones - so copies of the LSystem, such as a forest's tree types or a build running on a
+  /// worker thread, share them instead of copying them, and keep their own if the original is regenerated. Empty
+  /// until generated, and read through geometry() and heroTrees()
   //--------------------------------------------------------------------------------------------------------------------
-  std::vector<GLshort> m_indices;
+  std::shared_ptr<const Geometry> m_geometry;
+  std::shared_ptr<const HeroTrees> m_heroTrees;
 
-  std::vector<ngl::Vec3> m_heroVertices = {};
-  std::vector<GLshort> m_heroIndices= {};
-  bool m_forestMode = false;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief arena backing the temporary strings and turtle stacks used by generateTreeString(), createGeometry(),
+  /// breakDownRules() and countBranches() - reset (not freed) at the end of each of these calls
+  //--------------------------------------------------------------------------------------------------------------------
+  ScratchArena m_scratch;
 
   size_t m_maxInstancePerLevel = 10;
 
-  //instance cache is vectors of instances nested 3 deep
-  //outer layer separates instances by id
-  //middle layer separates instances of the same id by age
-  //inner layer separates multiple possible instances of the same id and age
-  //so accessing an istance is done by instanceCache[id][age][randomizer]
-  CACHE_STRUCTURE(Instance) m_instanceCache;
-
   ///@brief makes hero trees to fill instance cache
   void fillInstanceCache(int _numHeroTrees);
 
   //PUBLIC MEMBER FUNCTIONS
   //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the generated geometry and hero trees, or empty ones if they haven't been generated
+  //--------------------------------------------------------------------------------------------------------------------
+  const Geometry &geometry() const;
+  const HeroTrees &heroTrees() const;
+  //--------------------------------------------------------------------------------------------------------------------
   /// @brief counts branches in each rule and uses to fill m_rules[i].m_numBranches for each rule
   //--------------------------------------------------------------------------------------------------------------------
   void countBranches();
@@ -172,6 +247,16 @@ public://-----------------------------------------------------------------------
   /// @brief fills m_rules and m_nonTerminals
   //--------------------------------------------------------------------------------------------------------------------
   void breakDownRules(std::vector<std::string> _rules);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns true if the character appears in the LHS of any rule
+  //--------------------------------------------------------------------------------------------------------------------
+  bool isNonTerminal(char _c) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief finds every bracketed branch of _rhs that contains a non-terminal, using a single stack-based pass
+  /// @param [in] _rhs the string to search
+  /// @param [out] _branches the branches found, ordered by the position of their opening bracket
+  //--------------------------------------------------------------------------------------------------------------------
+  void findBranches(const std::string &_rhs, std::pmr::vector<Branch> &_branches) const;
 
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief recreates m_rules to add more RHSs to each rule corresponding to different instancing commands
@@ -187,23 +272,38 @@ public://-----------------------------------------------------------------------
   /// @brief returns a string representation of the tree produced by the L-System
   //--------------------------------------------------------------------------------------------------------------------
   std::string generateTreeString();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief does the work for generateTreeString(), building the string in m_scratch so that createGeometry() can
+  /// read it without a copy onto the heap
+  //--------------------------------------------------------------------------------------------------------------------
+  std::pmr::string deriveTreeString();
 
   //--------------------------------------------------------------------------------------------------------------------
-  /// @brief fills m_vertices and m_indices to represent the geometry of the L-System
+  /// @brief replaces m_geometry with the geometry of the L-System, or if _heroTrees is given, adds it to _heroTrees
+  /// as another hero tree, cutting instances from it as the instancing commands say
   //--------------------------------------------------------------------------------------------------------------------
-  void createGeometry();
+  void createGeometry(HeroTrees * _heroTrees = nullptr);
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief used by createGeometry to deal with parameters enclosed by brackets in the tree string
   /// @param [in] _treeString the string
   /// @param [in] _i the index of _treeString that createGeometry() has reached
   /// @param [in] _paramVar the variable that will be replaced by the parameter in the brackets if needed
   //--------------------------------------------------------------------------------------------------------------------
-  void parseBrackets(const std::string &_treeString, size_t &_i, float &_paramVar);
+  void parseBrackets(const std::pmr::string &_treeString, size_t &_i, float &_paramVar);
 
-  void parseInstanceBrackets(const std::string &_treeString, size_t &_i, size_t &_id, size_t &_age);
-  void skipToNextChevron(const std::string &_treeString, size_t &_i);
+  void parseInstanceBrackets(const std::pmr::string &_treeString, size_t &_i, size_t &_id, size_t &_age);
+  void skipToNextChevron(const std::pmr::string &_treeString, size_t &_i);
 
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief sets m_randomSeed from m_seed, or from the time if m_useSeed is false
+  //--------------------------------------------------------------------------------------------------------------------
   void seedRandomEngine();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory held by the grammar, the scratch arena the tree strings are derived in, the geometry, the
+  /// hero geometry, the instance cache and the exit points. The geometry and hero trees are counted in full even when
+  /// they're shared with copies of this LSystem
+  //--------------------------------------------------------------------------------------------------------------------
+  MemoryReport memoryUsage() const;
 };
 
 
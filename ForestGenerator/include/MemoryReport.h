@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MemoryReport.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef MEMORYREPORT_H_
+#define MEMORYREPORT_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class MemoryReport
+/// @brief the heap memory held by a structure, broken down by member. Reports nest by adding one under a prefix, so
+/// a forest's report holds each species' report as "species 0/..." entries. Sizes are of what the containers have
+/// reserved rather than what they're using, as that's what the process pays for
+//----------------------------------------------------------------------------------------------------------------------
+
+class MemoryReport
+{
+public:
+  //ENTRY STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the bytes held by one part of the structure
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Entry
+  {
+    std::string m_name;
+    size_t m_bytes;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief adds an entry called _name of _bytes
+  //--------------------------------------------------------------------------------------------------------------------
+  void add(const std::string &_name, size_t _bytes);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief adds every entry of _report, with its name prefixed by "_prefix/"
+  //--------------------------------------------------------------------------------------------------------------------
+  void add(const std::string &_prefix, const MemoryReport &_report);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the sum of every entry
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t total() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes one line per entry and one for the total, in KB
+  //--------------------------------------------------------------------------------------------------------------------
+  void print(std::ostream &_out) const;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory reserved by a vector or a string, not counting anything its elements own
+  //--------------------------------------------------------------------------------------------------------------------
+  template <class T>
+  static size_t bytes(const std::vector<T> &_vector) { return _vector.capacity()*sizeof(T); }
+  static size_t bytes(const std::string &_string);
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the entries in the order they were added
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<Entry> m_entries;
+};
+
+#endif //MEMORYREPORT_H_
@@ -11,6 +11,9 @@
 #ifndef NGLSCENE_H_
 #define NGLSCENE_H_
 
+#include <deque>
+#include <map>
+#include <utility>
 #include <vector>
 
 #include <ngl/AbstractVAO.h>
@@ -20,14 +23,18 @@
 #include <QOpenGLWindow>
 #include <memory>
 #include <math.h>
+#include "BackgroundBuild.h"
 #include "Camera.h"
 #include "Forest.h"
+#include "FrameStats.h"
 #include "Grid.h"
+#include "InstanceCacheVAO.h"
 #include "TerrainData.h"
 
 #include <QEvent>
 #include <QResizeEvent>
 #include <QOpenGLWidget>
+#include <QTimer>
 
 //----------------------------------------------------------------------------------------------------------------------
 /// @class NGLScene
@@ -53,6 +60,12 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   ~NGLScene() override;
 
+  //PUBLIC MEMBER FUNCTIONS
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory held by the forest, the terrain LOD and the tree tabs, and the size of each VAO's GL buffers
+  //----------------------------------------------------------------------------------------------------------------------
+  MemoryReport memoryUsage() const;
+
 public slots:
 
   //SLOTS
@@ -135,6 +148,39 @@ public slots:
   void setRule6(QString _rule);
   void setRule7(QString _rule);
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief slots to set the distances from the camera at which the forest switches to its lower level of detail,
+  /// and over which it's thinned out - 0 turns either off
+  /// @param[in] distance, the double passed from m_lodDistance, m_thinningStart or m_thinningEnd in ui
+  //----------------------------------------------------------------------------------------------------------------------
+  void setLODDistance(double _distance);
+  void setThinningStart(double _distance);
+  void setThinningEnd(double _distance);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a slot to write everything traced so far to m_traceFile, which chrome://tracing or ui.perfetto.dev can
+  /// open. Only builds made with CONFIG+=forest_tracing record anything
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeTrace();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a slot to start or stop logging the counters of every frame to m_frameLogFile as CSV
+  //----------------------------------------------------------------------------------------------------------------------
+  void toggleFrameLog();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a slot to print memoryUsage() to the console
+  //----------------------------------------------------------------------------------------------------------------------
+  void printMemoryUsage();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief a slot to cancel the tree and forest builds running in the background, keeping what's drawn now
+  //----------------------------------------------------------------------------------------------------------------------
+  void cancelBuilds();
+
+signals:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief sent after every frame with a summary of m_frameStats, for the status bar
+  //----------------------------------------------------------------------------------------------------------------------
+  void frameStatsChanged(QString _summary);
+
 protected:
 
   //PROTECTED MEMBER VARIABLES
@@ -190,25 +236,44 @@ protected:
   //----------------------------------------------------------------------------------------------------------------------
   std::vector<std::unique_ptr<ngl::AbstractVAO>> m_treeVAOs;
 
-  //nested std::vector of VAOs corresponding to instance caches for the forest rendering
-  //outer layer separates the instance caches of the differing tree types
-  //second layer separates within a cache by id
-  //third layer separates by age
-  //inner index corresponds to different instances of a given age and id
-  std::vector<CACHE_STRUCTURE(std::unique_ptr<ngl::AbstractVAO>)> m_forestVAOs;
+  //VAOs for the forest rendering, one per tree type - each draws every instance in
+  //the tree type's instance cache with one multi-draw call (see InstanceCacheVAO)
+  std::vector<std::unique_ptr<ngl::AbstractVAO>> m_forestVAOs;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief bool to tell paintGL whether or not we need to rebuild the current LSystem VAO
+  /// @brief flags to tell paintGL whether or not we need to rebuild the VAO of each LSystem
   //----------------------------------------------------------------------------------------------------------------------
-  bool m_buildTreeVAO = false;
+  std::vector<bool> m_buildTreeVAOs;
 
-  bool m_buildForestVAOs = false;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief flags for the forest VAO of each tree type, set from Forest::m_regrownTreeTypes so that only the tree
+  /// types a rebuild grew again are rebuilt, and from Forest::m_changedTreeTypes for the ones that only need their
+  /// transforms uploaded again
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<bool> m_buildForestVAOs;
+  std::vector<bool> m_uploadForestTransforms;
   bool m_buildGridVAO = true;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief toggle to cull the forest against the view frustum every frame, rather than drawing every tree
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_cullForest = true;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief distance from the camera past which trees are drawn without their younger branches, set from the render
+  /// tab - 0 turns this off
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_forestLODDistance = 500.0f;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief distances from the camera over which the forest is thinned out to a tenth of its trees, set from the
+  /// render tab - a start of 0 turns this off
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_forestThinningStart = 600.0f;
+  float m_forestThinningEnd = 1500.0f;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief the forest object to be sent to the renderer
+  /// @brief the forest object to be sent to the renderer. It's shared with the worker building the next forest, which
+  /// only reads the generated data that this thread leaves alone - culling writes nothing but the visible trees
   //----------------------------------------------------------------------------------------------------------------------
-  Forest m_forest;
+  std::shared_ptr<Forest> m_forest;
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief width, length and number of trees for m_forest
   //----------------------------------------------------------------------------------------------------------------------
@@ -217,6 +282,56 @@ protected:
   size_t m_numTrees = 1000;
   int m_numHeroTrees = 10;
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief how m_forest scatters its trees - m_numTrees is ignored by a Poisson-disk scatter, which places as many
+  /// trees as the tree types' m_scatterRadius allow
+  //----------------------------------------------------------------------------------------------------------------------
+  Forest::ScatterMode m_scatterMode = Forest::UNIFORM;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where m_forest keeps the instance caches of seeded tree types between runs, relative to the working
+  /// directory - empty to grow every forest's hero trees from scratch
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_instanceCacheDirectory = "instanceCache";
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where writeTrace() puts the trace, relative to the working directory
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_traceFile = "forest_trace.json";
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief frame time, primitive, instance, draw call and upload counters, collected by paintGL() and the VAO builds
+  //----------------------------------------------------------------------------------------------------------------------
+  FrameStats m_frameStats;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief where toggleFrameLog() writes m_frameStats, relative to the working directory
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_frameLogFile = "frame_stats.csv";
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief GL_TIME_ELAPSED queries for timing frames on the GPU. A few are kept in flight so that reading one back
+  /// never waits on the GPU, and a frame that finds none free is only timed on the CPU. Both lists stay empty if the
+  /// context has no timer queries
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<GLuint> m_freeTimerQueries;
+  std::deque<std::pair<GLuint,uint64_t>> m_pendingTimerQueries;
+  const size_t m_numTimerQueries = 4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the bytes last uploaded to each VAO, keyed by the member holding it, for memoryUsage()
+  //----------------------------------------------------------------------------------------------------------------------
+  std::map<const std::unique_ptr<ngl::AbstractVAO> *, size_t> m_vaoBytes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the geometry of each tree tab and the forest are built on worker threads, so the viewport stays
+  /// interactive. paintGL() swaps in each result once it's finished, and the old one is drawn until then
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::unique_ptr<BackgroundBuild<std::shared_ptr<const LSystem::Geometry>>>> m_treeBuilds;
+  BackgroundBuild<Forest> m_forestBuild;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the build keys of the newest forest asked for, so updateForest() doesn't start a build when nothing has
+  /// changed since
+  //----------------------------------------------------------------------------------------------------------------------
+  Forest::BuildKeys m_forestKeys;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief redraws every m_buildPollInterval ms while a build is running, to pick up its result and show its progress
+  //----------------------------------------------------------------------------------------------------------------------
+  QTimer m_buildTimer;
+  const int m_buildPollInterval = 100;
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief list of all L-Systems stored by the scene
   //----------------------------------------------------------------------------------------------------------------------
   std::vector<LSystem> m_LSystems;
@@ -272,19 +387,45 @@ protected:
   /// @brief build an openGL line VAO from lists of vertices and indices (used by paintGL)
   //----------------------------------------------------------------------------------------------------------------------
   template <class dataType>
-  void buildVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, std::vector<ngl::Vec3> &_vertices,
-                std::vector<dataType> &_indices, GLenum _mode, GLenum _indexType);
+  void buildVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, const std::vector<ngl::Vec3> &_vertices,
+                const std::vector<dataType> &_indices, GLenum _mode, GLenum _indexType);
 
   void buildInstanceCacheVAO(std::unique_ptr<ngl::AbstractVAO> &_vao,
-                             LSystem &_treeType, Instance &_instance,
-                             std::vector<ngl::Mat4> &_transforms);
+                             const LSystem &_treeType, const Forest::TransformCache &_transforms);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief one draw command for each instance in the cache of _treeType that has transforms in _transforms
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<ngl::InstanceCacheVAO::DrawCommand> forestDrawCommands(const LSystem &_treeType,
+                                                                     const Forest::TransformCache &_transforms);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief culls m_forest against the frustum of _MVP and uploads the surviving instances to m_forestVAOs
+  //----------------------------------------------------------------------------------------------------------------------
+  void cullForest(const ngl::Mat4 &_MVP);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief uploads _transforms, and the draw commands for them, as the instances of the forest VAO of _treeType
+  //----------------------------------------------------------------------------------------------------------------------
+  void setForestInstances(size_t _treeType, const Forest::TransformCache &_transforms);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief hands the GPU times of any finished timer queries to m_frameStats
+  //----------------------------------------------------------------------------------------------------------------------
+  void collectTimerQueries();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief swaps in the results of any finished builds and marks their VAOs for rebuilding, and stops m_buildTimer
+  /// once nothing is building
+  //----------------------------------------------------------------------------------------------------------------------
+  void takeBuildResults();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the progress of the running builds and the errors of failed ones for the status bar, or an empty string if
+  /// there aren't any
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string buildStatus() const;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief set up the initial L-Systems for each treeTab screen, and sends them to the Forest class
   //----------------------------------------------------------------------------------------------------------------------
   void initializeLSystems();
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief updates forest class when L-Systems change
+  /// @brief starts building a new forest from the L-Systems in the background, cancelling any build already running
   //----------------------------------------------------------------------------------------------------------------------
   void updateForest();
 
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ParallelFor.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef PARALLELFOR_H_
+#define PARALLELFOR_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief returns _requested, or the number of hardware threads if _requested is 0
+//----------------------------------------------------------------------------------------------------------------------
+inline size_t numWorkerThreads(size_t _requested)
+{
+  if(_requested > 0)
+  {
+    return _requested;
+  }
+  return std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief calls _function(i) for every i in [0,_n), spread over up to _numThreads threads, and returns once they have
+/// all finished. The calling thread takes a share of the work rather than waiting idle. Each thread handles a
+/// contiguous block of indices, so callers that split their work into _n chunks get one chunk per thread
+//----------------------------------------------------------------------------------------------------------------------
+template <class Function>
+void parallelFor(size_t _n, size_t _numThreads, Function _function)
+{
+  size_t numThreads = std::min(std::max(size_t(1), _numThreads), _n);
+  if(numThreads <= 1)
+  {
+    for(size_t i=0; i<_n; i++)
+    {
+      _function(i);
+    }
+    return;
+  }
+
+  auto runBlock = [&](size_t _thread)
+  {
+    size_t end = (_thread+1)*_n/numThreads;
+    for(size_t i=_thread*_n/numThreads; i<end; i++)
+    {
+      _function(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads-1);
+  for(size_t t=1; t<numThreads; t++)
+  {
+    threads.emplace_back(runBlock, t);
+  }
+  runBlock(0);
+  for(auto &thread : threads)
+  {
+    thread.join();
+  }
+}
+
+#endif //PARALLELFOR_H_
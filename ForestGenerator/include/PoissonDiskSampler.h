@@ -0,0 +1,91 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PoissonDiskSampler.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef POISSONDISKSAMPLER_H_
+#define POISSONDISKSAMPLER_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "RandomStream.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class PoissonDiskSampler
+/// @brief Bridson's Poisson-disk sampling over a rectangle in the xz plane, with a radius per sample type, for
+/// scattering trees so that no two are closer than their radii allow. Accepted samples are kept in a background grid
+/// with cells small enough to hold at most one sample each, so every candidate only checks a fixed neighbourhood and
+/// the whole scatter runs in linear time.
+///
+/// The rectangle is split into square tiles which are filled in four passes, like the colours of a checkerboard.
+/// Tiles in the same pass are at least a tile apart, so they can be filled on separate threads; each tile starts from
+/// the samples its neighbours from earlier passes left near its border, so there are no seams between tiles. Every
+/// tile has its own random stream and the output is in tile order, so the result doesn't depend on the number of
+/// threads.
+//----------------------------------------------------------------------------------------------------------------------
+
+class PoissonDiskSampler
+{
+public:
+  //SAMPLE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief an accepted sample - its position, its type, and the radius it was accepted with
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Sample
+  {
+    float m_x;
+    float m_z;
+    float m_radius;
+    uint32_t m_type;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief scatters samples over [_minX,_maxX] x [_minZ,_maxZ]
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<Sample> generate(float _minX, float _maxX, float _minZ, float _maxZ) const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the radius of a sample of type _type at (_x,_z) - the type's radius, stretched by 1/sqrt(density) so that
+  /// the number of samples per unit area follows m_density
+  //--------------------------------------------------------------------------------------------------------------------
+  float radius(uint32_t _type, float _x, float _z) const;
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the minimum distance between two samples of each type - two samples of different types must be at least
+  /// the mean of their radii apart. A sample's type is picked uniformly from these
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_radii;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief optional relative density at (x,z), in [m_minDensity,1] - leaving it empty gives a uniform density
+  //--------------------------------------------------------------------------------------------------------------------
+  std::function<float(float,float)> m_density;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief lower bound on m_density. This bounds the largest radius, which sets how far each candidate has to look
+  /// for neighbours, so lowering it makes the sampling slower
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_minDensity = 0.25f;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of candidates tried around each active sample before it's retired - Bridson's k
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numCandidates = 30;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief side length of the tiles - this is raised if needed so tiles in the same pass can't interfere, and 0 picks
+  /// the smallest size that allows
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_tileSize = 0.0f;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of threads used to fill the tiles - 0 means one per hardware thread
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_numThreads = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the random stream of tile t is RandomStream(m_seed, t, m_streamId)
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t m_seed = 0;
+  uint64_t m_streamId = 0;
+};
+
+#endif //POISSONDISKSAMPLER_H_
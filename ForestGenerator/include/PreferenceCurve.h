@@ -0,0 +1,44 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PreferenceCurve.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef PREFERENCECURVE_H_
+#define PREFERENCECURVE_H_
+
+#include <algorithm>
+#include <limits>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class PreferenceCurve
+/// @brief how much a tree type likes a terrain property such as altitude or slope: 1 inside [m_min,m_max], falling
+/// linearly to 0 over m_fade either side of it. The defaults accept every value
+//----------------------------------------------------------------------------------------------------------------------
+
+struct PreferenceCurve
+{
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the preference for _value, in [0,1]
+  //--------------------------------------------------------------------------------------------------------------------
+  float evaluate(float _value) const
+  {
+    float outside = std::max(m_min-_value, _value-m_max);
+    if(outside <= 0.0f)
+    {
+      return 1.0f;
+    }
+    if(m_fade <= 0.0f)
+    {
+      return 0.0f;
+    }
+    return std::max(0.0f, 1.0f-outside/m_fade);
+  }
+
+  float m_min = std::numeric_limits<float>::lowest();
+  float m_max = std::numeric_limits<float>::max();
+  float m_fade = 0.0f;
+};
+
+#endif //PREFERENCECURVE_H_
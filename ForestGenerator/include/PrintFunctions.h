@@ -8,6 +8,7 @@
 #include <ngl/Vec3.h>
 #include <ngl/AbstractVAO.h>
 #include "Instance.h"
+#include "InstanceCache.h"
 
 
 void print(std::string _str);
@@ -42,7 +43,7 @@ void print(std::vector<ngl::Mat4> _vec);
 void print(std::vector<ngl::Mat3> _vec);
 void print(std::vector<ngl::Vec3> _vec);
 
-void printIndices(std::vector<std::vector<std::vector<Instance> > > &_instanceCache);
-void printTransform(std::vector<std::vector<std::vector<Instance> > > &_instanceCache);
+void printIndices(InstanceCache<Instance> &_instanceCache);
+void printTransform(InstanceCache<Instance> &_instanceCache);
 
 #endif //PRINTFUNCTIONS_H_
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file RandomStream.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef RANDOMSTREAM_H_
+#define RANDOMSTREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class RandomStream
+/// @brief counter-based random number generator. A stream is identified by a key made from a seed and up to three ids,
+/// eg. (seed, generation, symbol position) or (seed, tree index, purpose), and the n-th number of a stream is a hash of
+/// (key, n). This means any draw can be computed on its own, in any order and on any thread, and always gives the same
+/// result for the same seed - unlike std::default_random_engine where every draw depends on all the draws before it.
+/// The hash is the SplitMix64 finaliser. The class satisfies UniformRandomBitGenerator so it can also be passed to
+/// the std distributions, though uniform() and index() are used internally since their output is the same on every
+/// platform.
+//----------------------------------------------------------------------------------------------------------------------
+
+class RandomStream
+{
+public:
+  typedef uint64_t result_type;
+
+  //CONSTRUCTOR
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor for RandomStream class
+  /// @param [in] _seed the base seed
+  /// @param [in] _id0, _id1, _id2 ids identifying this stream among all those using the same seed
+  //--------------------------------------------------------------------------------------------------------------------
+  RandomStream(uint64_t _seed, uint64_t _id0=0, uint64_t _id1=0, uint64_t _id2=0) :
+    m_key(mix(mix(mix(mix(_seed) + _id0) + _id1) + _id2)) {}
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the _counter-th number of the stream without affecting the stream position
+  //--------------------------------------------------------------------------------------------------------------------
+  result_type at(uint64_t _counter) const { return mix(m_key + (_counter+1)*s_increment); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the next number of the stream
+  //--------------------------------------------------------------------------------------------------------------------
+  result_type operator()() { return at(m_counter++); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the next number of the stream as a float in [0,1)
+  //--------------------------------------------------------------------------------------------------------------------
+  float uniform() { return float((*this)() >> 40) * (1.0f/16777216.0f); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the next number of the stream as a float in [_min,_max)
+  //--------------------------------------------------------------------------------------------------------------------
+  float uniform(float _min, float _max) { return _min + uniform()*(_max-_min); }
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the next number of the stream as an index in [0,_size)
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t index(size_t _size) { return size_t(((*this)() >> 32) * uint64_t(_size) >> 32); }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the SplitMix64 finaliser, a cheap hash with good avalanche behaviour
+  //--------------------------------------------------------------------------------------------------------------------
+  static uint64_t mix(uint64_t _x)
+  {
+    _x += s_increment;
+    _x = (_x ^ (_x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    _x = (_x ^ (_x >> 27)) * 0x94d049bb133111ebULL;
+    return _x ^ (_x >> 31);
+  }
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the hashed (seed, ids) key identifying the stream
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t m_key;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the position of the next number in the stream
+  //--------------------------------------------------------------------------------------------------------------------
+  uint64_t m_counter = 0;
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the golden ratio increment used by SplitMix64
+  //--------------------------------------------------------------------------------------------------------------------
+  static constexpr uint64_t s_increment = 0x9e3779b97f4a7c15ULL;
+};
+
+#endif //RANDOMSTREAM_H_
@@ -0,0 +1,122 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ScratchArena.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef SCRATCHARENA_H_
+#define SCRATCHARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class ScratchArena
+/// @brief monotonic memory arena for the short-lived strings and vectors used while generating an L-system.
+/// Allocations are served from a buffer that is kept between regenerations: when the outermost Scope closes the
+/// arena is reset rather than freed, and if the last generation spilled over into the heap the buffer is grown so
+/// that the next one fits entirely inside it. The buffer is only allocated when the first Scope opens, so copies of an
+/// LSystem that are never generated from don't pay for it.
+//----------------------------------------------------------------------------------------------------------------------
+
+class ScratchArena
+{
+public:
+  //CONSTRUCTORS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief ctor for ScratchArena class
+  /// @param [in] _initialSize, the number of bytes to reserve up front
+  //--------------------------------------------------------------------------------------------------------------------
+  ScratchArena(size_t _initialSize = 64*1024);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief copy ctor - the arena contents are scratch data so only the buffer size is carried over, to be allocated
+  /// when the copy first opens a Scope
+  //--------------------------------------------------------------------------------------------------------------------
+  ScratchArena(const ScratchArena &_other);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief copy assignment - as with the copy ctor only the buffer size is carried over, and the current buffer is
+  /// freed. Throws std::logic_error if a Scope is open, since pmr containers may still be using the buffer
+  //--------------------------------------------------------------------------------------------------------------------
+  ScratchArena &operator=(const ScratchArena &_other);
+
+  //SCOPE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @struct Scope
+  /// @brief RAII guard opened by each generation call; scopes can be nested (eg. createGeometry() calling
+  /// generateTreeString()) and the arena is only reset when the outermost one closes. Closing the outermost Scope
+  /// is the only way to reset the arena, so nothing allocated inside a Scope is freed while it's open
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Scope
+  {
+    Scope(ScratchArena &_arena);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    ScratchArena &m_arena;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the memory resource that pmr containers should be constructed with
+  //--------------------------------------------------------------------------------------------------------------------
+  std::pmr::memory_resource * resource();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the size of the buffer currently backing the arena, which is 0 until the first Scope opens
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t capacity() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief returns the number of bytes requested from the heap since the last reset
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t overflow() const;
+
+private:
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief upstream resource that forwards to the heap and counts how much the arena had to ask it for
+  //--------------------------------------------------------------------------------------------------------------------
+  class CountingResource : public std::pmr::memory_resource
+  {
+  public:
+    size_t m_bytes = 0;
+  private:
+    void * do_allocate(size_t _bytes, size_t _alignment) override;
+    void do_deallocate(void *_p, size_t _bytes, size_t _alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &_other) const noexcept override;
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief releases everything allocated since the last reset, keeping (and if needed growing) the buffer. Only
+  /// called by the outermost Scope as it closes, once m_arena exists and nothing allocated from it is still alive
+  //--------------------------------------------------------------------------------------------------------------------
+  void reset();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief (re)creates m_arena on top of m_buffer, sized to m_size
+  //--------------------------------------------------------------------------------------------------------------------
+  void rebuild();
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the size m_buffer is given when it's next allocated
+  //--------------------------------------------------------------------------------------------------------------------
+  size_t m_size;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the buffer that is kept between regenerations
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<std::byte> m_buffer;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief heap fallback for when m_buffer runs out
+  //--------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<CountingResource> m_upstream;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the monotonic resource handed out to the generation code, null until the first Scope opens
+  //--------------------------------------------------------------------------------------------------------------------
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief number of currently open scopes
+  //--------------------------------------------------------------------------------------------------------------------
+  int m_depth = 0;
+};
+
+#endif //SCRATCHARENA_H_
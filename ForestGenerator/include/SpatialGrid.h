@@ -0,0 +1,71 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpatialGrid.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef SPATIALGRID_H_
+#define SPATIALGRID_H_
+
+#include <cstdint>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "Frustum.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class SpatialGrid
+/// @brief uniform grid over the xz plane for bounding spheres, eg. the trees of a forest. Each cell keeps the box
+/// bounding all of the spheres whose centres fall in it, so a frustum query can accept or reject whole cells and only
+/// needs to test individual spheres in the cells crossing the edge of the frustum
+//----------------------------------------------------------------------------------------------------------------------
+
+class SpatialGrid
+{
+public:
+  //CELL STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a grid cell - its bounding box, and its spheres as m_count entries of m_items starting from m_start
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Cell
+  {
+    ngl::Vec3 m_min;
+    ngl::Vec3 m_max;
+    uint32_t m_start = 0;
+    uint32_t m_count = 0;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief rebuilds the grid over spheres with the given centres and radii, with square cells of side _cellSize
+  //--------------------------------------------------------------------------------------------------------------------
+  void build(const std::vector<ngl::Vec3> &_centres, const std::vector<float> &_radii, float _cellSize);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief appends the index of every sphere that isn't entirely outside _frustum to _visible, with every sphere and
+  /// cell grown by _margin, for spheres that may have grown since the grid was built
+  //--------------------------------------------------------------------------------------------------------------------
+  void query(const Frustum &_frustum, std::vector<uint32_t> &_visible, float _margin=0.0f) const;
+
+  //PUBLIC MEMBER VARIABLES
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief grid dimensions - cell (x,z) covers [m_originX + x*m_cellSize, m_originX + (x+1)*m_cellSize) in x
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_originX = 0.0f;
+  float m_originZ = 0.0f;
+  float m_cellSize = 1.0f;
+  size_t m_numX = 0;
+  size_t m_numZ = 0;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the cells in row major order (index z*m_numX + x), and the sphere indices grouped by cell
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<Cell> m_cells;
+  std::vector<uint32_t> m_items;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the spheres, indexed as they were passed to build()
+  //--------------------------------------------------------------------------------------------------------------------
+  std::vector<ngl::Vec3> m_centres;
+  std::vector<float> m_radii;
+  float m_maxRadius = 0.0f;
+};
+
+#endif //SPATIALGRID_H_
@@ -161,6 +161,16 @@ public:
   /// field of view - or can be changed to increase or decrease effect of the tolerance
   //--------------------------------------------------------------------------------------------------------------------
   void meshRefine(ngl::Vec3 _cameraPos, float _tolerance, float _lambda);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory held by the heightmap, the DAG vertices and their child lists, the vertices arranged by
+  /// graph level, and the refined mesh
+  //--------------------------------------------------------------------------------------------------------------------
+  MemoryReport memoryUsage() const;
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a view of m_heightMap for querying heights, normals and slopes at scene positions
+  //--------------------------------------------------------------------------------------------------------------------
+  Heightmap heightmap() const;
 
 
   //OTHER PUBLIC MEMBER FUNCTIONS - all these functions could be private as they do not need to be accessed outside the
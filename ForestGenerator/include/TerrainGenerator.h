@@ -14,6 +14,8 @@
 #include <iostream>
 #include <vector>
 #include "noiseutils.h"
+#include "Heightmap.h"
+#include "MemoryReport.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 /// @class TerrainGenerator
@@ -44,13 +46,16 @@ public:
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief dimension of terrain being generated (must be 2^n+1 for some n)
   //--------------------------------------------------------------------------------------------------------------------
-  int m_dimension;
+  int m_dimension = 0;
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief heightmap values to be passed into TerrainData class
   //--------------------------------------------------------------------------------------------------------------------
   std::vector<float> m_heightMap;
 
-  float m_scale;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief distance between neighbouring heightmap values in the scene
+  //--------------------------------------------------------------------------------------------------------------------
+  float m_scale = 1.0f;
 
   //--------------------------------------------------------------------------------------------------------------------
   /// @brief seed used to randomise terrain generation
@@ -83,6 +88,15 @@ public:
   /// @brief assigns values to m_heightmap based on current noise attributes
   //--------------------------------------------------------------------------------------------------------------------
   void generate();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a view of m_heightMap for querying heights, normals and slopes at scene positions - it's empty until
+  /// generate() has been called, and is invalidated by the next call
+  //--------------------------------------------------------------------------------------------------------------------
+  Heightmap heightmap() const;
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the heap memory held by m_heightMap
+  //--------------------------------------------------------------------------------------------------------------------
+  MemoryReport memoryUsage() const;
 
 private:
 
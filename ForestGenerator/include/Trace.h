@@ -0,0 +1,108 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Trace.h
+/// @author Ben Carey
+/// @version 1.0
+/// @date 18/10/26
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @class Trace
+/// @brief records timed zones and counters from any thread and writes them out in the Chrome trace event format,
+/// which chrome://tracing and ui.perfetto.dev can both open.
+///
+/// Each thread records into its own fixed size ring buffer, so recording never waits on another thread and a long
+/// running session keeps only the most recent events. Buffers belong to Trace rather than to their thread: events
+/// from a thread that has finished are still written, and its buffer is handed on to the next new thread so that the
+/// short lived threads of parallelFor() don't each open their own track.
+///
+/// The pipeline is instrumented with the FOREST_TRACE_ZONE and FOREST_TRACE_COUNTER macros below, which compile to
+/// nothing unless FOREST_TRACING is defined (qmake CONFIG+=forest_tracing). Zone and counter names must be string
+/// literals, as only the pointer is stored.
+//----------------------------------------------------------------------------------------------------------------------
+
+class Trace
+{
+public:
+  //SCOPE STRUCT
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @struct Scope
+  /// @brief RAII guard that records a zone from its construction to its destruction
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Scope
+  {
+    Scope(const char * _name);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    const char * m_name;
+    int64_t m_start;
+  };
+
+  //PUBLIC MEMBER FUNCTIONS
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief turns recording on or off at run time. Recording is on from the start, and while it is off zones and
+  /// counters cost one atomic load
+  //--------------------------------------------------------------------------------------------------------------------
+  static void setEnabled(bool _enabled);
+  static bool enabled();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief nanoseconds since the process started tracing, the clock that zones are timed with
+  //--------------------------------------------------------------------------------------------------------------------
+  static int64_t now();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief records a zone called _name on the calling thread, from _start to _end
+  //--------------------------------------------------------------------------------------------------------------------
+  static void zone(const char * _name, int64_t _start, int64_t _end);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief records the value of counter _name at this moment
+  //--------------------------------------------------------------------------------------------------------------------
+  static void counter(const char * _name, double _value);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of events each thread's buffer keeps, which only affects buffers made after it is set
+  //--------------------------------------------------------------------------------------------------------------------
+  static void setEventsPerThread(size_t _numEvents);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the number of events currently held across all threads
+  //--------------------------------------------------------------------------------------------------------------------
+  static size_t numEvents();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief throws away every recorded event
+  //--------------------------------------------------------------------------------------------------------------------
+  static void clear();
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes every recorded event as a Chrome trace JSON object, oldest first on each thread
+  //--------------------------------------------------------------------------------------------------------------------
+  static void write(std::ostream &_out);
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes the trace to the file at _path, returning false if it can't be written
+  //--------------------------------------------------------------------------------------------------------------------
+  static bool write(const std::string &_path);
+};
+
+#define FOREST_TRACE_CONCAT_INNER(_a, _b) _a##_b
+#define FOREST_TRACE_CONCAT(_a, _b) FOREST_TRACE_CONCAT_INNER(_a, _b)
+
+#ifdef FOREST_TRACING
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief times the rest of the enclosing block as a zone called _name
+//----------------------------------------------------------------------------------------------------------------------
+#define FOREST_TRACE_ZONE(_name) Trace::Scope FOREST_TRACE_CONCAT(traceScope, __LINE__)(_name)
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief records _value for the counter _name. _value isn't evaluated when tracing is compiled out
+//----------------------------------------------------------------------------------------------------------------------
+#define FOREST_TRACE_COUNTER(_name, _value) Trace::counter(_name, double(_value))
+#else
+#define FOREST_TRACE_ZONE(_name) do {} while(false)
+#define FOREST_TRACE_COUNTER(_name, _value) do {} while(false)
+#endif
+
+#endif //TRACE_H_
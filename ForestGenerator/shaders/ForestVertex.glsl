@@ -3,13 +3,21 @@
 /// @brief the vertex passed in
 layout(location =0)in vec3 inVert;
 
-layout(location =1)in mat4 transform;
+/// @brief the instance transform, passed as the four rows of an AffineTransform
+layout(location =1)in vec3 transformX;
+layout(location =2)in vec3 transformY;
+layout(location =3)in vec3 transformZ;
+layout(location =4)in vec3 transformT;
 
 uniform mat4 MVP;
 out vec3 vertColour;
 
 void main()
 {
+  mat4 transform = mat4(vec4(transformX,0.0),
+                        vec4(transformY,0.0),
+                        vec4(transformZ,0.0),
+                        vec4(transformT,1.0));
   gl_Position = MVP*transform*vec4(inVert,1.0);
   vertColour = vec3(inVert[0]/10,inVert[1]/10,0);
 }
@@ -0,0 +1,103 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DensityMap.cpp
+/// @brief implementation file for DensityMap class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include "DensityMap.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void DensityMap::resize(size_t _numX, size_t _numZ, float _minX, float _maxX, float _minZ, float _maxZ)
+{
+  m_numX = std::max(size_t(1), _numX);
+  m_numZ = std::max(size_t(1), _numZ);
+  m_minX = _minX;
+  m_minZ = _minZ;
+  m_cellWidth = (_maxX-_minX)/float(m_numX);
+  m_cellLength = (_maxZ-_minZ)/float(m_numZ);
+  m_values.assign(m_numX*m_numZ, 0.0f);
+  m_probability = {};
+  m_alias = {};
+  m_total = 0.0;
+}
+
+size_t DensityMap::cellIndex(float _x, float _z) const
+{
+  float x = std::max(0.0f, (_x-m_minX)/m_cellWidth);
+  float z = std::max(0.0f, (_z-m_minZ)/m_cellLength);
+  return std::min(m_numZ-1, size_t(z))*m_numX + std::min(m_numX-1, size_t(x));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void DensityMap::buildSampler()
+{
+  size_t n = m_values.size();
+  m_probability.assign(n, 1.0f);
+  m_alias.resize(n);
+  m_total = 0.0;
+  for(float value : m_values)
+  {
+    m_total += double(std::max(0.0f, value));
+  }
+  if(m_total <= 0.0)
+  {
+    return;
+  }
+
+  //Vose's method: scale the weights so they average 1, then repeatedly fill up a cell below 1 with the excess of a
+  //cell above 1, which becomes its alias
+  std::vector<double> scaled(n);
+  std::vector<uint32_t> small;
+  std::vector<uint32_t> large;
+  for(size_t i=0; i<n; i++)
+  {
+    m_alias[i] = uint32_t(i);
+    scaled[i] = double(std::max(0.0f, m_values[i]))*double(n)/m_total;
+    (scaled[i] < 1.0 ? small : large).push_back(uint32_t(i));
+  }
+  while(!small.empty() && !large.empty())
+  {
+    uint32_t s = small.back();
+    small.pop_back();
+    uint32_t l = large.back();
+    m_probability[s] = float(scaled[s]);
+    m_alias[s] = l;
+    scaled[l] = (scaled[l]+scaled[s])-1.0;
+    if(scaled[l] < 1.0)
+    {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  //whatever is left is 1 up to rounding error
+  for(uint32_t i : small)
+  {
+    m_probability[i] = 1.0f;
+  }
+  for(uint32_t i : large)
+  {
+    m_probability[i] = 1.0f;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+size_t DensityMap::sampleCell(RandomStream &_stream) const
+{
+  size_t i = _stream.index(m_probability.size());
+  return _stream.uniform() < m_probability[i] ? i : m_alias[i];
+}
+
+bool DensityMap::sample(RandomStream &_stream, float &_x, float &_z) const
+{
+  if(m_total <= 0.0 || m_probability.empty())
+  {
+    return false;
+  }
+  size_t cell = sampleCell(_stream);
+  _x = m_minX + (float(cell%m_numX) + _stream.uniform())*m_cellWidth;
+  _z = m_minZ + (float(cell/m_numX) + _stream.uniform())*m_cellLength;
+  return true;
+}
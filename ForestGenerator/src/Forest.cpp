@@ -4,29 +4,239 @@
 //----------------------------------------------------------------------------------------------------------------------
 
 #include <math.h>
+#include <algorithm>
 #include <chrono>
+#include <iostream>
 #include "Forest.h"
-#include "noiseutils.h"
+#include "Hash.h"
+#include "Trace.h"
 
 Forest::Forest(const std::vector<LSystem> &_treeTypes,
                float _width, float _length,
                size_t _numTrees, int _numHeroTrees,
-               int _terrainDimension) :
+               int _terrainDimension, ScatterMode _scatterMode,
+               const std::string &_cacheDirectory) :
+  Forest(_treeTypes, _width, _length, _numTrees, _numHeroTrees,
+         TerrainGenerator(_terrainDimension, _width), _scatterMode, _cacheDirectory) {}
+
+Forest::Forest(const std::vector<LSystem> &_treeTypes,
+               float _width, float _length,
+               size_t _numTrees, int _numHeroTrees,
+               const TerrainGenerator &_terrain, ScatterMode _scatterMode,
+               const std::string &_cacheDirectory) :
   m_treeTypes(_treeTypes), m_width(_width), m_length(_length),
-  m_numTrees(_numTrees), m_numHeroTrees(_numHeroTrees)
+  m_numTrees(_numTrees), m_scatterMode(_scatterMode), m_numHeroTrees(_numHeroTrees),
+  m_cacheDirectory(_cacheDirectory), m_terrainGen(_terrain)
+{
+  generate();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool Forest::generate()
 {
-  m_terrainGen = TerrainGenerator(_terrainDimension, _width);
+  m_stageTimes = {};
+  BuildKeys keys = buildKeys();
+  size_t numTreeTypes = m_treeTypes.size();
+  m_builtKeys.m_treeTypes.resize(numTreeTypes, 0);
 
-  scatterForest();
+  //a Poisson-disk scatter's density function can't be hashed, so a scatter using one is always redone
+  bool terrain = keys.m_terrain != m_builtKeys.m_terrain;
+  bool scatter = keys.m_scatter != m_builtKeys.m_scatter || (m_scatterMode == POISSON_DISK && m_scatterDensity);
+  //a new scatter, or new prototype picks, moves every tree, but the prototypes themselves are only baked again when
+  //their own key or their tree type changes. Without a fixed seed they're new every time
+  bool place = scatter || keys.m_forest != m_builtKeys.m_forest;
+  bool rebakeAll = keys.m_prototypes != m_builtKeys.m_prototypes || m_prototypes.size() != numTreeTypes || !m_useSeed;
+  std::vector<bool> grow(numTreeTypes);
+  std::vector<bool> rebake(numTreeTypes);
+  bool growAny = false;
+  bool rebakeAny = rebakeAll;
+  for(size_t t=0; t<numTreeTypes; t++)
+  {
+    grow[t] = m_builtKeys.m_treeTypes[t] == 0;
+    rebake[t] = rebakeAll || grow[t];
+    growAny = growAny || grow[t];
+    rebakeAny = rebakeAny || rebake[t];
+  }
+
+  //each stage is counted as an equal share of the progress, whether or not it's run
+  const float numStages = 4.0f;
+  float stage = 0.0f;
+  auto timeStage = [&](const char * _stage, bool _run, auto _function)
+  {
+    float index = stage++;
+    if(m_progress)
+    {
+      if(m_progress->cancelled())
+      {
+        return false;
+      }
+      m_progress->set(_stage, index/numStages);
+    }
+    if(!_run)
+    {
+      return true;
+    }
+    FOREST_TRACE_ZONE(_stage);
+    auto start = std::chrono::steady_clock::now();
+    _function();
+    std::chrono::duration<double,std::milli> time = std::chrono::steady_clock::now()-start;
+    m_stageTimes.push_back({_stage, time.count()});
+    return true;
+  };
+
+  auto forest = [&]
+  {
+    createForest(rebake);
+    m_builtKeys.m_prototypes = keys.m_prototypes;
+    m_builtKeys.m_forest = keys.m_forest;
+  };
+  m_changedTreeTypes.assign(numTreeTypes, false);
+  m_regrownTreeTypes = grow;
+  bool finished =
+    timeStage("terrain", terrain, [&]{ m_terrainGen.generate(); m_builtKeys.m_terrain = keys.m_terrain; }) &&
+    timeStage("scatter", scatter, [&]{ scatterForest(); m_builtKeys.m_scatter = keys.m_scatter; }) &&
+    timeStage("instance caches", growAny, [&]{ fillInstanceCaches(grow); }) &&
+    timeStage("forest", place || rebakeAny, forest) &&
+    !(m_progress && m_progress->cancelled());
+  if(place)
+  {
+    m_changedTreeTypes.assign(numTreeTypes, true);
+  }
+  else if(rebakeAny)
+  {
+    m_changedTreeTypes = rebake;
+  }
+  return finished;
+}
+
+Forest::BuildKeys Forest::buildKeys() const
+{
+  BuildKeys keys;
+  Hash terrain;
+  terrain.value(m_terrainGen.m_dimension);
+  terrain.value(m_terrainGen.m_scale);
+  terrain.value(m_terrainGen.m_seed);
+  terrain.value(m_terrainGen.m_octaves);
+  terrain.value(m_terrainGen.m_frequency);
+  terrain.value(m_terrainGen.m_persistence);
+  terrain.value(m_terrainGen.m_lacunarity);
+  terrain.value(m_terrainGen.m_amplitude);
+  keys.m_terrain = terrain.m_hash;
+
+  Hash scatter;
+  scatter.value(keys.m_terrain);
+  scatter.value(m_width);
+  scatter.value(m_length);
+  scatter.value(int(m_scatterMode));
+  //a Poisson-disk scatter places as many trees as fit and overwrites m_numTrees with that
+  if(m_scatterMode != POISSON_DISK)
+  {
+    scatter.value(uint64_t(m_numTrees));
+  }
+  scatter.value(m_useSeed);
+  scatter.value(uint64_t(m_seed));
+  scatter.value(uint64_t(m_densityResolution));
+  scatter.value(uint64_t(m_treeTypes.size()));
+  for(auto &treeType : m_treeTypes)
+  {
+    scatter.value(treeType.m_scatterRadius);
+    for(const PreferenceCurve * curve : {&treeType.m_altitudePreference, &treeType.m_slopePreference})
+    {
+      scatter.value(curve->m_min);
+      scatter.value(curve->m_max);
+      scatter.value(curve->m_fade);
+    }
+  }
+  keys.m_scatter = scatter.m_hash;
 
   for(auto &treeType : m_treeTypes)
   {
-    treeType.fillInstanceCache(m_numHeroTrees);
+    keys.m_treeTypes.push_back(InstanceCacheFile::key(treeType, m_numHeroTrees));
   }
 
-  createForest();
+  //the prototypes are drawn from streams keyed by the seed, and cut off at m_lodAge - the hero trees they're baked
+  //from are covered by the tree type keys
+  Hash prototypes;
+  prototypes.value(m_useSeed);
+  prototypes.value(uint64_t(m_seed));
+  prototypes.value(uint64_t(m_treeTypes.size()));
+  prototypes.value(uint64_t(m_numPrototypes));
+  prototypes.value(uint64_t(m_lodAge));
+  keys.m_prototypes = prototypes.m_hash;
+
+  Hash forest;
+  forest.value(keys.m_scatter);
+  forest.value(keys.m_prototypes);
+  forest.value(m_gridCellSize);
+  keys.m_forest = forest.m_hash;
+  return keys;
 }
 
+bool Forest::BuildKeys::operator==(const BuildKeys &_other) const
+{
+  return m_terrain == _other.m_terrain && m_scatter == _other.m_scatter && m_treeTypes == _other.m_treeTypes &&
+         m_prototypes == _other.m_prototypes && m_forest == _other.m_forest;
+}
+
+void Forest::reuse(const Forest &_previous)
+{
+  BuildKeys keys = buildKeys();
+  const BuildKeys &built = _previous.m_builtKeys;
+  m_builtKeys = {};
+  m_builtKeys.m_treeTypes.assign(m_treeTypes.size(), 0);
+
+  if(keys.m_terrain == built.m_terrain)
+  {
+    m_terrainGen = _previous.m_terrainGen;
+    m_builtKeys.m_terrain = keys.m_terrain;
+  }
+  if(keys.m_scatter == built.m_scatter)
+  {
+    m_treeData = _previous.m_treeData;
+    m_typeDensity = _previous.m_typeDensity;
+    m_density = _previous.m_density;
+    m_numTrees = _previous.m_numTrees;
+    m_randomSeed = _previous.m_randomSeed;
+    m_builtKeys.m_scatter = keys.m_scatter;
+  }
+  //the prototype key folds in the number of tree types
+  bool prototypes = keys.m_prototypes == built.m_prototypes;
+  if(prototypes)
+  {
+    m_prototypes.resize(m_treeTypes.size());
+    m_lodPrototypes.resize(m_treeTypes.size());
+    m_builtKeys.m_prototypes = keys.m_prototypes;
+  }
+  for(size_t t=0; t<m_treeTypes.size() && t<built.m_treeTypes.size(); t++)
+  {
+    if(built.m_treeTypes[t] == 0 || keys.m_treeTypes[t] != built.m_treeTypes[t])
+    {
+      continue;
+    }
+    //the grown hero trees are the same, but the name and scatter parameters aren't part of their key
+    LSystem treeType = _previous.m_treeTypes[t];
+    treeType.m_name = m_treeTypes[t].m_name;
+    treeType.m_scatterRadius = m_treeTypes[t].m_scatterRadius;
+    treeType.m_altitudePreference = m_treeTypes[t].m_altitudePreference;
+    treeType.m_slopePreference = m_treeTypes[t].m_slopePreference;
+    m_treeTypes[t] = std::move(treeType);
+    m_builtKeys.m_treeTypes[t] = keys.m_treeTypes[t];
+    if(prototypes)
+    {
+      m_prototypes[t] = _previous.m_prototypes[t];
+      m_lodPrototypes[t] = _previous.m_lodPrototypes[t];
+    }
+  }
+  //the forest key folds in the scatter and prototype keys
+  if(keys.m_forest == built.m_forest)
+  {
+    m_treePrototypes = _previous.m_treePrototypes;
+    m_treeGrid = _previous.m_treeGrid;
+    m_transformCache = _previous.m_transformCache;
+    m_builtKeys.m_forest = keys.m_forest;
+  }
+}
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -38,14 +248,14 @@ Forest::OutputData::OutputData(ngl::Mat4 _transform, size_t _treeType,
   m_transform(_transform), m_treeType(_treeType),
   m_id(_id), m_age(_age), m_innerIndex(_innerIndex) {}
 
-void Forest::resizeTransformCache()
+size_t Forest::TransformCache::size(size_t _k) const
 {
-  m_transformCache={};
-  m_transformCache.resize(m_treeTypes.size());
-  for(size_t t=0; t<m_treeTypes.size(); t++)
-  {
-    RESIZE_CACHE_BY_OTHER_CACHE(m_transformCache[t], m_treeTypes[t].m_instanceCache)
-  }
+  return m_offsets[_k+1]-m_offsets[_k];
+}
+
+const AffineTransform * Forest::TransformCache::data(size_t _k) const
+{
+  return m_transforms.data()+m_offsets[_k];
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -61,66 +271,222 @@ void Forest::seedRandomEngine()
   {
     seed = size_t(std::chrono::system_clock::now().time_since_epoch().count());
   }
-  m_gen.seed(seed);
+  m_randomSeed = seed;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Forest::fillInstanceCaches(const std::vector<bool> &_treeTypes)
+{
+  m_builtKeys.m_treeTypes.resize(m_treeTypes.size(), 0);
+  for(size_t t=0; t<m_treeTypes.size(); t++)
+  {
+    if(!_treeTypes.empty() && !_treeTypes[t])
+    {
+      continue;
+    }
+    LSystem &treeType = m_treeTypes[t];
+    if(m_progress)
+    {
+      //the third of the four stages of generate(), and the slow one, so each species is reported and can be cancelled
+      if(m_progress->cancelled())
+      {
+        return;
+      }
+      m_progress->set("instance caches", (2.0f+float(t)/float(m_treeTypes.size()))/4.0f);
+    }
+    //the key has to be taken before growing, which rewrites the rules
+    uint64_t key = InstanceCacheFile::key(treeType, m_numHeroTrees);
+    m_builtKeys.m_treeTypes[t] = key;
+    //without a fixed seed the hero trees are different every time, so there's nothing to reuse
+    if(m_cacheDirectory.empty() || !treeType.m_useSeed)
+    {
+      treeType.fillInstanceCache(m_numHeroTrees);
+      continue;
+    }
+    std::string path = InstanceCacheFile::path(m_cacheDirectory, key);
+    InstanceCacheFile file;
+    if(file.open(path, key) && file.read(treeType))
+    {
+      //leave the rules and random seed as fillInstanceCache() would have
+      treeType.seedRandomEngine();
+      treeType.addInstancingCommands();
+    }
+    else
+    {
+      treeType.fillInstanceCache(m_numHeroTrees);
+      if(!InstanceCacheFile::write(path, key, treeType))
+      {
+        std::cerr<<"WARNING: unable to write the instance cache "<<path<<"\n";
+      }
+    }
+  }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
 void Forest::scatterForest()
 {
+  FOREST_TRACE_ZONE("Forest::scatterForest");
   seedRandomEngine();
   m_treeData = {};
+  Heightmap heightmap = m_terrainGen.heightmap();
 
-  std::uniform_real_distribution<float> distX(-m_width*0.5f, m_width*0.5f);
-  std::uniform_real_distribution<float> distZ(-m_length*0.5f, m_length*0.5f);
-  std::uniform_real_distribution<float> distRotate(0,360);
-  std::uniform_real_distribution<float> distScale(0.6f,0.8f);
-  std::uniform_int_distribution<size_t> distTreeType(0,m_treeTypes.size()-1);
+  std::vector<PoissonDiskSampler::Sample> samples;
+  if(m_scatterMode == POISSON_DISK)
+  {
+    PoissonDiskSampler sampler;
+    for(auto &treeType : m_treeTypes)
+    {
+      sampler.m_radii.push_back(treeType.m_scatterRadius);
+    }
+    sampler.m_density = m_scatterDensity;
+    sampler.m_numThreads = m_numThreads;
+    sampler.m_seed = m_randomSeed;
+    sampler.m_streamId = POISSON_DISK_TILE;
+    samples = sampler.generate(-m_width*0.5f, m_width*0.5f, -m_length*0.5f, m_length*0.5f);
+    m_numTrees = samples.size();
+  }
+  else if(m_scatterMode == DENSITY_MAP)
+  {
+    buildDensityMaps(heightmap);
+  }
 
-  noise::module::Perlin perlinModule;
-  perlinModule.SetOctaveCount(m_terrainGen.m_octaves);
-  perlinModule.SetFrequency(m_terrainGen.m_frequency);
-  perlinModule.SetPersistence(m_terrainGen.m_persistence);
-  perlinModule.SetLacunarity(m_terrainGen.m_lacunarity);
+  //positions, orientations, scales and types first, then the heights of every tree in one batch
+  std::vector<float> xPos(m_numTrees);
+  std::vector<float> zPos(m_numTrees);
+  std::vector<float> angles(m_numTrees);
+  std::vector<float> scales(m_numTrees);
+  std::vector<size_t> types(m_numTrees);
+  for(size_t i=0; i<m_numTrees; i++)
+  {
+    //each tree has its own stream, so its placement doesn't depend on any other tree's
+    RandomStream stream(m_randomSeed, i, SCATTER);
+    if(m_scatterMode == POISSON_DISK)
+    {
+      xPos[i] = samples[i].m_x;
+      zPos[i] = samples[i].m_z;
+    }
+    else if(m_scatterMode == DENSITY_MAP)
+    {
+      //no tree type can grow anywhere on this terrain
+      if(!m_density.sample(stream, xPos[i], zPos[i]))
+      {
+        m_numTrees = 0;
+        break;
+      }
+    }
+    else
+    {
+      xPos[i] = stream.uniform(-m_width*0.5f, m_width*0.5f);
+      zPos[i] = stream.uniform(-m_length*0.5f, m_length*0.5f);
+    }
+    angles[i] = stream.uniform(0,360);
+    scales[i] = stream.uniform(0.6f,0.8f);
+    if(m_scatterMode == POISSON_DISK)
+    {
+      types[i] = samples[i].m_type;
+    }
+    else if(m_scatterMode == DENSITY_MAP)
+    {
+      types[i] = pickTreeType(m_density.cellIndex(xPos[i], zPos[i]), stream);
+    }
+    else
+    {
+      types[i] = stream.index(m_treeTypes.size());
+    }
+  }
+
+  std::vector<float> yPos(m_numTrees);
+  heightmap.heights(xPos.data(), zPos.data(), m_numTrees, yPos.data());
 
   for(size_t i=0; i<m_numTrees; i++)
   {
     ngl::Mat4 position;
     ngl::Mat4 orientation;
     ngl::Mat4 scale;
-    float xPos = distX(m_gen);
-    float zPos = distZ(m_gen);
-    float yPos = float(perlinModule.GetValue(double(xPos),
-                                             double(zPos),
-                                             m_terrainGen.m_seed));
-    yPos *= m_terrainGen.m_amplitude;
-    position.translate(xPos,yPos,zPos);
-    orientation.rotateY(distRotate(m_gen));
-    scale = distScale(m_gen)*scale;
-    m_treeData.push_back(Tree(distTreeType(m_gen), position*orientation*scale));
+    position.translate(xPos[i],yPos[i],zPos[i]);
+    orientation.rotateY(angles[i]);
+    //only the basis is scaled - multiplying the whole matrix would scale w as well, which moves the tree towards
+    //the origin once the last column is dropped
+    scale.m_00 = scales[i];
+    scale.m_11 = scales[i];
+    scale.m_22 = scales[i];
+    m_treeData.push_back(Tree(types[i], position*orientation*scale));
+    m_treeData.back().m_importance = RandomStream(m_randomSeed, i, IMPORTANCE).uniform();
+  }
+}
+
+void Forest::buildDensityMaps(const Heightmap &_heightmap)
+{
+  size_t n = std::max(size_t(1), m_densityResolution);
+  float minX = -m_width*0.5f;
+  float minZ = -m_length*0.5f;
+  m_density.resize(n, n, minX, -minX, minZ, -minZ);
+  m_typeDensity.assign(m_treeTypes.size(), m_density);
+
+  parallelFor(n, numWorkerThreads(m_numThreads), [&](size_t _z)
+  {
+    for(size_t x=0; x<n; x++)
+    {
+      float altitude = _heightmap.height(m_density.cellX(x), m_density.cellZ(_z));
+      float slope = _heightmap.slope(m_density.cellX(x), m_density.cellZ(_z));
+
+      float total = 0.0f;
+      for(size_t t=0; t<m_treeTypes.size(); t++)
+      {
+        float density = m_treeTypes[t].m_altitudePreference.evaluate(altitude)*
+                        m_treeTypes[t].m_slopePreference.evaluate(slope);
+        m_typeDensity[t].at(x,_z) = density;
+        total += density;
+      }
+      m_density.at(x,_z) = total;
+    }
+  });
+  m_density.buildSampler();
+}
+
+size_t Forest::pickTreeType(size_t _cell, RandomStream &_stream) const
+{
+  float target = _stream.uniform()*m_density.m_values[_cell];
+  for(size_t t=0; t+1<m_typeDensity.size(); t++)
+  {
+    target -= m_typeDensity[t].m_values[_cell];
+    if(target < 0.0f)
+    {
+      return t;
+    }
   }
+  return m_typeDensity.size()-1;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Forest::createTree(size_t _treeType, ngl::Mat4 _transform, size_t _id, size_t _age)
+void Forest::createTree(size_t _treeType, ngl::Mat4 _transform, size_t _id, size_t _age, RandomStream &_stream,
+                        Prototype &_prototype, size_t _pathAge)
 {
-  LSystem &treeType = m_treeTypes[_treeType];
-  size_t size = treeType.m_instanceCache.at(_id).at(_age).size();
+  const LSystem &treeType = m_treeTypes[_treeType];
+  const LSystem::HeroTrees &heroTrees = treeType.heroTrees();
+  size_t size = heroTrees.m_instanceCache.size(_id,_age);
   if(size>0)
   {
     size_t innerIndex = 0;
-    Instance * instance = getInstance(treeType, _id, _age, innerIndex);
+    const Instance * instance = getInstance(treeType, _id, _age, innerIndex, _stream);
     ngl::Mat4 T = _transform * instance->m_transform.inverse();
-    m_transformCache.at(_treeType).at(_id).at(_age).at(innerIndex).push_back(T);
+    _prototype.m_slots.push_back(uint32_t(heroTrees.m_instanceCache.offset(_id,_age)+innerIndex));
+    _prototype.m_transforms.push_back(T);
+    size_t pathAge = std::max(_pathAge, _age);
+    _prototype.m_ages.push_back(uint32_t(pathAge));
 
-    for(size_t i=0; i<instance->m_exitPoints.size(); i++)
+    //this instance's exit points are a contiguous run of the tree type's exit point array
+    const Instance::ExitPoint * exitPoints = heroTrees.m_exitPoints.data()+instance->m_exitPointStart;
+    for(uint32_t i=0; i<instance->m_numExitPoints; i++)
     {
-      size_t newAge = instance->m_exitPoints[i].m_exitAge;
-      size_t newId = instance->m_exitPoints[i].m_exitId;
-      ngl::Mat4 exitTransform = instance->m_exitPoints[i].m_exitTransform;
+      size_t newAge = exitPoints[i].m_exitAge;
+      size_t newId = exitPoints[i].m_exitId;
+      ngl::Mat4 exitTransform = exitPoints[i].m_exitTransform.toMat4();
       ngl::Mat4 newTransform = _transform * exitTransform;
-      createTree(_treeType, newTransform, newId, newAge);
+      createTree(_treeType, newTransform, newId, newAge, _stream, _prototype, pathAge);
     }
   }
   else
@@ -129,20 +495,461 @@ void Forest::createTree(size_t _treeType, ngl::Mat4 _transform, size_t _id, size
   }
 }
 
-Instance * Forest::getInstance(LSystem &_treeType, size_t _id, size_t _age, size_t &_innerIndex)
+const Instance * Forest::getInstance(const LSystem &_treeType, size_t _id, size_t _age, size_t &_innerIndex,
+                                     RandomStream &_stream)
+{
+  const InstanceCache<Instance> &instanceCache = _treeType.heroTrees().m_instanceCache;
+  _innerIndex = _stream.index(instanceCache.size(_id,_age));
+  return &instanceCache.at(_id,_age,_innerIndex);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Forest::bakePrototypes(const std::vector<bool> &_treeTypes)
+{
+  if(_treeTypes.empty())
+  {
+    m_prototypes = {};
+  }
+  m_prototypes.resize(m_treeTypes.size());
+  for(size_t t=0; t<m_treeTypes.size(); t++)
+  {
+    if(!_treeTypes.empty() && !_treeTypes[t])
+    {
+      continue;
+    }
+    m_prototypes[t] = std::vector<Prototype>(m_numPrototypes);
+    for(size_t p=0; p<m_numPrototypes; p++)
+    {
+      RandomStream stream(m_randomSeed, p, PROTOTYPE, t);
+      Prototype &prototype = m_prototypes[t][p];
+      createTree(t, ngl::Mat4(), 0, 0, stream, prototype);
+      computePrototypeBounds(t, prototype);
+    }
+  }
+  bakeLODPrototypes(_treeTypes);
+}
+
+void Forest::bakeLODPrototypes(const std::vector<bool> &_treeTypes)
 {
-  size_t size = _treeType.m_instanceCache.at(_id).at(_age).size();
-  std::uniform_int_distribution<size_t> dist(0,size-1);
-  _innerIndex = dist(m_gen);
-  return &_treeType.m_instanceCache.at(_id).at(_age).at(_innerIndex);
+  //m_ages never decrease going away from the root, so an instance is kept exactly when every instance between it and
+  //the root is kept, and the result is the prototype cut off at m_lodAge
+  if(_treeTypes.empty())
+  {
+    m_lodPrototypes = {};
+  }
+  m_lodPrototypes.resize(m_prototypes.size());
+  for(size_t t=0; t<m_prototypes.size(); t++)
+  {
+    if(!_treeTypes.empty() && !_treeTypes[t])
+    {
+      continue;
+    }
+    m_lodPrototypes[t] = std::vector<Prototype>(m_prototypes[t].size());
+    for(size_t p=0; p<m_prototypes[t].size(); p++)
+    {
+      const Prototype &prototype = m_prototypes[t][p];
+      Prototype &lod = m_lodPrototypes[t][p];
+      for(size_t j=0; j<prototype.m_slots.size(); j++)
+      {
+        if(prototype.m_ages[j] <= m_lodAge)
+        {
+          lod.m_slots.push_back(prototype.m_slots[j]);
+          lod.m_transforms.push_back(prototype.m_transforms[j]);
+          lod.m_ages.push_back(prototype.m_ages[j]);
+        }
+      }
+      computePrototypeBounds(t, lod);
+    }
+  }
+}
+
+const Forest::Prototype &Forest::treePrototype(size_t _tree, bool _lod) const
+{
+  const std::vector<std::vector<Prototype>> &prototypes = _lod ? m_lodPrototypes : m_prototypes;
+  return prototypes[m_treeData[_tree].m_type][m_treePrototypes[_tree]];
+}
+
+void Forest::computePrototypeBounds(size_t _treeType, Prototype &_prototype)
+{
+  //union of the boxes of every instance in the prototype, each moved to where the prototype places it
+  const InstanceCache<Instance> &instanceCache = m_treeTypes[_treeType].heroTrees().m_instanceCache;
+  ngl::Vec3 low(0,0,0);
+  ngl::Vec3 high(0,0,0);
+  for(size_t j=0; j<_prototype.m_slots.size(); j++)
+  {
+    const Instance &instance = instanceCache[_prototype.m_slots[j]];
+    for(int corner=0; corner<8; corner++)
+    {
+      ngl::Vec3 p((corner&1) ? instance.m_boundsMax.m_x : instance.m_boundsMin.m_x,
+                  (corner&2) ? instance.m_boundsMax.m_y : instance.m_boundsMin.m_y,
+                  (corner&4) ? instance.m_boundsMax.m_z : instance.m_boundsMin.m_z);
+      p = _prototype.m_transforms[j].transformPoint(p);
+      low = ngl::Vec3(std::min(low.m_x, p.m_x), std::min(low.m_y, p.m_y), std::min(low.m_z, p.m_z));
+      high = ngl::Vec3(std::max(high.m_x, p.m_x), std::max(high.m_y, p.m_y), std::max(high.m_z, p.m_z));
+    }
+  }
+  _prototype.m_centre = (low+high)*0.5f;
+  _prototype.m_radius = (high-low).length()*0.5f;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Forest::createForest()
+void Forest::createForest(const std::vector<bool> &_rebake)
 {
+  FOREST_TRACE_ZONE("Forest::createForest");
   seedRandomEngine();
-  resizeTransformCache();
-  for(auto &tree : m_treeData)
-    createTree(tree.m_type,tree.m_transform,0,0);
+  bakePrototypes(_rebake);
+
+  m_treePrototypes.assign(m_treeData.size(), 0);
+  if(m_numPrototypes>0)
+  {
+    parallelFor(m_treeData.size(), numWorkerThreads(m_numThreads), [&](size_t _i)
+    {
+      //one stream per tree, so the prototype picked for a tree doesn't depend on the trees before it
+      RandomStream stream(m_randomSeed, _i, INSTANCE_SELECTION);
+      m_treePrototypes[_i] = uint32_t(stream.index(m_numPrototypes));
+    });
+  }
+
+  buildTreeGrid();
+
+  std::vector<uint32_t> allTrees(m_treeData.size());
+  for(size_t i=0; i<allTrees.size(); i++)
+  {
+    allTrees[i] = uint32_t(i);
+  }
+  fillTransformCache(allTrees, {}, {}, m_transformCache);
+  m_visibleTrees = {};
+  m_visibleLOD = {};
+  m_visibleScales = {};
+  m_visibleCache = {};
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryReport Forest::memoryUsage() const
+{
+  auto prototypeBytes = [](const std::vector<std::vector<Prototype>> &_prototypes)
+  {
+    size_t result = MemoryReport::bytes(_prototypes);
+    for(auto &typePrototypes : _prototypes)
+    {
+      result += MemoryReport::bytes(typePrototypes);
+      for(auto &prototype : typePrototypes)
+      {
+        result += MemoryReport::bytes(prototype.m_slots) + MemoryReport::bytes(prototype.m_transforms) +
+                  MemoryReport::bytes(prototype.m_ages);
+      }
+    }
+    return result;
+  };
+  auto cacheBytes = [](const std::vector<TransformCache> &_caches)
+  {
+    size_t result = MemoryReport::bytes(_caches);
+    for(auto &cache : _caches)
+    {
+      result += MemoryReport::bytes(cache.m_offsets) + MemoryReport::bytes(cache.m_transforms);
+    }
+    return result;
+  };
+  auto densityBytes = [](const DensityMap &_density)
+  {
+    return MemoryReport::bytes(_density.m_values) + MemoryReport::bytes(_density.m_probability) +
+           MemoryReport::bytes(_density.m_alias);
+  };
+
+  MemoryReport report;
+  report.add("tree data", MemoryReport::bytes(m_treeData));
+  size_t density = densityBytes(m_density) + MemoryReport::bytes(m_typeDensity);
+  for(auto &typeDensity : m_typeDensity)
+  {
+    density += densityBytes(typeDensity);
+  }
+  report.add("density maps", density);
+  report.add("prototypes", prototypeBytes(m_prototypes) + prototypeBytes(m_lodPrototypes));
+  report.add("tree prototypes", MemoryReport::bytes(m_treePrototypes));
+  report.add("tree grid", MemoryReport::bytes(m_treeGrid.m_cells) + MemoryReport::bytes(m_treeGrid.m_items) +
+                          MemoryReport::bytes(m_treeGrid.m_centres) + MemoryReport::bytes(m_treeGrid.m_radii));
+  report.add("transform cache", cacheBytes(m_transformCache));
+  report.add("visible trees", MemoryReport::bytes(m_visibleTrees) + MemoryReport::bytes(m_visibleLOD) +
+                              MemoryReport::bytes(m_visibleScales) + cacheBytes(m_visibleCache));
+  for(size_t t=0; t<m_treeTypes.size(); t++)
+  {
+    const LSystem &treeType = m_treeTypes[t];
+    report.add(treeType.m_name.empty() ? "species "+std::to_string(t) : treeType.m_name, treeType.memoryUsage());
+  }
+  report.add("terrain", m_terrainGen.memoryUsage());
+  return report;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool Forest::exportTiles(const std::string &_path, float _tileSize, ForestTileWriter::Compression _compression) const
+{
+  ForestTileWriter writer;
+  if(_tileSize <= 0.0f || !writer.open(_path, _tileSize, _compression))
+  {
+    return false;
+  }
+
+  //sort the trees by tile, keeping them in order within each tile
+  std::vector<std::pair<int32_t,int32_t>> tileOf(m_treeData.size());
+  std::vector<uint32_t> order(m_treeData.size());
+  for(size_t i=0; i<m_treeData.size(); i++)
+  {
+    const AffineTransform &transform = m_treeData[i].m_transform;
+    tileOf[i] = {ForestTileWriter::tileCoordinate(transform.m_m[3][2], _tileSize),
+                 ForestTileWriter::tileCoordinate(transform.m_m[3][0], _tileSize)};
+    order[i] = uint32_t(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t _a, uint32_t _b){ return tileOf[_a] < tileOf[_b]; });
+
+  size_t start = 0;
+  while(start < order.size())
+  {
+    size_t end = start;
+    ForestTileWriter::Tile tile;
+    tile.m_z = tileOf[order[start]].first;
+    tile.m_x = tileOf[order[start]].second;
+    while(end < order.size() && tileOf[order[end]] == tileOf[order[start]])
+    {
+      size_t i = order[end++];
+      const Prototype &prototype = treePrototype(i, false);
+      size_t n = tile.m_transforms.size();
+      tile.m_treeTypes.resize(n+prototype.m_slots.size(), uint32_t(m_treeData[i].m_type));
+      tile.m_prototypes.insert(tile.m_prototypes.end(), prototype.m_slots.begin(), prototype.m_slots.end());
+      tile.m_transforms.resize(n+prototype.m_transforms.size());
+      multiplyBatch(m_treeData[i].m_transform, prototype.m_transforms.data(), prototype.m_transforms.size(),
+                    tile.m_transforms.data()+n);
+    }
+    if(!writer.writeTile(std::move(tile)))
+    {
+      break;
+    }
+    start = end;
+  }
+  if(!writer.close())
+  {
+    std::cerr<<"WARNING: unable to export "<<_path<<": "<<writer.error()<<"\n";
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Forest::buildTreeGrid()
+{
+  //each tree is bounded by the sphere of its prototype, moved and scaled by the tree's transform
+  std::vector<ngl::Vec3> centres(m_treeData.size());
+  std::vector<float> radii(m_treeData.size(), 0.0f);
+  for(size_t i=0; i<m_treeData.size(); i++)
+  {
+    const AffineTransform &transform = m_treeData[i].m_transform;
+    if(m_numPrototypes>0)
+    {
+      const Prototype &prototype = m_prototypes[m_treeData[i].m_type][m_treePrototypes[i]];
+      centres[i] = transform.transformPoint(prototype.m_centre);
+      radii[i] = prototype.m_radius*transform.maxScale();
+    }
+    else
+    {
+      centres[i] = transform.transformPoint(ngl::Vec3(0,0,0));
+    }
+  }
+
+  float cellSize = m_gridCellSize;
+  if(cellSize <= 0.0f)
+  {
+    //aim for around 32 trees per cell
+    float area = std::max(m_width*m_length, 1.0f);
+    cellSize = std::sqrt(area*32.0f/std::max(float(m_treeData.size()), 1.0f));
+  }
+  m_treeGrid.build(centres, radii, cellSize);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Forest::cull(const ngl::Mat4 &_MVP, const ngl::Vec3 &_eye)
+{
+  FOREST_TRACE_ZONE("Forest::cull");
+  Frustum frustum(_MVP);
+  bool useLOD = m_lodDistance > 0.0f && !m_lodPrototypes.empty();
+  bool useThinning = m_thinningStart > 0.0f;
+  //thinning scales trees up about their roots by as much as 1/sqrt(m_minDensity). A root is inside its tree's
+  //sphere, so scaling by s keeps the tree inside that sphere grown by 2(s-1) of its radius - the grid is queried
+  //with the largest such margin, then each tree's own scaled sphere is tested below
+  float margin = 0.0f;
+  if(useThinning)
+  {
+    float maxScale = 1.0f/std::sqrt(std::max(m_minDensity, 1e-6f));
+    margin = 2.0f*std::max(maxScale-1.0f, 0.0f)*m_treeGrid.m_maxRadius;
+  }
+  m_visibleTrees.clear();
+  m_treeGrid.query(frustum, m_visibleTrees, margin);
+
+  m_visibleLOD.clear();
+  m_visibleScales.clear();
+  if(useLOD || useThinning)
+  {
+    //trees that are thinned out are dropped from m_visibleTrees as it is walked, so n is where the next kept tree goes
+    size_t n = 0;
+    for(size_t v=0; v<m_visibleTrees.size(); v++)
+    {
+      uint32_t i = m_visibleTrees[v];
+      float distance = (m_treeGrid.m_centres[i]-_eye).length();
+      if(useThinning)
+      {
+        float scale = thinningScale(m_treeData[i].m_importance, thinningDensity(distance));
+        if(scale <= 0.0f)
+        {
+          continue;
+        }
+        ngl::Vec3 root = m_treeData[i].m_transform.transformPoint(ngl::Vec3(0,0,0));
+        ngl::Vec3 centre = root + (m_treeGrid.m_centres[i]-root)*scale;
+        if(!frustum.sphereVisible(centre, m_treeGrid.m_radii[i]*scale))
+        {
+          continue;
+        }
+        m_visibleScales.push_back(scale);
+      }
+      if(useLOD)
+      {
+        m_visibleLOD.push_back(distance > m_lodDistance);
+      }
+      m_visibleTrees[n++] = i;
+    }
+    m_visibleTrees.resize(n);
+  }
+  fillTransformCache(m_visibleTrees, m_visibleLOD, m_visibleScales, m_visibleCache);
+}
+
+float Forest::thinningDensity(float _distance) const
+{
+  if(m_thinningStart <= 0.0f || _distance <= m_thinningStart)
+  {
+    return 1.0f;
+  }
+  float t = std::min(1.0f, (_distance-m_thinningStart)/std::max(m_thinningEnd-m_thinningStart, 1e-6f));
+  return 1.0f + t*(m_minDensity-1.0f);
+}
+
+float Forest::thinningScale(float _importance, float _density) const
+{
+  if(_density >= 1.0f)
+  {
+    return 1.0f;
+  }
+  if(_density <= 0.0f)
+  {
+    return 0.0f;
+  }
+  //the trees with importance over 1-_density are drawn whole, so exactly a fraction _density of them are, and the
+  //ones just below shrink to nothing over a band that's a fraction of that, rather than popping out. With the band
+  //relative to the survivors, the canopy area of the fading trees is a fixed fraction of that of the whole ones
+  //at every density, so 1/sqrt(_density) keeps the area covered the same
+  float band = std::max(m_thinningFadeBand, 1e-6f)*_density;
+  float threshold = 1.0f - _density - band;
+  float fade = std::min(1.0f, (_importance-threshold)/band);
+  if(fade <= 0.0f)
+  {
+    return 0.0f;
+  }
+  return fade/std::sqrt(_density);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Forest::fillTransformCache(const std::vector<uint32_t> &_trees, const std::vector<uint8_t> &_lod,
+                                const std::vector<float> &_scales, std::vector<TransformCache> &_cache) const
+{
+  FOREST_TRACE_ZONE("Forest::fillTransformCache");
+  size_t numTypes = m_treeTypes.size();
+  _cache.resize(numTypes);
+  for(size_t t=0; t<numTypes; t++)
+  {
+    _cache[t].m_offsets.assign(m_treeTypes[t].heroTrees().m_instanceCache.size()+1, 0);
+    _cache[t].m_transforms.clear();
+  }
+  if(m_numPrototypes==0)
+  {
+    return;
+  }
+
+  //the trees are split into one contiguous chunk per thread. The first pass counts how many transforms each chunk
+  //adds to each instance; a prefix sum over (instance, chunk) then gives every chunk its own range of every
+  //instance's transforms to write in the second pass. Within an instance the transforms end up in the order of
+  //_trees, so the result doesn't depend on the number of threads
+  size_t numTrees = _trees.size();
+  size_t numInstances = 0;
+  size_t numChunks = std::min(numWorkerThreads(m_numThreads), std::max(size_t(1), numTrees/256));
+  auto chunkStart = [&](size_t _chunk){ return _chunk*numTrees/numChunks; };
+
+  //cursors[chunk][type][k] - counts of transforms after the first pass, write positions in the second
+  std::vector<std::vector<std::vector<size_t>>> cursors(numChunks);
+
+  parallelFor(numChunks, numChunks, [&](size_t _chunk)
+  {
+    std::vector<std::vector<size_t>> &counts = cursors[_chunk];
+    counts.resize(numTypes);
+    for(size_t t=0; t<numTypes; t++)
+    {
+      counts[t].assign(m_treeTypes[t].heroTrees().m_instanceCache.size(), 0);
+    }
+    for(size_t n=chunkStart(_chunk); n<chunkStart(_chunk+1); n++)
+    {
+      size_t i = _trees[n];
+      size_t t = m_treeData[i].m_type;
+      for(uint32_t slot : treePrototype(i, !_lod.empty() && _lod[n]).m_slots)
+      {
+        counts[t][slot]++;
+      }
+    }
+  });
+
+  for(size_t t=0; t<numTypes; t++)
+  {
+    TransformCache &cache = _cache[t];
+    size_t total = 0;
+    for(size_t k=0; k+1<cache.m_offsets.size(); k++)
+    {
+      cache.m_offsets[k] = total;
+      for(size_t c=0; c<numChunks; c++)
+      {
+        size_t count = cursors[c][t][k];
+        cursors[c][t][k] = total;
+        total += count;
+      }
+    }
+    cache.m_offsets.back() = total;
+    cache.m_transforms.resize(total);
+    numInstances += total;
+  }
+  FOREST_TRACE_COUNTER("instances placed", numInstances);
+
+  parallelFor(numChunks, numChunks, [&](size_t _chunk)
+  {
+    FOREST_TRACE_ZONE("Forest::fillTransformCache chunk");
+    std::vector<std::vector<size_t>> &cursor = cursors[_chunk];
+    std::vector<AffineTransform> transforms;
+    for(size_t n=chunkStart(_chunk); n<chunkStart(_chunk+1); n++)
+    {
+      size_t i = _trees[n];
+      size_t t = m_treeData[i].m_type;
+      const Prototype &prototype = treePrototype(i, !_lod.empty() && _lod[n]);
+      AffineTransform root = m_treeData[i].m_transform;
+      if(!_scales.empty())
+      {
+        root.scaleBasis(_scales[n]);
+      }
+      transforms.resize(prototype.m_transforms.size());
+      multiplyBatch(root, prototype.m_transforms.data(), transforms.size(), transforms.data());
+      AffineTransform * out = _cache[t].m_transforms.data();
+      for(size_t j=0; j<transforms.size(); j++)
+      {
+        out[cursor[t][prototype.m_slots[j]]++] = transforms[j];
+      }
+    }
+  });
 }
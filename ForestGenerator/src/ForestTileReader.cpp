@@ -0,0 +1,113 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ForestTileReader.cpp
+/// @brief implementation file for ForestTileReader class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <cstring>
+#ifdef FOREST_USE_ZLIB
+#include <zlib.h>
+#endif
+#include "ForestTileReader.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ForestTileReader::open(const std::string &_path)
+{
+  m_file.close();
+  m_file.clear();
+  m_header = {};
+  m_index = {};
+  m_file.open(_path, std::ios::binary);
+  if(!m_file.read(reinterpret_cast<char *>(&m_header), sizeof(ForestTileWriter::Header)))
+  {
+    return false;
+  }
+  //a file whose writer never closed it has no index
+  if(std::memcmp(m_header.m_magic, ForestTileWriter::s_magic, sizeof(ForestTileWriter::s_magic)) != 0 ||
+     m_header.m_version != ForestTileWriter::s_version || m_header.m_headerSize != sizeof(ForestTileWriter::Header) ||
+     m_header.m_tileEntrySize != sizeof(ForestTileWriter::TileEntry) || m_header.m_indexOffset == 0)
+  {
+    return false;
+  }
+  m_index.resize(m_header.m_numTiles);
+  m_file.seekg(std::streamoff(m_header.m_indexOffset));
+  if(!m_file.read(reinterpret_cast<char *>(m_index.data()),
+                  std::streamsize(m_index.size()*sizeof(ForestTileWriter::TileEntry))))
+  {
+    m_index = {};
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+size_t ForestTileReader::findTile(int32_t _x, int32_t _z) const
+{
+  for(size_t i=0; i<m_index.size(); i++)
+  {
+    if(m_index[i].m_x == _x && m_index[i].m_z == _z)
+    {
+      return i;
+    }
+  }
+  return m_index.size();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ForestTileReader::readTile(size_t _index, ForestTileWriter::Tile &_tile)
+{
+  if(_index >= m_index.size())
+  {
+    return false;
+  }
+  const ForestTileWriter::TileEntry &entry = m_index[_index];
+  size_t n = entry.m_numInstances;
+  std::vector<unsigned char> chunk(n*(2*sizeof(uint32_t)+sizeof(AffineTransform)));
+  std::vector<unsigned char> stored(entry.m_storedSize);
+  m_file.clear();
+  m_file.seekg(std::streamoff(entry.m_offset));
+  if(!m_file.read(reinterpret_cast<char *>(stored.data()), std::streamsize(stored.size())))
+  {
+    return false;
+  }
+  if(entry.m_compression == ForestTileWriter::NONE)
+  {
+    if(stored.size() != chunk.size())
+    {
+      return false;
+    }
+    chunk.swap(stored);
+  }
+  else
+  {
+#ifdef FOREST_USE_ZLIB
+    uLongf size = uLongf(chunk.size());
+    if(entry.m_compression != ForestTileWriter::ZLIB ||
+       uncompress(chunk.data(), &size, stored.data(), uLong(stored.size())) != Z_OK || size != chunk.size())
+    {
+      return false;
+    }
+#else
+    return false;
+#endif
+  }
+
+  _tile.m_x = entry.m_x;
+  _tile.m_z = entry.m_z;
+  _tile.m_treeTypes.resize(n);
+  _tile.m_prototypes.resize(n);
+  _tile.m_transforms.resize(n);
+  //an empty tile has no storage to copy into, and memcpy mustn't be given a null pointer
+  if(n > 0)
+  {
+    const unsigned char * in = chunk.data();
+    std::memcpy(_tile.m_treeTypes.data(), in, n*sizeof(uint32_t));
+    in += n*sizeof(uint32_t);
+    std::memcpy(_tile.m_prototypes.data(), in, n*sizeof(uint32_t));
+    in += n*sizeof(uint32_t);
+    std::memcpy(_tile.m_transforms.data(), in, n*sizeof(AffineTransform));
+  }
+  return true;
+}
@@ -0,0 +1,217 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ForestTileWriter.cpp
+/// @brief implementation file for ForestTileWriter class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <type_traits>
+#ifdef FOREST_USE_ZLIB
+#include <zlib.h>
+#endif
+#include "ForestTileWriter.h"
+
+static_assert(sizeof(AffineTransform) == 48 && std::is_trivially_copyable<AffineTransform>::value,
+              "transforms are stored in their in-memory layout");
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ForestTileWriter::~ForestTileWriter()
+{
+  close();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int32_t ForestTileWriter::tileCoordinate(float _position, float _tileSize)
+{
+  return int32_t(std::floor(_position/_tileSize));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ForestTileWriter::open(const std::string &_path, float _tileSize, Compression _compression)
+{
+  close();
+  m_error = {};
+  m_file.open(_path, std::ios::binary | std::ios::trunc);
+  if(!m_file)
+  {
+    m_error = "couldn't create "+_path;
+    return false;
+  }
+#ifdef FOREST_USE_ZLIB
+  m_compression = _compression;
+#else
+  m_compression = NONE;
+  (void)_compression;
+#endif
+
+  m_header = {};
+  std::memcpy(m_header.m_magic, s_magic, sizeof(s_magic));
+  m_header.m_version = s_version;
+  m_header.m_headerSize = sizeof(Header);
+  m_header.m_tileSize = _tileSize;
+  m_header.m_tileEntrySize = sizeof(TileEntry);
+  //the header is written again by close(), once the index has somewhere to point
+  m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(Header));
+  m_offset = sizeof(Header);
+  m_index = {};
+  m_failed = !m_file;
+  if(m_failed)
+  {
+    m_error = "couldn't write the header";
+  }
+  m_closing = false;
+  m_writer = std::thread(&ForestTileWriter::writerLoop, this);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ForestTileWriter::writeTile(Tile _tile)
+{
+  if(!m_writer.joinable())
+  {
+    return false;
+  }
+  //a writer thread that has stopped never empties the queue, so waiting on it has to stop at a failure too
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_queueChanged.wait(lock, [&]{ return m_queue.size() < std::max(m_maxQueuedTiles, size_t(1)) || m_failed; });
+  if(m_failed)
+  {
+    return false;
+  }
+  m_queue.push_back(std::move(_tile));
+  m_queueChanged.notify_all();
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void ForestTileWriter::writerLoop()
+{
+  while(true)
+  {
+    Tile tile;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_queueChanged.wait(lock, [&]{ return !m_queue.empty() || m_closing; });
+      if(m_queue.empty())
+      {
+        return;
+      }
+      tile = std::move(m_queue.front());
+      m_queue.pop_front();
+      m_queueChanged.notify_all();
+    }
+    //nothing may escape the thread, so an exception from zlib or an allocation ends the file rather than the process
+    try
+    {
+      writeChunk(tile);
+    }
+    catch(const std::exception &_error)
+    {
+      m_error = std::string("writing a tile threw: ")+_error.what();
+    }
+    catch(...)
+    {
+      m_error = "writing a tile threw an unknown exception";
+    }
+    if(!m_error.empty())
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_failed = true;
+      m_queue.clear();
+      m_queueChanged.notify_all();
+      return;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void ForestTileWriter::writeChunk(const Tile &_tile)
+{
+  size_t n = _tile.m_transforms.size();
+  if(_tile.m_treeTypes.size() != n || _tile.m_prototypes.size() != n)
+  {
+    m_error = "a tile's arrays have different sizes";
+    m_failed = true;
+    return;
+  }
+  std::vector<unsigned char> chunk(n*(2*sizeof(uint32_t)+sizeof(AffineTransform)));
+  //an empty tile's arrays may have no storage at all, and memcpy mustn't be given a null pointer
+  if(n > 0)
+  {
+    unsigned char * out = chunk.data();
+    std::memcpy(out, _tile.m_treeTypes.data(), n*sizeof(uint32_t));
+    out += n*sizeof(uint32_t);
+    std::memcpy(out, _tile.m_prototypes.data(), n*sizeof(uint32_t));
+    out += n*sizeof(uint32_t);
+    std::memcpy(out, _tile.m_transforms.data(), n*sizeof(AffineTransform));
+  }
+
+  TileEntry entry = {};
+  entry.m_x = _tile.m_x;
+  entry.m_z = _tile.m_z;
+  entry.m_offset = m_offset;
+  entry.m_numInstances = n;
+  entry.m_compression = NONE;
+#ifdef FOREST_USE_ZLIB
+  if(m_compression == ZLIB && !chunk.empty())
+  {
+    uLongf size = compressBound(uLong(chunk.size()));
+    std::vector<unsigned char> compressed(size);
+    if(compress2(compressed.data(), &size, chunk.data(), uLong(chunk.size()), m_compressionLevel) == Z_OK &&
+       size < chunk.size())
+    {
+      compressed.resize(size);
+      chunk.swap(compressed);
+      entry.m_compression = ZLIB;
+    }
+  }
+#endif
+  entry.m_storedSize = chunk.size();
+
+  m_file.write(reinterpret_cast<const char *>(chunk.data()), std::streamsize(chunk.size()));
+  if(!m_file && !m_failed)
+  {
+    m_error = "couldn't write a tile";
+    m_failed = true;
+  }
+  m_offset += chunk.size();
+  m_header.m_numInstances += n;
+  m_index.push_back(entry);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ForestTileWriter::close()
+{
+  if(!m_writer.joinable())
+  {
+    return !m_failed;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closing = true;
+    m_queueChanged.notify_all();
+  }
+  m_writer.join();
+
+  m_header.m_indexOffset = m_offset;
+  m_header.m_numTiles = m_index.size();
+  m_file.write(reinterpret_cast<const char *>(m_index.data()), std::streamsize(m_index.size()*sizeof(TileEntry)));
+  m_file.seekp(0);
+  m_file.write(reinterpret_cast<const char *>(&m_header), sizeof(Header));
+  m_file.close();
+  if(!m_file && !m_failed)
+  {
+    m_error = "couldn't write the index";
+    m_failed = true;
+  }
+  return !m_failed;
+}
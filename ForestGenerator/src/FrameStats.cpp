@@ -0,0 +1,134 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameStats.cpp
+/// @brief implementation file for FrameStats class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <cstdio>
+#include "FrameStats.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+uint64_t FrameStats::endFrame(double _cpuTime, bool _waitForGPU)
+{
+  Frame frame = m_current;
+  frame.m_index = m_numFrames++;
+  frame.m_cpuTime = _cpuTime;
+  m_current = {};
+  if(_waitForGPU)
+  {
+    m_pending.push_back(frame);
+  }
+  else
+  {
+    finish(frame);
+  }
+  return frame.m_index;
+}
+
+void FrameStats::setGPUTime(uint64_t _index, double _gpuTime)
+{
+  while(!m_pending.empty() && m_pending.front().m_index <= _index)
+  {
+    Frame frame = m_pending.front();
+    m_pending.pop_front();
+    if(frame.m_index == _index)
+    {
+      frame.m_gpuTime = _gpuTime;
+    }
+    finish(frame);
+  }
+}
+
+void FrameStats::finish(const Frame &_frame)
+{
+  m_history.push_back(_frame);
+  while(m_history.size() > m_historySize)
+  {
+    m_history.pop_front();
+  }
+  if(m_log.is_open())
+  {
+    m_log<<_frame.m_index<<','<<_frame.m_cpuTime<<',';
+    if(_frame.m_gpuTime >= 0.0)
+    {
+      m_log<<_frame.m_gpuTime;
+    }
+    m_log<<','<<_frame.m_triangles<<','<<_frame.m_lines<<','<<_frame.m_instances<<','<<_frame.m_drawCalls
+         <<','<<_frame.m_uploadedBytes<<'\n';
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+FrameStats::Frame FrameStats::average() const
+{
+  Frame result;
+  if(m_history.empty())
+  {
+    return result;
+  }
+  double gpuTime = 0.0;
+  size_t numGPUTimes = 0;
+  double triangles = 0.0, lines = 0.0, instances = 0.0, drawCalls = 0.0, uploadedBytes = 0.0;
+  for(auto &frame : m_history)
+  {
+    result.m_cpuTime += frame.m_cpuTime;
+    if(frame.m_gpuTime >= 0.0)
+    {
+      gpuTime += frame.m_gpuTime;
+      numGPUTimes++;
+    }
+    triangles += frame.m_triangles;
+    lines += frame.m_lines;
+    instances += frame.m_instances;
+    drawCalls += frame.m_drawCalls;
+    uploadedBytes += frame.m_uploadedBytes;
+  }
+  double n = double(m_history.size());
+  result.m_index = m_history.back().m_index;
+  result.m_cpuTime /= n;
+  result.m_gpuTime = numGPUTimes > 0 ? gpuTime/numGPUTimes : -1.0;
+  result.m_triangles = size_t(triangles/n + 0.5);
+  result.m_lines = size_t(lines/n + 0.5);
+  result.m_instances = size_t(instances/n + 0.5);
+  result.m_drawCalls = size_t(drawCalls/n + 0.5);
+  result.m_uploadedBytes = size_t(uploadedBytes/n + 0.5);
+  return result;
+}
+
+std::string FrameStats::summary() const
+{
+  Frame mean = average();
+  char gpu[32] = "n/a";
+  if(mean.m_gpuTime >= 0.0)
+  {
+    std::snprintf(gpu, sizeof(gpu), "%.2f ms", mean.m_gpuTime);
+  }
+  char result[256];
+  std::snprintf(result, sizeof(result),
+                "CPU %.2f ms | GPU %s | %zu triangles | %zu lines | %zu instances | %zu draw calls | %.1f KB uploaded",
+                mean.m_cpuTime, gpu, mean.m_triangles, mean.m_lines, mean.m_instances, mean.m_drawCalls,
+                mean.m_uploadedBytes/1024.0);
+  return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool FrameStats::openLog(const std::string &_path)
+{
+  closeLog();
+  m_log.open(_path, std::ios::trunc);
+  if(!m_log)
+  {
+    m_log.close();
+    return false;
+  }
+  m_log<<"frame,cpu_ms,gpu_ms,triangles,lines,instances,draw_calls,uploaded_bytes\n";
+  return true;
+}
+
+void FrameStats::closeLog()
+{
+  m_log.close();
+  m_log.clear();
+}
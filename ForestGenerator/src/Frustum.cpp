@@ -0,0 +1,80 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Frustum.cpp
+/// @brief implementation file for Frustum class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <cmath>
+#include "Frustum.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Frustum::Frustum()
+{
+  for(auto &plane : m_planes)
+  {
+    plane = {0.0f, 0.0f, 0.0f, 1.0f};
+  }
+}
+
+Frustum::Frustum(const ngl::Mat4 &_MVP)
+{
+  //ngl uploads m_m as column major, so row r of the matrix the shader uses is (m_m[0][r], m_m[1][r], ...), and the
+  //planes are the usual sums and differences of the rows (Gribb & Hartmann)
+  auto row = [&](int _r, int _c){ return _MVP.m_m[_c][_r]; };
+  for(int p=0; p<6; p++)
+  {
+    int axis = p/2;
+    float sign = (p%2==0) ? 1.0f : -1.0f;
+    for(int c=0; c<4; c++)
+    {
+      m_planes[size_t(p)][size_t(c)] = row(3,c) + sign*row(axis,c);
+    }
+    std::array<float,4> &plane = m_planes[size_t(p)];
+    float length = std::sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+    if(length > 0.0f)
+    {
+      for(auto &value : plane)
+      {
+        value /= length;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool Frustum::sphereVisible(const ngl::Vec3 &_centre, float _radius) const
+{
+  for(auto &plane : m_planes)
+  {
+    if(plane[0]*_centre.m_x + plane[1]*_centre.m_y + plane[2]*_centre.m_z + plane[3] < -_radius)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+Frustum::Result Frustum::classifyBox(const ngl::Vec3 &_min, const ngl::Vec3 &_max) const
+{
+  Result result = INSIDE;
+  for(auto &plane : m_planes)
+  {
+    //the corners of the box furthest along and furthest against the plane normal
+    ngl::Vec3 positive(plane[0]>=0 ? _max.m_x : _min.m_x,
+                       plane[1]>=0 ? _max.m_y : _min.m_y,
+                       plane[2]>=0 ? _max.m_z : _min.m_z);
+    ngl::Vec3 negative(plane[0]>=0 ? _min.m_x : _max.m_x,
+                       plane[1]>=0 ? _min.m_y : _max.m_y,
+                       plane[2]>=0 ? _min.m_z : _max.m_z);
+    if(plane[0]*positive.m_x + plane[1]*positive.m_y + plane[2]*positive.m_z + plane[3] < 0)
+    {
+      return OUTSIDE;
+    }
+    if(plane[0]*negative.m_x + plane[1]*negative.m_y + plane[2]*negative.m_z + plane[3] < 0)
+    {
+      result = INTERSECTS;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Heightmap.cpp
+/// @brief implementation file for Heightmap class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "Heightmap.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Heightmap::Heightmap(const std::vector<float> &_heights, int _dimension, float _scale) :
+  m_heights(_heights.data()), m_dimension(_dimension), m_scale(_scale)
+{
+  //a map that doesn't match its dimension is treated as empty rather than read out of bounds
+  if(_dimension < 2 || _heights.size() < size_t(_dimension)*size_t(_dimension))
+  {
+    m_heights = nullptr;
+    m_dimension = 0;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+size_t Heightmap::locate(float _x, float _z, float &_u, float &_v) const
+{
+  //grid coordinates, clamped so the cell is always inside the map
+  float last = float(m_dimension-1);
+  float gx = std::min(std::max(_x/m_scale + float(m_dimension/2), 0.0f), last);
+  float gz = std::min(std::max(_z/m_scale + float(m_dimension/2), 0.0f), last);
+  float cx = std::min(std::floor(gx), last-1.0f);
+  float cz = std::min(std::floor(gz), last-1.0f);
+  _u = gx-cx;
+  _v = gz-cz;
+  return size_t(cz)*size_t(m_dimension) + size_t(cx);
+}
+
+float Heightmap::height(float _x, float _z) const
+{
+  float height;
+  heights(&_x, &_z, 1, &height);
+  return height;
+}
+
+void Heightmap::gradient(float _x, float _z, float &_dx, float &_dz) const
+{
+  _dx = 0.0f;
+  _dz = 0.0f;
+  if(m_heights == nullptr)
+  {
+    return;
+  }
+  //derivatives of the bilinear patch
+  float u, v;
+  size_t i = locate(_x, _z, u, v);
+  const float * h = m_heights+i;
+  const float * h1 = h+m_dimension;
+  _dx = ((1.0f-v)*(h[1]-h[0]) + v*(h1[1]-h1[0]))/m_scale;
+  _dz = ((1.0f-u)*(h1[0]-h[0]) + u*(h1[1]-h[1]))/m_scale;
+}
+
+ngl::Vec3 Heightmap::normal(float _x, float _z) const
+{
+  float dx, dz;
+  gradient(_x, _z, dx, dz);
+  ngl::Vec3 n(-dx, 1.0f, -dz);
+  n.normalize();
+  return n;
+}
+
+float Heightmap::slope(float _x, float _z) const
+{
+  float dx, dz;
+  gradient(_x, _z, dx, dz);
+  return std::atan(std::sqrt(dx*dx+dz*dz))*180.0f/float(M_PI);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Heightmap::heights(const float * _x, const float * _z, size_t _n, float * _heights) const
+{
+  if(m_heights == nullptr)
+  {
+    std::fill(_heights, _heights+_n, 0.0f);
+    return;
+  }
+  const float * heights = m_heights;
+  size_t dimension = size_t(m_dimension);
+  float last = float(m_dimension-1);
+  float offset = float(m_dimension/2);
+  float invScale = 1.0f/m_scale;
+  for(size_t n=0; n<_n; n++)
+  {
+    float gx = std::min(std::max(_x[n]*invScale + offset, 0.0f), last);
+    float gz = std::min(std::max(_z[n]*invScale + offset, 0.0f), last);
+    float cx = std::min(std::floor(gx), last-1.0f);
+    float cz = std::min(std::floor(gz), last-1.0f);
+    float u = gx-cx;
+    float v = gz-cz;
+    size_t i = size_t(cz)*dimension + size_t(cx);
+    float h00 = heights[i];
+    float h10 = heights[i+1];
+    float h01 = heights[i+dimension];
+    float h11 = heights[i+dimension+1];
+    _heights[n] = (1.0f-v)*((1.0f-u)*h00 + u*h10) + v*((1.0f-u)*h01 + u*h11);
+  }
+}
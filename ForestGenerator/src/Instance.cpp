@@ -3,10 +3,26 @@
 /// @brief implementation file for Instance struct
 //----------------------------------------------------------------------------------------------------------------------
 
+#include <algorithm>
 #include "Instance.h"
 
 Instance::Instance(ngl::Mat4 _transform) :
   m_transform(_transform) {}
 
+void Instance::computeBounds(const std::vector<ngl::Vec3> &_vertices, const std::vector<GLshort> &_indices)
+{
+  //an instance with no geometry is just a point where its transform starts
+  m_boundsMin = ngl::Vec3(m_transform.m_30, m_transform.m_31, m_transform.m_32);
+  m_boundsMax = m_boundsMin;
+  for(size_t i=m_instanceStart; i<m_instanceEnd && i<_indices.size(); i++)
+  {
+    const ngl::Vec3 &v = _vertices[size_t(_indices[i])];
+    m_boundsMin = ngl::Vec3(std::min(m_boundsMin.m_x, v.m_x), std::min(m_boundsMin.m_y, v.m_y),
+                            std::min(m_boundsMin.m_z, v.m_z));
+    m_boundsMax = ngl::Vec3(std::max(m_boundsMax.m_x, v.m_x), std::max(m_boundsMax.m_y, v.m_y),
+                            std::max(m_boundsMax.m_z, v.m_z));
+  }
+}
+
 Instance::ExitPoint::ExitPoint(size_t _exitId, size_t _exitAge, ngl::Mat4 _exitTransform) :
-  m_exitId(_exitId), m_exitAge(_exitAge), m_exitTransform(_exitTransform) {}
+  m_exitId(uint32_t(_exitId)), m_exitAge(uint32_t(_exitAge)), m_exitTransform(_exitTransform) {}
@@ -0,0 +1,341 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file InstanceCacheFile.cpp
+/// @brief implementation file for InstanceCacheFile class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "Hash.h"
+#include "InstanceCacheFile.h"
+
+static_assert(sizeof(Instance::ExitPoint) == 56 && std::is_trivially_copyable<Instance::ExitPoint>::value,
+              "exit points are stored in their in-memory layout");
+static_assert(sizeof(ngl::Vec3) == 3*sizeof(float), "vertices are stored as 3 floats");
+static_assert(sizeof(GLshort) == sizeof(int16_t), "indices are stored as int16");
+static_assert(sizeof(size_t) == sizeof(uint64_t), "slot offsets are stored as uint64");
+
+namespace
+{
+  const char s_magic[8] = {'F','G','I','C','A','C','H','E'};
+  const size_t s_alignment = 16;
+
+  size_t alignUp(size_t _offset)
+  {
+    return (_offset + s_alignment-1) / s_alignment * s_alignment;
+  }
+
+  //copies _array into _data at _offset. An empty array may have a null data(), which memcpy mustn't be given
+  template <typename T>
+  void writeSection(std::vector<unsigned char> &_data, size_t _offset, const std::vector<T> &_array)
+  {
+    if(!_array.empty())
+    {
+      std::memcpy(_data.data()+_offset, _array.data(), _array.size()*sizeof(T));
+    }
+  }
+
+  //reads the section at _offset of _file straight into _array, which is already the size of the section
+  template <typename T>
+  bool readSection(std::ifstream &_file, size_t _offset, std::vector<T> &_array)
+  {
+    if(_array.empty())
+    {
+      return true;
+    }
+    _file.seekg(std::streamoff(_offset));
+    _file.read(reinterpret_cast<char *>(_array.data()), std::streamsize(_array.size()*sizeof(T)));
+    return bool(_file);
+  }
+
+  int processId()
+  {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return int(getpid());
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+uint64_t InstanceCacheFile::key(const LSystem &_treeType, int _numHeroTrees)
+{
+  Hash hash;
+  hash.value(s_version);
+  hash.string(_treeType.m_axiom);
+  hash.value(uint64_t(_treeType.m_rules.size()));
+  for(auto &rule : _treeType.m_rules)
+  {
+    hash.string(rule.m_LHS);
+    hash.value(uint64_t(rule.m_RHS.size()));
+    for(size_t i=0; i<rule.m_RHS.size(); i++)
+    {
+      hash.string(rule.m_RHS[i]);
+      hash.value(i<rule.m_prob.size() ? rule.m_prob[i] : 0.0f);
+    }
+  }
+  hash.value(_treeType.m_stepSize);
+  hash.value(_treeType.m_stepScale);
+  hash.value(_treeType.m_angle);
+  hash.value(_treeType.m_angleScale);
+  hash.value(_treeType.m_generation);
+  hash.value(uint64_t(_treeType.m_seed));
+  hash.value(_treeType.m_instancingProb);
+  hash.value(uint64_t(_treeType.m_maxInstancePerLevel));
+  hash.value(_numHeroTrees);
+  return hash.m_hash;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+std::string InstanceCacheFile::path(const std::string &_directory, uint64_t _key)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.ficache", static_cast<unsigned long long>(_key));
+  return (std::filesystem::path(_directory) / name).string();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+std::vector<size_t> InstanceCacheFile::sectionOffsets(const Header &_header)
+{
+  size_t sizes[5] = {size_t(_header.m_numVertices)*sizeof(ngl::Vec3),
+                     size_t(_header.m_numIndices)*sizeof(int16_t),
+                     size_t(_header.m_numIds*_header.m_numAges+1)*sizeof(uint64_t),
+                     size_t(_header.m_numInstances)*sizeof(InstanceRecord),
+                     size_t(_header.m_numExitPoints)*sizeof(Instance::ExitPoint)};
+  std::vector<size_t> offsets;
+  size_t offset = alignUp(sizeof(Header));
+  for(size_t size : sizes)
+  {
+    offsets.push_back(offset);
+    offset = alignUp(offset+size);
+  }
+  offsets.push_back(offset);
+  return offsets;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool InstanceCacheFile::write(const std::string &_path, uint64_t _key, const LSystem &_treeType)
+{
+  const LSystem::HeroTrees &heroTrees = _treeType.heroTrees();
+  const InstanceCache<Instance> &cache = heroTrees.m_instanceCache;
+  Header header = {};
+  std::memcpy(header.m_magic, s_magic, sizeof(s_magic));
+  header.m_version = s_version;
+  header.m_headerSize = sizeof(Header);
+  header.m_key = _key;
+  header.m_numIds = cache.numIds();
+  header.m_numAges = cache.numAges();
+  header.m_numVertices = heroTrees.m_vertices.size();
+  header.m_numIndices = heroTrees.m_indices.size();
+  header.m_numInstances = cache.size();
+  header.m_numExitPoints = heroTrees.m_exitPoints.size();
+  std::vector<size_t> offsets = sectionOffsets(header);
+
+  std::vector<unsigned char> data(offsets.back(), 0);
+  std::memcpy(data.data(), &header, sizeof(Header));
+  writeSection(data, offsets[0], heroTrees.m_vertices);
+  writeSection(data, offsets[1], heroTrees.m_indices);
+  writeSection(data, offsets[2], cache.offsets());
+  for(size_t i=0; i<cache.size(); i++)
+  {
+    const Instance &instance = cache[i];
+    InstanceRecord record = {};
+    for(int j=0; j<4; j++)
+    {
+      for(int k=0; k<4; k++)
+      {
+        record.m_transform[4*j+k] = instance.m_transform.m_m[j][k];
+      }
+    }
+    record.m_instanceStart = instance.m_instanceStart;
+    record.m_instanceEnd = instance.m_instanceEnd;
+    for(int j=0; j<3; j++)
+    {
+      record.m_boundsMin[j] = instance.m_boundsMin[j];
+      record.m_boundsMax[j] = instance.m_boundsMax[j];
+    }
+    record.m_exitPointStart = instance.m_exitPointStart;
+    record.m_numExitPoints = instance.m_numExitPoints;
+    std::memcpy(data.data()+offsets[3]+i*sizeof(InstanceRecord), &record, sizeof(InstanceRecord));
+  }
+  writeSection(data, offsets[4], heroTrees.m_exitPoints);
+
+  std::error_code error;
+  std::filesystem::path path(_path);
+  if(path.has_parent_path())
+  {
+    std::filesystem::create_directories(path.parent_path(), error);
+  }
+  //named per process and thread, so two builds writing the same key never write to the same temporary file
+  size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+  std::string tmpPath = _path + "." + std::to_string(processId()) + "." + std::to_string(thread) + ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size()));
+    file.close();
+    if(!file)
+    {
+      std::filesystem::remove(tmpPath, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmpPath, path, error);
+  if(error)
+  {
+    std::filesystem::remove(tmpPath, error);
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool InstanceCacheFile::open(const std::string &_path, uint64_t _key)
+{
+  close();
+  m_file.open(_path, std::ios::binary | std::ios::ate);
+  if(!m_file)
+  {
+    close();
+    return false;
+  }
+  size_t size = size_t(m_file.tellg());
+  m_file.seekg(0);
+  if(size < sizeof(Header) || !m_file.read(reinterpret_cast<char *>(&m_header), sizeof(Header)))
+  {
+    close();
+    return false;
+  }
+  if(std::memcmp(m_header.m_magic, s_magic, sizeof(s_magic)) != 0 || m_header.m_version != s_version ||
+     m_header.m_headerSize != sizeof(Header) || m_header.m_key != _key)
+  {
+    close();
+    return false;
+  }
+  //no count can be more than the file has bytes, which also keeps the section sizes from overflowing
+  for(uint64_t count : {m_header.m_numIds, m_header.m_numAges, m_header.m_numVertices, m_header.m_numIndices,
+                        m_header.m_numInstances, m_header.m_numExitPoints})
+  {
+    if(count > size)
+    {
+      close();
+      return false;
+    }
+  }
+  m_offsets = sectionOffsets(m_header);
+  if(m_offsets.back() > size)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void InstanceCacheFile::close()
+{
+  if(m_file.is_open())
+  {
+    m_file.close();
+  }
+  m_file.clear();
+  m_header = {};
+  m_offsets = {};
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool InstanceCacheFile::read(LSystem &_treeType) const
+{
+  if(!isOpen() || m_header.m_numIds != _treeType.m_branches.size() ||
+     m_header.m_numAges != uint64_t(_treeType.m_generation)+1)
+  {
+    return false;
+  }
+
+  //everything is read into temporaries first, so a bad file leaves _treeType untouched
+  std::vector<ngl::Vec3> vertices(m_header.m_numVertices);
+  std::vector<GLshort> indices(m_header.m_numIndices);
+  std::vector<size_t> slotOffsets(m_header.m_numIds*m_header.m_numAges+1);
+  std::vector<InstanceRecord> records(m_header.m_numInstances);
+  std::vector<Instance::ExitPoint> exitPoints(m_header.m_numExitPoints);
+  m_file.clear();
+  if(!readSection(m_file, m_offsets[0], vertices) || !readSection(m_file, m_offsets[1], indices) ||
+     !readSection(m_file, m_offsets[2], slotOffsets) || !readSection(m_file, m_offsets[3], records) ||
+     !readSection(m_file, m_offsets[4], exitPoints))
+  {
+    return false;
+  }
+  for(GLshort index : indices)
+  {
+    if(index < 0 || uint64_t(index) >= m_header.m_numVertices)
+    {
+      return false;
+    }
+  }
+  //forest creation follows exit points into the instance cache, so each has to name one of its slots
+  for(const Instance::ExitPoint &exitPoint : exitPoints)
+  {
+    if(exitPoint.m_exitId >= m_header.m_numIds || exitPoint.m_exitAge >= m_header.m_numAges)
+    {
+      return false;
+    }
+  }
+
+  //Instance holds an ngl::Mat4 rather than plain floats, so instances are the one array converted element by element
+  std::vector<Instance> instances(records.size());
+  for(size_t i=0; i<records.size(); i++)
+  {
+    const InstanceRecord &record = records[i];
+    if(record.m_instanceStart > record.m_instanceEnd || record.m_instanceEnd > m_header.m_numIndices ||
+       uint64_t(record.m_exitPointStart)+record.m_numExitPoints > m_header.m_numExitPoints)
+    {
+      return false;
+    }
+    Instance &instance = instances[i];
+    for(int j=0; j<4; j++)
+    {
+      for(int k=0; k<4; k++)
+      {
+        instance.m_transform.m_m[j][k] = record.m_transform[4*j+k];
+      }
+    }
+    instance.m_instanceStart = size_t(record.m_instanceStart);
+    instance.m_instanceEnd = size_t(record.m_instanceEnd);
+    instance.m_boundsMin = ngl::Vec3(record.m_boundsMin[0], record.m_boundsMin[1], record.m_boundsMin[2]);
+    instance.m_boundsMax = ngl::Vec3(record.m_boundsMax[0], record.m_boundsMax[1], record.m_boundsMax[2]);
+    instance.m_exitPointStart = record.m_exitPointStart;
+    instance.m_numExitPoints = record.m_numExitPoints;
+  }
+
+  InstanceCache<Instance> cache;
+  try
+  {
+    cache.assign(m_header.m_numIds, m_header.m_numAges, std::move(slotOffsets), std::move(instances));
+  }
+  catch(const std::invalid_argument &)
+  {
+    return false;
+  }
+  std::shared_ptr<LSystem::HeroTrees> heroTrees = std::make_shared<LSystem::HeroTrees>();
+  heroTrees->m_vertices = std::move(vertices);
+  heroTrees->m_indices = std::move(indices);
+  heroTrees->m_instanceCache = std::move(cache);
+  heroTrees->m_exitPoints = std::move(exitPoints);
+  _treeType.m_heroTrees = std::move(heroTrees);
+  return true;
+}
@@ -19,11 +19,47 @@ namespace ngl
     }
 
 
-    glDrawElementsInstanced(m_mode,
-                            static_cast<GLsizei>(m_indicesCount),
-                            m_indexType,
-                            static_cast<GLvoid *>(nullptr),
-                            m_instanceCount);
+    if(m_commands.empty())
+    {
+      return;
+    }
+
+  #if defined(__APPLE__)
+    // no glMultiDrawElementsIndirect or base instance before GL 4.2/4.3, so issue each command separately with the
+    // instance attributes pointed at the command's first transform
+    glBindBuffer(GL_ARRAY_BUFFER, m_transformBuffer);
+    for(auto &command : m_commands)
+    {
+      size_t offset = sizeof(AffineTransform)*command.m_baseInstance;
+      for(GLuint row=0; row<4; row++)
+      {
+        glVertexAttribPointer(row+1, 3, GL_FLOAT, GL_FALSE, sizeof(AffineTransform),
+                              reinterpret_cast<GLvoid *>(offset+row*3*sizeof(GLfloat)));
+      }
+      glDrawElementsInstanced(m_mode,
+                              static_cast<GLsizei>(command.m_count),
+                              m_indexType,
+                              reinterpret_cast<GLvoid *>(command.m_firstIndex*sizeof(GLushort)),
+                              static_cast<GLsizei>(command.m_instanceCount));
+    }
+  #else
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glMultiDrawElementsIndirect(m_mode,
+                                m_indexType,
+                                static_cast<GLvoid *>(nullptr),
+                                static_cast<GLsizei>(m_commands.size()),
+                                0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  #endif
+  }
+
+  size_t InstanceCacheVAO::numDrawCalls() const
+  {
+  #if defined(__APPLE__)
+    return m_commands.size();
+  #else
+    return m_commands.empty() ? 0 : 1;
+  #endif
   }
 
   void InstanceCacheVAO::removeVAO()
@@ -36,6 +72,8 @@ namespace ngl
     {
         glDeleteBuffers(1,&m_buffer);
         glDeleteBuffers(1,&m_idxBuffer);
+        glDeleteBuffers(1,&m_transformBuffer);
+        glDeleteBuffers(1,&m_indirectBuffer);
     }
     glDeleteVertexArrays(1,&m_id);
     m_allocated=false;
@@ -53,6 +91,9 @@ namespace ngl
     if( m_allocated ==true)
     {
         glDeleteBuffers(1,&m_buffer);
+        glDeleteBuffers(1,&m_idxBuffer);
+        glDeleteBuffers(1,&m_transformBuffer);
+        glDeleteBuffers(1,&m_indirectBuffer);
     }
 
 //    GLuint vboID;
@@ -80,26 +121,64 @@ namespace ngl
 
     glGenBuffers(1, &m_transformBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_transformBuffer);
+    // one AffineTransform per instance, passed as its four rows and rebuilt into a mat4 by the shader
     glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(ngl::Mat4)*data.m_instanceCount,
+                 sizeof(AffineTransform)*data.m_instanceCount,
                  data.m_transformData,
                  GL_STATIC_DRAW);
 
-    setVertexAttributePointer(1,4,GL_FLOAT,64,0);
-    setVertexAttributePointer(2,4,GL_FLOAT,64,4);
-    setVertexAttributePointer(3,4,GL_FLOAT,64,8);
-    setVertexAttributePointer(4,4,GL_FLOAT,64,12);
+    setVertexAttributePointer(1,3,GL_FLOAT,sizeof(AffineTransform),0);
+    setVertexAttributePointer(2,3,GL_FLOAT,sizeof(AffineTransform),3);
+    setVertexAttributePointer(3,3,GL_FLOAT,sizeof(AffineTransform),6);
+    setVertexAttributePointer(4,3,GL_FLOAT,sizeof(AffineTransform),9);
     glVertexAttribDivisor(1,1);
     glVertexAttribDivisor(2,1);
     glVertexAttribDivisor(3,1);
     glVertexAttribDivisor(4,1);
 
+    // the draw commands - one per instance in the cache
+    m_commands.assign(data.m_commandData, data.m_commandData+data.m_commandCount);
+    glGenBuffers(1, &m_indirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 static_cast<GLsizeiptr>(sizeof(DrawCommand)*m_commands.size()),
+                 m_commands.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
     m_allocated=true;
     m_indexType=data.m_indexType;
 
     m_instanceCount = data.m_instanceCount;
   }
 
+  void InstanceCacheVAO::setInstanceData(unsigned int _instanceCount, const AffineTransform * _transformData,
+                                         unsigned int _commandCount, const DrawCommand * _commandData)
+  {
+    if(m_allocated == false)
+    {
+      msg->addWarning("trying to set instance data before VOA data");
+      return;
+    }
+    // the buffers are re-specified rather than updated in place, so GL can hand back fresh storage instead of waiting
+    // for the previous frame's draw to finish with the old one
+    glBindBuffer(GL_ARRAY_BUFFER, m_transformBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 static_cast<GLsizeiptr>(sizeof(AffineTransform)*_instanceCount),
+                 _transformData,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_commands.assign(_commandData, _commandData+_commandCount);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 static_cast<GLsizeiptr>(sizeof(DrawCommand)*m_commands.size()),
+                 m_commands.data(),
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    m_instanceCount = _instanceCount;
+  }
+
   Real * InstanceCacheVAO::mapBuffer(unsigned int _index, GLenum _accessMode)
   {
     Real *ptr=nullptr;
@@ -4,9 +4,11 @@
 //----------------------------------------------------------------------------------------------------------------------
 
 #include <algorithm>
-#include <regex>
-
+#include <array>
 #include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <stdexcept>
 #include <iostream>
 #include <math.h>
@@ -15,6 +17,7 @@
 #include <ngl/Mat3.h>
 #include <ngl/Mat4.h>
 #include "LSystem.h"
+#include "Trace.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -64,60 +67,77 @@ void LSystem::seedRandomEngine()
   {
     seed = size_t(std::chrono::system_clock::now().time_since_epoch().count());
   }
-  m_gen.seed(seed);
+  m_randomSeed = seed;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool LSystem::isNonTerminal(char _c) const
+{
+  return m_nonTerminalSet.test(static_cast<unsigned char>(_c));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void LSystem::findBranches(const std::string &_rhs, std::pmr::vector<Branch> &_branches) const
+{
+  _branches.clear();
+  std::pmr::memory_resource * arena = _branches.get_allocator().resource();
+  //nonTerminalCount[k] is the number of non-terminals in _rhs[0..k), so any substring can be checked in O(1)
+  std::pmr::vector<size_t> nonTerminalCount(_rhs.length()+1, 0, arena);
+  std::pmr::vector<size_t> openBrackets(arena);
+  std::pmr::vector<Branch> matched(arena);
+  for(size_t i=0; i<_rhs.length(); i++)
+  {
+    nonTerminalCount[i+1] = nonTerminalCount[i] + (isNonTerminal(_rhs[i]) ? 1 : 0);
+    if(_rhs[i]=='[')
+    {
+      openBrackets.push_back(i);
+    }
+    //unmatched ']'s are ignored, as are any '['s still open at the end of the string
+    else if(_rhs[i]==']' && openBrackets.size()>0)
+    {
+      matched.push_back({openBrackets.back(), i});
+      openBrackets.pop_back();
+    }
+  }
+  //only keep the branches containing at least one non-terminal
+  for(const auto &branch : matched)
+  {
+    if(nonTerminalCount[branch.m_close] > nonTerminalCount[branch.m_open+1])
+    {
+      _branches.push_back(branch);
+    }
+  }
+  //pairs come off the stack in order of their closing brackets, but callers want them in order of opening brackets
+  std::sort(_branches.begin(), _branches.end(),
+            [](const Branch &_a, const Branch &_b){ return _a.m_open < _b.m_open; });
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
 void LSystem::countBranches()
 {
+  ScratchArena::Scope scope(m_scratch);
+  std::pmr::vector<Branch> branches(m_scratch.resource());
   m_branches = {m_axiom};
   for(auto &rule : m_rules)
   {
     rule.m_numBranches = {};
-    for(auto rhs : rule.m_RHS)
+    for(const auto &rhs : rule.m_RHS)
     {
-      int numBranches = 0;
-      for(size_t i=0; i<rhs.length(); i++)
+      findBranches(rhs, branches);
+      for(const auto &b : branches)
       {
-        if(rhs[i]=='[')
+        //view the branch in place rather than copying it out of the rhs
+        std::string_view branch(rhs.data()+b.m_open+1, b.m_close-b.m_open-1);
+        //if the branch hasn't been added to m_branches already, then add it
+        if(std::find(m_branches.begin(), m_branches.end(), branch) == m_branches.end())
         {
-          int bracketCount=0;
-          size_t j=i+1;
-          for(; j<rhs.length(); j++)
-          {
-            if(rhs[j]=='[')
-            {
-              bracketCount++;
-            }
-            if(rhs[j]==']')
-            {
-              if(bracketCount==0)
-              {
-                break;
-              }
-              bracketCount--;
-            }
-          }
-          if(j==rhs.length())
-          {
-            continue;
-          }
-
-          std::string branch(rhs.begin()+int(i+1),rhs.begin()+int(j));
-          //check that the branch contains at least one non-terminal
-          if(std::regex_search(branch, std::regex(m_nonTerminals)))
-          {
-            numBranches++;
-            //if the branch hasn't been added to m_branches already, then add it
-            if(std::find(m_branches.begin(), m_branches.end(), branch) == m_branches.end())
-            {
-              m_branches.push_back(branch);
-            }
-          }
+          m_branches.push_back(std::string(branch));
         }
       }
-      rule.m_numBranches.push_back(numBranches);
+      rule.m_numBranches.push_back(int(branches.size()));
     }
   }
 }
@@ -126,54 +146,103 @@ void LSystem::countBranches()
 
 void LSystem::breakDownRules(std::vector<std::string> _rules)
 {
+  ScratchArena::Scope scope(m_scratch);
   m_rules = {};
   m_nonTerminals = "[";
-  for(auto ruleString : _rules)
+  m_nonTerminalSet.reset();
+  for(const auto &ruleString : _rules)
   {
-    //LRP aims to store rules in the form {LHS, RHS, Probability}
-    std::vector<std::string> LRP;
-    //use boost::split to get LRP={"A","B","C"} when rule is "A=B:C"
-    boost::split(LRP, ruleString, boost::is_any_of("=,:"));
-    //note that if =,: symbols are used incorrectly this will give an incorrect result
-    //for this reason, among others, I have added regex searches below to catch incorrect syntax
+    //single pass over the rule to find the '=', ',' and ':' separators and check the syntax
+    //the rule is split on these into {LHS, RHS, Probability}, ie. "A=B:C" gives LHS "A", RHS "B" and probability "C"
+    size_t numEquals = 0;
+    size_t numColons = 0;
+    size_t firstEquals = std::string::npos;
+    size_t firstColon = std::string::npos;
+    bool reservedCharacter = false;
+    std::array<size_t,3> separators = {std::string::npos, std::string::npos, std::string::npos};
+    size_t numSeparators = 0;
+    for(size_t i=0; i<ruleString.length(); i++)
+    {
+      char c = ruleString[i];
+      switch(c)
+      {
+        case '=':
+        case ',':
+        case ':':
+        {
+          if(numSeparators<separators.size())
+          {
+            separators[numSeparators] = i;
+          }
+          numSeparators++;
+          if(c=='=' && numEquals++==0)
+          {
+            firstEquals = i;
+          }
+          if(c==':' && numColons++==0)
+          {
+            firstColon = i;
+          }
+          break;
+        }
+        case '{':
+        case '}':
+        case '<':
+        case '>':
+        {
+          reservedCharacter = true;
+          break;
+        }
+        default:
+        {
+          break;
+        }
+      }
+    }
 
-    if(!std::regex_search(ruleString, std::regex("=")))
+    if(numEquals==0)
     {
       std::cerr<<"WARNING: excluding rule because no '=' command was given \n";
     }
-    else if(std::regex_search(ruleString, std::regex("=.*=")))
+    else if(numEquals>1)
     {
       std::cerr<<"WARNING: excluding rule because it had too many occurences of '=' \n";
     }
-    else if(std::regex_search(ruleString, std::regex(":.*:")))
+    else if(numColons>1)
     {
       std::cerr<<"WARNING: excluding rule because it had too many occurences of ':' \n";
     }
-    else if(std::regex_search(ruleString, std::regex(":.*=")))
+    else if(firstColon<firstEquals)
     {
       std::cerr<<"WARNING: excluding rule because it contains ':' before '=' \n";
     }
-    else if(std::regex_search(ruleString, std::regex("[{}<>]")))
+    else if(reservedCharacter)
     {
       std::cerr<<"WARNING: excluding rule because it uses one of the reserved characters '{', '}', '<', or '>' \n";
     }
     else
     {
+      //note that a ',' also counts as a separator, so if it is used the pieces may not be what the user intended
+      std::string_view rule(ruleString);
+      std::string_view LHS = rule.substr(0, separators[0]);
+      std::string_view RHS = rule.substr(separators[0]+1, separators[1]-separators[0]-1);
+
       //define probability as 1 unless given otherwise
       float probability = 1;
-      if(LRP.size()>2)
+      if(numSeparators>1)
       {
-        try
-        {
-          probability = std::stof(LRP[2]);
-        }
-        catch(std::invalid_argument)
+        //the probability runs up to the next separator, which stops strtof anyway
+        const char * start = ruleString.c_str()+separators[1]+1;
+        char * end;
+        errno = 0;
+        float parsed = std::strtof(start, &end);
+        if(end==start || errno==ERANGE)
         {
           std::cerr<<"WARNING: unable to convert probability to float \n";
         }
-        catch(std::out_of_range)
+        else
         {
-          std::cerr<<"WARNING: unable to convert probability to float \n";
+          probability = parsed;
         }
       }
 
@@ -182,9 +251,9 @@ void LSystem::breakDownRules(std::vector<std::string> _rules)
       for(; i<m_rules.size(); i++)
       {
         Rule &r = m_rules[i];
-        if(LRP[0]==r.m_LHS)
+        if(LHS==r.m_LHS)
         {
-          r.m_RHS.push_back(LRP[1]);
+          r.m_RHS.push_back(std::string(RHS));
           r.m_prob.push_back(probability);
           break;
         }
@@ -193,9 +262,13 @@ void LSystem::breakDownRules(std::vector<std::string> _rules)
       //and also add this new LHS to m_nonTerminals
       if(i==m_rules.size())
       {
-        Rule r(LRP[0],{LRP[1]},{probability});
+        Rule r(std::string(LHS),{std::string(RHS)},{probability});
         m_rules.push_back(r);
-        m_nonTerminals += LRP[0];
+        m_nonTerminals += LHS;
+        for(char c : LHS)
+        {
+          m_nonTerminalSet.set(static_cast<unsigned char>(c));
+        }
       }
     }
   }
@@ -213,39 +286,65 @@ void LSystem::breakDownRules(std::vector<std::string> _rules)
 
 std::string LSystem::generateTreeString()
 {
-  std::string treeString = m_axiom;
-  int numRules = int(m_rules.size());
+  ScratchArena::Scope scope(m_scratch);
+  return std::string(deriveTreeString());
+}
 
-  std::uniform_real_distribution<float> dist(0.0,1.0);
+std::pmr::string LSystem::deriveTreeString()
+{
+  FOREST_TRACE_ZONE("LSystem::deriveTreeString");
+  std::pmr::memory_resource * arena = m_scratch.resource();
+  std::pmr::string treeString(m_axiom, arena);
+  //each generation is written into nextString and then swapped in, rather than replacing in place
+  std::pmr::string nextString(arena);
+  //the rhs strings for the current generation with # already replaced by the age
+  std::pmr::vector<std::pmr::string> expandedRHS(arena);
+  int numRules = int(m_rules.size());
 
   if(numRules>0)
   {
     for(int i=0; i<m_generation; i++)
     {
       size_t ruleNum = size_t(i % numRules);
-      std::string lhs = m_rules[ruleNum].m_LHS;
-      std::vector<std::string> RHS = m_rules[ruleNum].m_RHS;
-      std::vector<float> probabilities = m_rules[ruleNum].m_prob;
+      const std::string &lhs = m_rules[ruleNum].m_LHS;
+      const std::vector<std::string> &RHS = m_rules[ruleNum].m_RHS;
+      const std::vector<float> &probabilities = m_rules[ruleNum].m_prob;
 
-      //use boost method if there is only one rhs - much faster
-      if(RHS.size()==1)
+      //replace # with the age once per generation rather than once per replacement
+      char age[16];
+      std::snprintf(age, sizeof(age), "%d", i+1);
+      expandedRHS.clear();
+      for(const auto &rhs : RHS)
       {
-        std::string rhs = RHS[0];
-        boost::replace_all(rhs, "#", std::to_string(i+1));
-        boost::replace_all(treeString, lhs, rhs);
+        expandedRHS.emplace_back();
+        std::pmr::string &expanded = expandedRHS.back();
+        for(char c : rhs)
+        {
+          if(c=='#')
+          {
+            expanded += age;
+          }
+          else
+          {
+            expanded += c;
+          }
+        }
       }
 
-      //otherwise we want to apply each replacement individually based on probabilities
-      else
+      nextString.clear();
+      nextString.reserve(treeString.size());
+      size_t last = 0;
+      size_t pos = lhs.empty() ? std::string::npos : treeString.find(lhs);
+      while(pos != std::string::npos)
       {
-        size_t pos = treeString.find(lhs);
-        size_t len = lhs.size();
-        while(pos != std::string::npos)
+        //use the single rhs if there is only one, otherwise pick one based on probabilities
+        //the random number is keyed by (seed, tree, generation, position) so it doesn't depend on any other draw
+        size_t j = 0;
+        if(RHS.size()>1)
         {
-          float randNum = dist(m_gen);
+          float randNum = RandomStream(m_randomSeed, m_treeIndex, uint64_t(i), pos).uniform();
           float count = 0;
-          size_t j = 0;
-          for( ; j<probabilities.size(); j++)
+          for( ; j<probabilities.size()-1; j++)
           {
             count += probabilities[j];
             if(count>=randNum)
@@ -253,13 +352,68 @@ std::string LSystem::generateTreeString()
               break;
             }
           }
-          std::string rhs = RHS[j];
-          boost::replace_all(rhs, "#", std::to_string(i+1));
-          treeString.replace(pos, len, rhs);
-          pos = treeString.find(lhs, pos+rhs.size());
         }
+        nextString.append(treeString, last, pos-last);
+        nextString.append(expandedRHS[j]);
+        last = pos+lhs.size();
+        pos = treeString.find(lhs, last);
       }
+      nextString.append(treeString, last, std::string::npos);
+      treeString.swap(nextString);
     }
   }
+  FOREST_TRACE_COUNTER("symbols derived", treeString.size());
   return treeString;
 }
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryReport LSystem::memoryUsage() const
+{
+  MemoryReport report;
+  size_t grammar = MemoryReport::bytes(m_name) + MemoryReport::bytes(m_axiom) + MemoryReport::bytes(m_rules) +
+                   MemoryReport::bytes(m_nonTerminals) + MemoryReport::bytes(m_branches);
+  for(auto &rule : m_rules)
+  {
+    grammar += MemoryReport::bytes(rule.m_LHS) + MemoryReport::bytes(rule.m_RHS) + MemoryReport::bytes(rule.m_prob) +
+               MemoryReport::bytes(rule.m_numBranches);
+    for(auto &rhs : rule.m_RHS)
+    {
+      grammar += MemoryReport::bytes(rhs);
+    }
+  }
+  for(auto &rule : m_ruleArray)
+  {
+    grammar += MemoryReport::bytes(rule);
+  }
+  for(auto &branch : m_branches)
+  {
+    grammar += MemoryReport::bytes(branch);
+  }
+  report.add("grammar", grammar);
+  //tree strings are only ever derived into the arena, which is kept between generations
+  report.add("tree strings", m_scratch.capacity());
+  const Geometry &tree = geometry();
+  const HeroTrees &heroes = heroTrees();
+  report.add("vertices", MemoryReport::bytes(tree.m_vertices));
+  report.add("indices", MemoryReport::bytes(tree.m_indices));
+  report.add("hero vertices", MemoryReport::bytes(heroes.m_vertices));
+  report.add("hero indices", MemoryReport::bytes(heroes.m_indices));
+  report.add("instance cache", heroes.m_instanceCache.heapBytes());
+  report.add("exit points", MemoryReport::bytes(heroes.m_exitPoints));
+  return report;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const LSystem::Geometry &LSystem::geometry() const
+{
+  static const Geometry empty;
+  return m_geometry ? *m_geometry : empty;
+}
+
+const LSystem::HeroTrees &LSystem::heroTrees() const
+{
+  static const HeroTrees empty;
+  return m_heroTrees ? *m_heroTrees : empty;
+}
@@ -4,9 +4,10 @@
 //----------------------------------------------------------------------------------------------------------------------
 
 #include <algorithm>
-#include <regex>
 #include <random>
 #include <chrono>
+#include <cerrno>
+#include <cstdlib>
 #include <stdexcept>
 #include <iostream>
 #include <math.h>
@@ -16,12 +17,16 @@
 #include <ngl/Mat4.h>
 
 #include "LSystem.h"
+#include "Trace.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void LSystem::createGeometry()
+void LSystem::createGeometry(HeroTrees * _heroTrees)
 {
-  std::string treeString = generateTreeString();
+  FOREST_TRACE_ZONE("LSystem::createGeometry");
+  ScratchArena::Scope scope(m_scratch);
+  std::pmr::memory_resource * arena = m_scratch.resource();
+  std::pmr::string treeString = deriveTreeString();
 
   //std::cout<<treeString<<"\n\n";
 
@@ -43,33 +48,54 @@ void LSystem::createGeometry()
   float paramVar;
   size_t id, age;
 
-  std::vector<GLshort> savedInd = {};
-  std::vector<ngl::Vec3> savedVert = {};
-  std::vector<ngl::Vec3> savedDir = {};
-  std::vector<ngl::Vec3> savedRight = {};
-  std::vector<float> savedStep = {};
-  std::vector<float> savedAngle = {};
-
-  Instance instance;
-  Instance * currentInstance;
-  std::vector<Instance *> savedInstance = {};
+  //turtle stacks - these live in m_scratch
+  std::pmr::vector<GLshort> savedInd(arena);
+  std::pmr::vector<ngl::Vec3> savedVert(arena);
+  std::pmr::vector<ngl::Vec3> savedDir(arena);
+  std::pmr::vector<ngl::Vec3> savedRight(arena);
+  std::pmr::vector<float> savedStep(arena);
+  std::pmr::vector<float> savedAngle(arena);
+
+  //instances being built are referred to by their position in the instance cache rather than by pointer, since adding
+  //to the cache moves the elements after the insertion point; instances that didn't fit in the cache are still
+  //tracked so that the '}' and '>' commands pair up, but aren't written to
+  struct InstanceRef
+  {
+    bool m_cached;
+    size_t m_id;
+    size_t m_age;
+    size_t m_index;
+  };
+  std::pmr::vector<InstanceRef> savedInstance(arena);
+
+  //exit points are found interleaved between the instances that are open at the time, so they're collected here
+  //and grouped by instance into the hero trees' exit points at the end
+  struct PendingExitPoint
+  {
+    InstanceRef m_instance;
+    Instance::ExitPoint m_exitPoint;
+  };
+  std::pmr::vector<PendingExitPoint> pendingExitPoints(arena);
 
+  std::shared_ptr<Geometry> geometry;
   std::vector<ngl::Vec3> * vertices;
   std::vector<GLshort> * indices;
-  if(m_forestMode == false)
+  if(_heroTrees == nullptr)
   {
-    m_vertices = {lastVertex};
-    m_indices = {};
-    vertices = &m_vertices;
-    indices = &m_indices;
+    geometry = std::make_shared<Geometry>();
+    geometry->m_vertices = {lastVertex};
+    vertices = &geometry->m_vertices;
+    indices = &geometry->m_indices;
   }
   else
   {
-    lastIndex = GLshort(m_heroVertices.size());
-    m_heroVertices.push_back(lastVertex);
-    vertices = &m_heroVertices;
-    indices = &m_heroIndices;
+    lastIndex = GLshort(_heroTrees->m_vertices.size());
+    _heroTrees->m_vertices.push_back(lastVertex);
+    vertices = &_heroTrees->m_vertices;
+    indices = &_heroTrees->m_indices;
   }
+  //both branches start the tree with its root vertex
+  [[maybe_unused]] size_t firstVertex = vertices->size()-1;
 
   for(size_t i=0; i<treeString.size(); i++)
   {
@@ -190,6 +216,11 @@ void LSystem::createGeometry()
       case '{':
       {
         parseInstanceBrackets(treeString, i, id, age);
+        //without hero trees to cut instances into, the instancing commands are ignored and every branch is drawn
+        if(_heroTrees == nullptr)
+        {
+          break;
+        }
 
         ngl::Vec3 k = right.cross(dir);
         ngl::Mat4 transform(right.m_x,      right.m_y,      right.m_z,      0,
@@ -197,30 +228,33 @@ void LSystem::createGeometry()
                             k.m_x,          k.m_y,          k.m_z,          0,
                             lastVertex.m_x, lastVertex.m_y, lastVertex.m_z, 1);
 
-        instance = Instance(transform);
-        instance.m_instanceStart = indices->size();
-        if(m_instanceCache[id][age].size()<=size_t(m_maxInstancePerLevel/(age+1)))
+        if(_heroTrees->m_instanceCache.size(id,age)<=size_t(m_maxInstancePerLevel/(age+1)))
         {
-          m_instanceCache[id][age].push_back(instance);
-          currentInstance = &m_instanceCache[id][age].back();
+          Instance instance(transform);
+          instance.m_instanceStart = indices->size();
+          size_t index = _heroTrees->m_instanceCache.push_back(id, age, std::move(instance));
+          savedInstance.push_back({true, id, age, index});
         }
         else
         {
-          currentInstance = &instance;
+          savedInstance.push_back({false, id, age, 0});
         }
-
-        savedInstance.push_back(currentInstance);
         break;
       }
 
       //stopInstance
       case '}':
       {
-        currentInstance->m_instanceEnd = indices->size();
-        savedInstance.pop_back();
-        if(savedInstance.size()>0)
+        if(_heroTrees != nullptr && savedInstance.size()>0)
         {
-          currentInstance = savedInstance.back();
+          const InstanceRef &current = savedInstance.back();
+          if(current.m_cached)
+          {
+            Instance &instance = _heroTrees->m_instanceCache.at(current.m_id, current.m_age, current.m_index);
+            instance.m_instanceEnd = indices->size();
+            instance.computeBounds(*vertices, *indices);
+          }
+          savedInstance.pop_back();
         }
         break;
       }
@@ -229,6 +263,10 @@ void LSystem::createGeometry()
       case '<':
       {
         parseInstanceBrackets(treeString, i, id, age);
+        if(_heroTrees == nullptr)
+        {
+          break;
+        }
 
         ngl::Vec3 k = right.cross(dir);
         ngl::Mat4 transform(right.m_x,      right.m_y,      right.m_z,      0,
@@ -236,19 +274,22 @@ void LSystem::createGeometry()
                             k.m_x,          k.m_y,          k.m_z,          0,
                             lastVertex.m_x, lastVertex.m_y, lastVertex.m_z, 1);
 
-        for(auto instance : savedInstance)
+        for(auto &ref : savedInstance)
         {
-          instance->m_exitPoints.push_back(Instance::ExitPoint(id, age, instance->m_transform.inverse()*transform));
+          if(ref.m_cached)
+          {
+            Instance &instance = _heroTrees->m_instanceCache.at(ref.m_id, ref.m_age, ref.m_index);
+            pendingExitPoints.push_back({ref, Instance::ExitPoint(id, age, instance.m_transform.inverse()*transform)});
+          }
         }
 
-        //if the instance cachec currently has no entries for this (id,age) pair, add a new instance to it
-        if(m_instanceCache[id][age].size()==0)
+        //if the instance cache currently has no entries for this (id,age) pair, add a new instance to it
+        if(_heroTrees->m_instanceCache.size(id,age)==0)
         {
-          instance = Instance(transform);
+          Instance instance(transform);
           instance.m_instanceStart = indices->size();
-          m_instanceCache[id][age].push_back(instance);
-          currentInstance = &m_instanceCache[id][age].back();
-          savedInstance.push_back(currentInstance);
+          _heroTrees->m_instanceCache.push_back(id, age, std::move(instance));
+          savedInstance.push_back({true, id, age, 0});
         }
         else
         {
@@ -262,11 +303,16 @@ void LSystem::createGeometry()
       {
         //note that assuming > doesn't appear in any rules, we will only reach this
         //case if we are using the corresponding < to make an instance
-        currentInstance->m_instanceEnd = indices->size();
-        savedInstance.pop_back();
-        if(savedInstance.size()>0)
+        if(_heroTrees != nullptr && savedInstance.size()>0)
         {
-          currentInstance = savedInstance.back();
+          const InstanceRef &current = savedInstance.back();
+          if(current.m_cached)
+          {
+            Instance &instance = _heroTrees->m_instanceCache.at(current.m_id, current.m_age, current.m_index);
+            instance.m_instanceEnd = indices->size();
+            instance.computeBounds(*vertices, *indices);
+          }
+          savedInstance.pop_back();
         }
         break;
       }
@@ -277,6 +323,36 @@ void LSystem::createGeometry()
       }
     }
   }
+
+  //every instance is opened and closed within this tree, so sorting by instance gives each its complete set of
+  //exit points as one run, in the order they were found
+  std::stable_sort(pendingExitPoints.begin(), pendingExitPoints.end(),
+                   [](const PendingExitPoint &_a, const PendingExitPoint &_b)
+  {
+    const InstanceRef &a = _a.m_instance;
+    const InstanceRef &b = _b.m_instance;
+    return a.m_id!=b.m_id ? a.m_id<b.m_id : (a.m_age!=b.m_age ? a.m_age<b.m_age : a.m_index<b.m_index);
+  });
+  for(size_t j=0; j<pendingExitPoints.size(); )
+  {
+    const InstanceRef &ref = pendingExitPoints[j].m_instance;
+    Instance &instance = _heroTrees->m_instanceCache.at(ref.m_id, ref.m_age, ref.m_index);
+    instance.m_exitPointStart = uint32_t(_heroTrees->m_exitPoints.size());
+    for( ; j<pendingExitPoints.size() &&
+           pendingExitPoints[j].m_instance.m_id==ref.m_id &&
+           pendingExitPoints[j].m_instance.m_age==ref.m_age &&
+           pendingExitPoints[j].m_instance.m_index==ref.m_index; j++)
+    {
+      _heroTrees->m_exitPoints.push_back(pendingExitPoints[j].m_exitPoint);
+    }
+    instance.m_numExitPoints = uint32_t(_heroTrees->m_exitPoints.size())-instance.m_exitPointStart;
+  }
+  FOREST_TRACE_COUNTER("vertices emitted", vertices->size()-firstVertex);
+  if(geometry)
+  {
+    m_geometry = std::move(geometry);
+  }
+
   if(m_parameterError)
   {
     std::cerr<<"WARNING: unable to parse one or more parameters \n";
@@ -286,7 +362,7 @@ void LSystem::createGeometry()
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void LSystem::parseBrackets(const std::string &_treeString, size_t &_i, float &_paramVar)
+void LSystem::parseBrackets(const std::pmr::string &_treeString, size_t &_i, float &_paramVar)
 {
   if(_i+1<_treeString.length() && _treeString.at(_i+1)=='(')
   {
@@ -300,18 +376,18 @@ void LSystem::parseBrackets(const std::string &_treeString, size_t &_i, float &_
     }
     if(j!=_treeString.size() && j>_i+2)
     {
-      try
-      {
-        std::string parameter = _treeString.substr(_i+2, j-_i-2);
-        _paramVar = std::stof(parameter);
-      }
-      catch(std::invalid_argument)
+      //parse straight out of the tree string - the ')' at j stops strtof so there is no need for a substring
+      const char * start = _treeString.c_str()+_i+2;
+      char * end;
+      errno = 0;
+      float parameter = std::strtof(start, &end);
+      if(end==start || errno==ERANGE)
       {
         m_parameterError = true;
       }
-      catch(std::out_of_range)
+      else
       {
-        m_parameterError = true;
+        _paramVar = parameter;
       }
       _i=j;
     }
@@ -320,7 +396,7 @@ void LSystem::parseBrackets(const std::string &_treeString, size_t &_i, float &_
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void LSystem::parseInstanceBrackets(const std::string &_treeString, size_t &_i, size_t &_id, size_t &_age)
+void LSystem::parseInstanceBrackets(const std::pmr::string &_treeString, size_t &_i, size_t &_id, size_t &_age)
 {
   //don't need the outer if clause that parseBrackets() has because <, { are guaranteed to be followed by (
   size_t j=_i+2;
@@ -331,8 +407,7 @@ void LSystem::parseInstanceBrackets(const std::string &_treeString, size_t &_i,
       break;
     }
   }
-  std::string id = _treeString.substr(_i+2, j-_i-2);
-  _id = size_t(std::stoi(id));
+  _id = size_t(std::strtoul(_treeString.c_str()+_i+2, nullptr, 10));
   _i=j;
 
   for( ; j<_treeString.size(); j++)
@@ -342,14 +417,13 @@ void LSystem::parseInstanceBrackets(const std::string &_treeString, size_t &_i,
       break;
     }
   }
-  std::string age = _treeString.substr(_i+1, j-_i-1);
-  _age = size_t(std::stoi(age));
+  _age = size_t(std::strtoul(_treeString.c_str()+_i+1, nullptr, 10));
   _i=j;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void LSystem::skipToNextChevron(const std::string &_treeString, size_t &_i)
+void LSystem::skipToNextChevron(const std::pmr::string &_treeString, size_t &_i)
 {
   int chevronCount = 0;
   size_t j=_i+1;
@@ -4,7 +4,6 @@
 //----------------------------------------------------------------------------------------------------------------------
 
 #include <algorithm>
-#include <regex>
 #include <random>
 #include <chrono>
 #include <stdexcept>
@@ -15,6 +14,7 @@
 #include <ngl/Mat3.h>
 #include <ngl/Mat4.h>
 #include "LSystem.h"
+#include "Trace.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -46,75 +46,64 @@ void LSystem::addInstancingCommands()
 
 void LSystem::addInstancingToRule(std::string &_rhs, float &_prob, int _index)
 {
-  int count = 1;
+  ScratchArena::Scope scope(m_scratch);
+  std::pmr::memory_resource * arena = m_scratch.resource();
+  std::pmr::vector<Branch> branches(arena);
+  findBranches(_rhs, branches);
+
   int instanceCount = 0;
   int nonInstanceCount = 0;
+  //closingSymbol[j] stores the '>' or '}' to write after the ']' at index j, or 0 if there isn't one
+  std::pmr::vector<char> closingSymbol(_rhs.length(), 0, arena);
+  std::string result;
+  result.reserve(_rhs.length() + branches.size()*8);
+
+  size_t count = 0;
   for(size_t i=0; i<_rhs.length(); i++)
   {
-    if(_rhs[i]=='[')
+    if(count<branches.size() && branches[count].m_open==i)
     {
-      int bracketCount = 0;
+      const Branch &b = branches[count];
+      std::string_view branch(_rhs.data()+b.m_open+1, b.m_close-b.m_open-1);
       size_t id;
-      size_t j=i+1;
-      for(; j<_rhs.length(); j++)
+      //if the branch hasn't been added to m_branches already, then add it
+      //^BUT THIS BIT SHOULD BE UNNECESSARY - THE BRANCHES HAVE ALREADY ALL BEEN ADDED TO M_BRANCHES BY COUNT BRANCHES
+      auto it = std::find(m_branches.begin(), m_branches.end(), branch);
+      if(it == m_branches.end())
       {
-        if(_rhs[j]=='[')
-        {
-          bracketCount++;
-        }
-        if(_rhs[j]==']')
-        {
-          if(bracketCount==0)
-          {
-            break;
-          }
-          bracketCount--;
-        }
+        id = m_branches.size();
+        m_branches.push_back(std::string(branch));
       }
-      if(j==_rhs.length())
+      //otherwise, the id is the index of the branch in m_branches
+      else
       {
-        continue;
+        id = size_t(std::distance(m_branches.begin(),it));
       }
-      std::string branch(_rhs.begin()+int(i+1),_rhs.begin()+int(j));
-      //check that the branch contains at least one non-terminal
-      if(std::regex_search(branch, std::regex(m_nonTerminals)))
-      {
-        //if the branch hasn't been added to m_branches already, then add it
-        //^BUT THIS BIT SHOULD BE UNNECESSARY - THE BRANCHES HAVE ALREADY ALL BEEN ADDED TO M_BRANCHES BY COUNT BRANCHES
-        auto it = std::find(m_branches.begin(), m_branches.end(), branch);
-        if(it == m_branches.end())
-        {
-          id = m_branches.size();
-          m_branches.push_back(branch);
-        }
-        //otherwise, the id is the index of the branch in m_branches
-        else
-        {
-          id = size_t(std::distance(m_branches.begin(),it));
-        }
 
-        std::string replacement;
-        size_t skipAmount = 0;
-        if(_index % int(pow(2,count)) < int(pow(2,count-1)))
-        {
-          replacement = "<(" + std::to_string(id) + ",#)[" + branch + "]>";
-          instanceCount++;
-          skipAmount = 5+std::to_string(id).size();
-        }
-        else
-        {
-          replacement = "{(" + std::to_string(id) + ",#)[" + branch + "]}";
-          nonInstanceCount++;
-          //add to skipAmount to make sure we don't get caught in an endless loop with the same [
-          skipAmount = 5+std::to_string(id).size();
-        }
-
-        _rhs.replace(i, j-i+1, replacement);
-        i += skipAmount;
-        count++;
+      //bit number count of _index decides whether this branch is instanced or not
+      if(((_index >> count) & 1) == 0)
+      {
+        result += "<(";
+        closingSymbol[b.m_close] = '>';
+        instanceCount++;
       }
+      else
+      {
+        result += "{(";
+        closingSymbol[b.m_close] = '}';
+        nonInstanceCount++;
+      }
+      result += std::to_string(id);
+      result += ",#)";
+      count++;
+    }
+    result += _rhs[i];
+    if(closingSymbol[i] != 0)
+    {
+      result += closingSymbol[i];
     }
   }
+  _rhs = result;
   _prob *= pow(m_instancingProb, instanceCount) * pow(1-m_instancingProb, nonInstanceCount);
 }
 
@@ -122,19 +111,20 @@ void LSystem::addInstancingToRule(std::string &_rhs, float &_prob, int _index)
 
 void LSystem::fillInstanceCache(int _numHeroTrees)
 {
+  FOREST_TRACE_ZONE("LSystem::fillInstanceCache");
   seedRandomEngine();
   addInstancingCommands();
-  RESIZE_CACHE_BY_VALUES(m_instanceCache, m_branches.size(), size_t(m_generation)+1)
-
-  m_forestMode = true;
-  m_heroIndices = {};
-  m_heroVertices = {};
-
+  //grown into a new HeroTrees, so copies sharing the old one keep it
+  std::shared_ptr<HeroTrees> heroTrees = std::make_shared<HeroTrees>();
+  heroTrees->m_instanceCache.resize(m_branches.size(), size_t(m_generation)+1);
 
   for(int i=0; i<_numHeroTrees; i++)
   {
-    createGeometry();
+    m_treeIndex = size_t(i);
+    createGeometry(heroTrees.get());
   }
+  heroTrees->m_instanceCache.finalize();
 
-  m_forestMode = false;
+  m_treeIndex = 0;
+  m_heroTrees = std::move(heroTrees);
 }
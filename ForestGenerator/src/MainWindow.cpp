@@ -5,6 +5,8 @@
 
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
+#include <QKeySequence>
+#include <QShortcut>
 #include <QString>
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -21,10 +23,30 @@ MainWindow::MainWindow(QWidget *parent) :
   connect(m_ui->m_grid,SIGNAL(stateChanged(int)),m_gl,SLOT(toggleGrid(int)));
   connect(m_ui->m_resetCamera_layout,SIGNAL(clicked()),m_gl,SLOT(resetCamera()));
   connect(m_ui->m_resetCamera_render,SIGNAL(clicked()),m_gl,SLOT(resetCamera()));
+  connect(m_ui->m_lodDistance,SIGNAL(valueChanged(double)),m_gl,SLOT(setLODDistance(double)));
+  connect(m_ui->m_thinningStart,SIGNAL(valueChanged(double)),m_gl,SLOT(setThinningStart(double)));
+  connect(m_ui->m_thinningEnd,SIGNAL(valueChanged(double)),m_gl,SLOT(setThinningEnd(double)));
 
   connect(m_ui->m_superTab,SIGNAL(currentChanged(int)),m_gl,SLOT(changeSuperTab(int)));
   connect(m_ui->m_tab,SIGNAL(currentChanged(int)),m_gl,SLOT(changeTab(int)));
 
+  //per-frame counters go to the status bar, and Ctrl+L logs them to a CSV file
+  connect(m_gl,SIGNAL(frameStatsChanged(QString)),m_ui->statusbar,SLOT(showMessage(QString)));
+  QShortcut *toggleFrameLog = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_L), this);
+  connect(toggleFrameLog,SIGNAL(activated()),m_gl,SLOT(toggleFrameLog()));
+  //Ctrl+M prints where the memory is going
+  QShortcut *printMemoryUsage = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_M), this);
+  connect(printMemoryUsage,SIGNAL(activated()),m_gl,SLOT(printMemoryUsage()));
+  //Escape stops the tree and forest builds running in the background
+  QShortcut *cancelBuilds = new QShortcut(QKeySequence(Qt::Key_Escape), this);
+  connect(cancelBuilds,SIGNAL(activated()),m_gl,SLOT(cancelBuilds()));
+
+#ifdef FOREST_TRACING
+  //Ctrl+T writes out the trace recorded so far
+  QShortcut *writeTrace = new QShortcut(QKeySequence(Qt::CTRL + Qt::Key_T), this);
+  connect(writeTrace,SIGNAL(activated()),m_gl,SLOT(writeTrace()));
+#endif
+
   //TREE 1
   //------------------------------------------------------------------------------------
 
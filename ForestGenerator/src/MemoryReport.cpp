@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MemoryReport.cpp
+/// @brief implementation file for MemoryReport class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <iomanip>
+#include "MemoryReport.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryReport::add(const std::string &_name, size_t _bytes)
+{
+  m_entries.push_back({_name, _bytes});
+}
+
+void MemoryReport::add(const std::string &_prefix, const MemoryReport &_report)
+{
+  for(auto &entry : _report.m_entries)
+  {
+    m_entries.push_back({_prefix+"/"+entry.m_name, entry.m_bytes});
+  }
+}
+
+size_t MemoryReport::total() const
+{
+  size_t result = 0;
+  for(auto &entry : m_entries)
+  {
+    result += entry.m_bytes;
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryReport::print(std::ostream &_out) const
+{
+  size_t width = 5;
+  for(auto &entry : m_entries)
+  {
+    width = std::max(width, entry.m_name.size());
+  }
+  std::ios::fmtflags flags = _out.flags();
+  std::streamsize precision = _out.precision();
+  auto line = [&](const std::string &_name, size_t _bytes)
+  {
+    _out<<"  "<<std::left<<std::setw(int(width))<<_name<<std::right<<std::setw(14)<<std::fixed<<std::setprecision(1)
+        <<_bytes/1024.0<<" KB\n";
+  };
+  for(auto &entry : m_entries)
+  {
+    line(entry.m_name, entry.m_bytes);
+  }
+  line("total", total());
+  _out.flags(flags);
+  _out.precision(precision);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+size_t MemoryReport::bytes(const std::string &_string)
+{
+  //short strings are stored inside the string object itself
+  return _string.capacity() > std::string().capacity() ? _string.capacity()+1 : 0;
+}
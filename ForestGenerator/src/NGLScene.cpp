@@ -3,8 +3,12 @@
 /// @brief implementation file for NGLScene class
 //----------------------------------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <QMouseEvent>
 #include <QGuiApplication>
+#include <QOpenGLContext>
 
 #include <ngl/NGLInit.h>
 #include <ngl/ShaderLib.h>
@@ -15,6 +19,7 @@
 #include "InstanceCacheVAO.h"
 #include "NGLScene.h"
 #include "Camera.h"
+#include "Trace.h"
 
 //------------------------------------------------------------------------------------------------------------------------
 ///CONSTRUCTORS AND DESTRUCTORS
@@ -38,12 +43,14 @@ NGLScene::NGLScene(QWidget *_parent) : QOpenGLWidget( _parent )
   m_mouseTransforms[2].resize(1);
 
   m_terrainDimension = 1025;
+  connect(&m_buildTimer, SIGNAL(timeout()), this, SLOT(update()));
   initializeLSystems();
   m_forestVAOs.resize(m_numTreeTabs);
-  m_forest = Forest(m_LSystems,
-                    m_width, m_length,
-                    m_numTrees, m_numHeroTrees,
-                    m_terrainDimension);
+  m_forest = std::make_shared<Forest>(m_LSystems,
+                                      m_width, m_length,
+                                      m_numTrees, m_numHeroTrees,
+                                      m_terrainDimension, m_scatterMode,
+                                      m_instanceCacheDirectory);
 
   m_currentCamera = &m_cameras[0][0];
   m_currentMouseTransform = &m_mouseTransforms[0][0];
@@ -51,8 +58,10 @@ NGLScene::NGLScene(QWidget *_parent) : QOpenGLWidget( _parent )
 
   m_currentLSystem->createGeometry();
 
-  m_forest.m_terrainGen.generate();
-  m_terrain = TerrainData(m_forest.m_terrainGen);
+  m_terrain = TerrainData(m_forest->m_terrainGen);
+  m_buildForestVAOs.assign(m_numTreeTabs, true);
+  m_uploadForestTransforms.assign(m_numTreeTabs, false);
+  m_forestKeys = m_forest->m_builtKeys;
 }
 
 NGLScene::~NGLScene()
@@ -66,8 +75,18 @@ NGLScene::~NGLScene()
   }
   for(size_t t=0; t<m_numTreeTabs; t++)
   {
-    FOR_EACH_ELEMENT(m_forestVAOs[t],
-                     m_forestVAOs[t][ID][AGE][INDEX]->removeVAO())
+    if(m_forestVAOs[t])
+    {
+      m_forestVAOs[t]->removeVAO();
+    }
+  }
+  for(auto &query : m_pendingTimerQueries)
+  {
+    m_freeTimerQueries.push_back(query.first);
+  }
+  if(!m_freeTimerQueries.empty())
+  {
+    glDeleteQueries(GLsizei(m_freeTimerQueries.size()), m_freeTimerQueries.data());
   }
 }
 
@@ -123,16 +142,28 @@ void NGLScene::initializeGL()
   //set up LSystem VAOs:
   for(size_t i=0; i<m_numTreeTabs; i++)
   {
-    buildVAO(m_treeVAOs[i], m_LSystems[i].m_vertices, m_LSystems[i].m_indices, GL_LINES, GL_UNSIGNED_SHORT);
+    const LSystem::Geometry &geometry = m_LSystems[i].geometry();
+    buildVAO(m_treeVAOs[i], geometry.m_vertices, geometry.m_indices, GL_LINES, GL_UNSIGNED_SHORT);
+  }
+
+  //frames are timed on the GPU where the context has timer queries, which are core from GL 3.3
+  if(context()->format().version() >= qMakePair(3,3) || context()->hasExtension("GL_ARB_timer_query"))
+  {
+    m_freeTimerQueries.resize(m_numTimerQueries);
+    glGenQueries(GLsizei(m_freeTimerQueries.size()), m_freeTimerQueries.data());
   }
 }
 
 //------------------------------------------------------------------------------------------------------------------------
 
 template<class dataType>
-void NGLScene::buildVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, std::vector<ngl::Vec3> &_vertices,
-                        std::vector<dataType> &_indices, GLenum _mode, GLenum _indexType)
+void NGLScene::buildVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, const std::vector<ngl::Vec3> &_vertices,
+                        const std::vector<dataType> &_indices, GLenum _mode, GLenum _indexType)
 {
+  FOREST_TRACE_ZONE("NGLScene::buildVAO");
+  size_t bytes = sizeof(ngl::Vec3)*_vertices.size() + sizeof(dataType)*_indices.size();
+  m_frameStats.m_current.m_uploadedBytes += bytes;
+  m_vaoBytes[&_vao] = bytes;
   // create a vao using GL_LINES
   _vao=ngl::VAOFactory::createVAO(ngl::simpleIndexVAO,_mode);
   _vao->bind();
@@ -152,29 +183,230 @@ void NGLScene::buildVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, std::vector<ngl
 
 //------------------------------------------------------------------------------------------------------------------------
 
-void NGLScene::buildInstanceCacheVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, LSystem &_treeType,
-                                     Instance &_instance, std::vector<ngl::Mat4> &_transforms)
+void NGLScene::buildInstanceCacheVAO(std::unique_ptr<ngl::AbstractVAO> &_vao, const LSystem &_treeType,
+                                     const Forest::TransformCache &_transforms)
 {
+  FOREST_TRACE_ZONE("NGLScene::buildInstanceCacheVAO");
+  const LSystem::HeroTrees &heroTrees = _treeType.heroTrees();
+  if(heroTrees.m_vertices.empty())
+  {
+    _vao.reset();
+    m_vaoBytes[&_vao] = 0;
+    return;
+  }
+
+  std::vector<ngl::InstanceCacheVAO::DrawCommand> commands = forestDrawCommands(_treeType, _transforms);
+  size_t bytes = sizeof(ngl::Vec3)*heroTrees.m_vertices.size() + sizeof(GLshort)*heroTrees.m_indices.size() +
+                 sizeof(AffineTransform)*_transforms.m_transforms.size() +
+                 sizeof(ngl::InstanceCacheVAO::DrawCommand)*commands.size();
+  m_frameStats.m_current.m_uploadedBytes += bytes;
+  m_vaoBytes[&_vao] = bytes;
+
   // create a vao using GL_LINES
   _vao=ngl::VAOFactory::createVAO("instanceCacheVAO",GL_LINES);
   _vao->bind();
-  // set our data for the VAO
+  // set our data for the VAO - the hero geometry and the transforms of the whole tree type are uploaded once
   _vao->setData(ngl::InstanceCacheVAO::VertexData(
-                       sizeof(ngl::Vec3)*_treeType.m_heroVertices.size(),
-                       _treeType.m_heroVertices[0].m_x,
-                       uint(_instance.m_instanceEnd-_instance.m_instanceStart),
-                       &_treeType.m_heroIndices[_instance.m_instanceStart],
-                       uint(_transforms.size()),
-                       &_transforms[0]));
-  // set number of indices to length of current instance
-  _vao->setNumIndices(_instance.m_instanceEnd-_instance.m_instanceStart);
+                       sizeof(ngl::Vec3)*heroTrees.m_vertices.size(),
+                       heroTrees.m_vertices[0].m_x,
+                       uint(heroTrees.m_indices.size()),
+                       heroTrees.m_indices.data(),
+                       uint(_transforms.m_transforms.size()),
+                       _transforms.m_transforms.data(),
+                       uint(commands.size()),
+                       commands.data()));
+  _vao->setNumIndices(heroTrees.m_indices.size());
   _vao->unbind();
 }
 
+std::vector<ngl::InstanceCacheVAO::DrawCommand> NGLScene::forestDrawCommands(const LSystem &_treeType,
+                                                                             const Forest::TransformCache &_transforms)
+{
+  // one draw command per instance in the cache: its range of the hero indices, drawn once for each of its
+  // transforms, which start at its offset into the transform cache
+  const InstanceCache<Instance> &instanceCache = _treeType.heroTrees().m_instanceCache;
+  std::vector<ngl::InstanceCacheVAO::DrawCommand> commands;
+  commands.reserve(instanceCache.size());
+  for(size_t k=0; k+1<_transforms.m_offsets.size() && k<instanceCache.size(); k++)
+  {
+    const Instance &instance = instanceCache[k];
+    if(_transforms.size(k)>0 && instance.m_instanceEnd>instance.m_instanceStart)
+    {
+      commands.push_back({GLuint(instance.m_instanceEnd-instance.m_instanceStart),
+                          GLuint(_transforms.size(k)),
+                          GLuint(instance.m_instanceStart),
+                          0,
+                          GLuint(_transforms.m_offsets[k])});
+    }
+  }
+  return commands;
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::cullForest(const ngl::Mat4 &_MVP)
+{
+  FOREST_TRACE_ZONE("NGLScene::cullForest");
+  //the camera position in forest space, for picking each tree's level of detail
+  ngl::Mat4 model = (*m_currentMouseTransform)*m_initialRotation;
+  ngl::Vec3 eye = AffineTransform(model.inverse()).transformPoint(m_currentCamera->m_from);
+  m_forest->m_lodDistance = m_forestLODDistance;
+  m_forest->m_thinningStart = m_forestThinningStart;
+  m_forest->m_thinningEnd = m_forestThinningEnd;
+  m_forest->cull(_MVP, eye);
+  for(size_t t=0; t<m_forest->m_treeTypes.size() && t<m_forestVAOs.size(); t++)
+  {
+    setForestInstances(t, m_forest->m_visibleCache[t]);
+  }
+}
+
+void NGLScene::setForestInstances(size_t _treeType, const Forest::TransformCache &_transforms)
+{
+  if(!m_forestVAOs[_treeType])
+  {
+    return;
+  }
+  const LSystem &treeType = m_forest->m_treeTypes[_treeType];
+  std::vector<ngl::InstanceCacheVAO::DrawCommand> commands = forestDrawCommands(treeType, _transforms);
+  const LSystem::HeroTrees &heroTrees = treeType.heroTrees();
+  size_t instanceBytes = sizeof(AffineTransform)*_transforms.m_transforms.size() +
+                         sizeof(ngl::InstanceCacheVAO::DrawCommand)*commands.size();
+  m_frameStats.m_current.m_uploadedBytes += instanceBytes;
+  m_vaoBytes[&m_forestVAOs[_treeType]] = sizeof(ngl::Vec3)*heroTrees.m_vertices.size() +
+                                         sizeof(GLshort)*heroTrees.m_indices.size() + instanceBytes;
+  static_cast<ngl::InstanceCacheVAO *>(m_forestVAOs[_treeType].get())->setInstanceData(
+                                                                       uint(_transforms.m_transforms.size()),
+                                                                       _transforms.m_transforms.data(),
+                                                                       uint(commands.size()),
+                                                                       commands.data());
+}
+
+MemoryReport NGLScene::memoryUsage() const
+{
+  MemoryReport report;
+  report.add("forest", m_forest->memoryUsage());
+  report.add("terrain LOD", m_terrain.memoryUsage());
+  for(size_t i=0; i<m_LSystems.size(); i++)
+  {
+    report.add("tree tab "+std::to_string(i+1), m_LSystems[i].memoryUsage());
+  }
+  //GL buffers are sized from the data last uploaded to each VAO
+  auto vaoBytes = [&](const std::unique_ptr<ngl::AbstractVAO> &_vao)
+  {
+    auto vao = m_vaoBytes.find(&_vao);
+    return vao == m_vaoBytes.end() ? size_t(0) : vao->second;
+  };
+  report.add("GL buffers/grid", vaoBytes(m_gridVAO));
+  report.add("GL buffers/terrain", vaoBytes(m_terrainVAO));
+  for(size_t i=0; i<m_treeVAOs.size(); i++)
+  {
+    report.add("GL buffers/tree tab "+std::to_string(i+1), vaoBytes(m_treeVAOs[i]));
+  }
+  for(size_t t=0; t<m_forestVAOs.size(); t++)
+  {
+    report.add("GL buffers/forest "+std::to_string(t), vaoBytes(m_forestVAOs[t]));
+  }
+  return report;
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::collectTimerQueries()
+{
+  //queries finish in the order they were issued, so stop at the first that hasn't
+  while(!m_pendingTimerQueries.empty())
+  {
+    GLuint query = m_pendingTimerQueries.front().first;
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+    {
+      break;
+    }
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    m_frameStats.setGPUTime(m_pendingTimerQueries.front().second, double(nanoseconds)/1.0e6);
+    m_freeTimerQueries.push_back(query);
+    m_pendingTimerQueries.pop_front();
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::takeBuildResults()
+{
+  bool building = false;
+  for(size_t i=0; i<m_treeBuilds.size(); i++)
+  {
+    if(std::unique_ptr<std::shared_ptr<const LSystem::Geometry>> geometry = m_treeBuilds[i]->take())
+    {
+      m_LSystems[i].m_geometry = std::move(*geometry);
+      m_buildTreeVAOs[i] = true;
+    }
+    building |= m_treeBuilds[i]->running();
+  }
+  if(std::unique_ptr<Forest> forest = m_forestBuild.take())
+  {
+    m_forest = std::make_shared<Forest>(std::move(*forest));
+    for(size_t t=0; t<m_forest->m_changedTreeTypes.size() && t<m_buildForestVAOs.size(); t++)
+    {
+      m_buildForestVAOs[t] = m_buildForestVAOs[t] || m_forest->m_regrownTreeTypes[t];
+      m_uploadForestTransforms[t] = m_uploadForestTransforms[t] || m_forest->m_changedTreeTypes[t];
+    }
+  }
+  building |= m_forestBuild.running();
+  //a failed forest build leaves the old forest up, and is tried again the next time the forest tab is opened
+  std::shared_ptr<const BuildProgress> forestProgress = m_forestBuild.progress();
+  if(forestProgress && forestProgress->failed())
+  {
+    m_forestKeys = m_forest->m_builtKeys;
+  }
+  if(!building)
+  {
+    m_buildTimer.stop();
+  }
+}
+
+std::string NGLScene::buildStatus() const
+{
+  std::string status;
+  auto describe = [&](const std::string &_name, const std::shared_ptr<const BuildProgress> &_progress)
+  {
+    if(_progress && _progress->failed())
+    {
+      status += " | "+_name+" build failed: "+_progress->error();
+    }
+    else if(_progress && !_progress->finished())
+    {
+      status += " | building "+_name+": "+_progress->stage()+" "+
+                std::to_string(int(std::lround(_progress->fraction()*100.0f)))+"%";
+    }
+  };
+  for(size_t i=0; i<m_treeBuilds.size(); i++)
+  {
+    describe("tree "+std::to_string(i+1), m_treeBuilds[i]->progress());
+  }
+  describe("forest", m_forestBuild.progress());
+  return status;
+}
+
 //------------------------------------------------------------------------------------------------------------------------
 
 void NGLScene::paintGL()
 {
+  FOREST_TRACE_ZONE("NGLScene::paintGL");
+  auto frameStart = std::chrono::steady_clock::now();
+  collectTimerQueries();
+  takeBuildResults();
+  GLuint timerQuery = 0;
+  if(!m_freeTimerQueries.empty())
+  {
+    timerQuery = m_freeTimerQueries.back();
+    m_freeTimerQueries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+  }
+  FrameStats::Frame &stats = m_frameStats.m_current;
+
   // clear the screen and depth buffer
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glViewport(0,0,m_win.width,m_win.height);
@@ -189,30 +421,30 @@ void NGLScene::paintGL()
     m_buildGridVAO = false;
   }
 
-  if(m_buildTreeVAO)
+  for(size_t i=0; i<m_buildTreeVAOs.size(); i++)
   {
-    buildVAO(m_treeVAOs[m_treeTabNum],
-             m_currentLSystem->m_vertices,
-             m_currentLSystem->m_indices,
-             GL_LINES, GL_UNSIGNED_SHORT);
-    m_buildTreeVAO = false;
+    if(m_buildTreeVAOs[i])
+    {
+      const LSystem::Geometry &geometry = m_LSystems[i].geometry();
+      buildVAO(m_treeVAOs[i], geometry.m_vertices, geometry.m_indices, GL_LINES, GL_UNSIGNED_SHORT);
+      m_buildTreeVAOs[i] = false;
+    }
   }
 
-  if(m_buildForestVAOs)
+  m_forestVAOs.resize(m_numTreeTabs);
+  for(size_t t=0; t<m_forest->m_treeTypes.size() && t<m_buildForestVAOs.size(); t++)
   {
-    m_forestVAOs.resize(m_numTreeTabs);
-    for(size_t t=0; t<m_forest.m_treeTypes.size(); t++)
+    if(m_buildForestVAOs[t])
     {
-      LSystem &treeType = m_forest.m_treeTypes[t];
-      CACHE_STRUCTURE(Instance) &instanceCache = treeType.m_instanceCache;
-      RESIZE_CACHE_BY_OTHER_CACHE(m_forestVAOs[t], instanceCache)
-      FOR_EACH_ELEMENT(m_forestVAOs[t],
-                       buildInstanceCacheVAO(m_forestVAOs[t][ID][AGE][INDEX],
-                                             treeType,
-                                             instanceCache[ID][AGE][INDEX],
-                                             m_forest.m_transformCache[t][ID][AGE][INDEX]))
+      buildInstanceCacheVAO(m_forestVAOs[t], m_forest->m_treeTypes[t], m_forest->m_transformCache[t]);
+      m_buildForestVAOs[t] = false;
     }
-    m_buildForestVAOs = false;
+    else if(m_uploadForestTransforms[t])
+    {
+      //the hero trees are the same, so only the transforms are uploaded again
+      setForestInstances(t, m_forest->m_transformCache[t]);
+    }
+    m_uploadForestTransforms[t] = false;
   }
 
   if(m_showGrid)
@@ -222,6 +454,8 @@ void NGLScene::paintGL()
     m_gridVAO->bind();
     m_gridVAO->draw();
     m_gridVAO->unbind();
+    stats.m_lines += m_grid.m_indices.size()/2;
+    stats.m_drawCalls++;
   }
 
   switch(m_superTabNum)
@@ -232,6 +466,8 @@ void NGLScene::paintGL()
       m_treeVAOs[m_treeTabNum]->bind();
       m_treeVAOs[m_treeTabNum]->draw();
       m_treeVAOs[m_treeTabNum]->unbind();
+      stats.m_lines += m_LSystems[m_treeTabNum].geometry().m_indices.size()/2;
+      stats.m_drawCalls++;
       break;
 
     case 1:
@@ -251,6 +487,9 @@ void NGLScene::paintGL()
       m_terrainVAO->bind();
       m_terrainVAO->draw();
       m_terrainVAO->unbind();
+      //the refined terrain is one triangle strip
+      stats.m_triangles += std::max(m_terrain.m_indicesToBeRendered.size(), size_t(2))-2;
+      stats.m_drawCalls++;
 
       /*(*shader)["TerrainShader"]->use();
       shader->setUniform("MVP",MVP);*/
@@ -316,17 +555,34 @@ void NGLScene::paintGL()
       m_terrainVAO->bind();
       m_terrainVAO->draw();
       m_terrainVAO->unbind();
+      //the refined terrain is one triangle strip
+      stats.m_triangles += std::max(m_terrain.m_indicesToBeRendered.size(), size_t(2))-2;
+      stats.m_drawCalls++;
 
 
       (*shader)["ForestShader"]->use();
       shader->setUniform("MVP",MVP);
 
+      if(m_cullForest)
+      {
+        cullForest(MVP);
+      }
+
       for(size_t t=0; t<m_numTreeTabs; t++)
       {
-        FOR_EACH_ELEMENT(m_forestVAOs[t],
-                          m_forestVAOs[t][ID][AGE][INDEX]->bind();
-                          m_forestVAOs[t][ID][AGE][INDEX]->draw();
-                          m_forestVAOs[t][ID][AGE][INDEX]->unbind())
+        if(m_forestVAOs[t])
+        {
+          m_forestVAOs[t]->bind();
+          m_forestVAOs[t]->draw();
+          m_forestVAOs[t]->unbind();
+          auto vao = static_cast<const ngl::InstanceCacheVAO *>(m_forestVAOs[t].get());
+          for(auto &command : vao->commands())
+          {
+            stats.m_lines += size_t(command.m_count/2)*command.m_instanceCount;
+            stats.m_instances += command.m_instanceCount;
+          }
+          stats.m_drawCalls += vao->numDrawCalls();
+        }
       }
       break;
     }
@@ -334,4 +590,16 @@ void NGLScene::paintGL()
     default:
       break;
   }
+
+  if(timerQuery != 0)
+  {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  std::chrono::duration<double,std::milli> cpuTime = std::chrono::steady_clock::now()-frameStart;
+  uint64_t frame = m_frameStats.endFrame(cpuTime.count(), timerQuery != 0);
+  if(timerQuery != 0)
+  {
+    m_pendingTimerQueries.push_back({timerQuery, frame});
+  }
+  emit frameStatsChanged(QString::fromStdString(m_frameStats.summary()+buildStatus()));
 }
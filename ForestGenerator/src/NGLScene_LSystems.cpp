@@ -9,6 +9,12 @@ void NGLScene::initializeLSystems()
 {
   m_LSystems.resize(m_numTreeTabs);
   m_treeVAOs.resize(m_numTreeTabs);
+  m_buildTreeVAOs.assign(m_numTreeTabs, false);
+  m_treeBuilds.resize(m_numTreeTabs);
+  for(auto &build : m_treeBuilds)
+  {
+    build.reset(new BackgroundBuild<std::shared_ptr<const LSystem::Geometry>>);
+  }
 
   std::string axiom;
   std::vector<std::string> rules;
@@ -41,10 +47,35 @@ void NGLScene::initializeLSystems()
 
 void NGLScene::updateForest()
 {
-  m_forest = Forest(m_LSystems, m_width,
-                    m_length, m_numTrees,
-                    m_numHeroTrees,
-                    m_terrainDimension);
+  //the worker builds from its own copy of the parameters, so the tabs can be edited while it runs
+  Forest forest;
+  forest.m_treeTypes = m_LSystems;
+  forest.m_width = m_width;
+  forest.m_length = m_length;
+  forest.m_numTrees = m_numTrees;
+  forest.m_numHeroTrees = m_numHeroTrees;
+  forest.m_scatterMode = m_scatterMode;
+  forest.m_cacheDirectory = m_instanceCacheDirectory;
+  forest.m_terrainGen = TerrainGenerator(m_terrainDimension, m_width);
 
-  m_buildForestVAOs = true;
+  //switching back to the forest tab without changing anything doesn't rebuild it
+  Forest::BuildKeys keys = forest.buildKeys();
+  if(keys == m_forestKeys)
+  {
+    return;
+  }
+  m_forestKeys = keys;
+
+  //the worker only reruns the stages and tree types whose parameters differ from the forest on screen, which it
+  //shares rather than copies - reuse() copies out just the parts it keeps
+  std::shared_ptr<const Forest> previous = m_forest;
+  m_forestBuild.start([forest = std::move(forest), previous](BuildProgress &_progress) mutable
+  {
+    forest.reuse(*previous);
+    forest.m_progress = &_progress;
+    forest.generate();
+    forest.m_progress = nullptr;
+    return std::move(forest);
+  });
+  m_buildTimer.start(m_buildPollInterval);
 }
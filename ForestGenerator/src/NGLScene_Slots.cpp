@@ -3,8 +3,10 @@
 /// @brief implementation file for NGLScene class slots
 //----------------------------------------------------------------------------------------------------------------------
 
+#include <iostream>
 #include <QGuiApplication>
 #include "NGLScene.h"
+#include "Trace.h"
 
 //------------------------------------------------------------------------------------------------------------------------
 ///PUBLIC SLOTS
@@ -18,6 +20,26 @@ void NGLScene::toggleGrid(int _clicked)
 
 //------------------------------------------------------------------------------------------------------------------------
 
+void NGLScene::setLODDistance(double _distance)
+{
+  m_forestLODDistance = float(_distance);
+  update();
+}
+
+void NGLScene::setThinningStart(double _distance)
+{
+  m_forestThinningStart = float(_distance);
+  update();
+}
+
+void NGLScene::setThinningEnd(double _distance)
+{
+  m_forestThinningEnd = float(_distance);
+  update();
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
 void NGLScene::changeSuperTab(int _superTabNum)
 {
   m_superTabNum = size_t(_superTabNum);
@@ -63,8 +85,17 @@ void NGLScene::generate()
   }
   m_currentLSystem->breakDownRules(currentRules);
   m_currentLSystem->seedRandomEngine();
-  m_currentLSystem->createGeometry();
-  m_buildTreeVAO = true;
+
+  //the geometry is grown on a copy by a worker, and only the new geometry is handed back, so the tab can be edited
+  //while it runs
+  LSystem treeType = *m_currentLSystem;
+  m_treeBuilds[m_treeTabNum]->start([treeType = std::move(treeType)](BuildProgress &_progress) mutable
+  {
+    _progress.set("tree", 0.0f);
+    treeType.createGeometry();
+    return treeType.m_geometry;
+  });
+  m_buildTimer.start(m_buildPollInterval);
   update();
 }
 
@@ -152,3 +183,58 @@ void NGLScene::setRule7(QString _rule)
 {
   m_currentLSystem->m_ruleArray[6]=_rule.toStdString();
 }
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::writeTrace()
+{
+  if(Trace::write(m_traceFile))
+  {
+    std::cout<<"wrote "<<Trace::numEvents()<<" trace events to "<<m_traceFile<<"\n";
+  }
+  else
+  {
+    std::cerr<<"WARNING: unable to write trace file "<<m_traceFile<<"\n";
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::toggleFrameLog()
+{
+  if(m_frameStats.logging())
+  {
+    m_frameStats.closeLog();
+    std::cout<<"stopped logging frames to "<<m_frameLogFile<<"\n";
+  }
+  else if(m_frameStats.openLog(m_frameLogFile))
+  {
+    std::cout<<"logging frames to "<<m_frameLogFile<<"\n";
+  }
+  else
+  {
+    std::cerr<<"WARNING: unable to open frame log "<<m_frameLogFile<<"\n";
+  }
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::printMemoryUsage()
+{
+  std::cout<<"memory usage:\n";
+  memoryUsage().print(std::cout);
+}
+
+//------------------------------------------------------------------------------------------------------------------------
+
+void NGLScene::cancelBuilds()
+{
+  for(auto &build : m_treeBuilds)
+  {
+    build->cancel();
+  }
+  m_forestBuild.cancel();
+  m_forestKeys = m_forest->m_builtKeys;
+  m_buildTimer.stop();
+  update();
+}
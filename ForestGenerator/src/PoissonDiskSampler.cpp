@@ -0,0 +1,184 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file PoissonDiskSampler.cpp
+/// @brief implementation file for PoissonDiskSampler class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "ParallelFor.h"
+#include "PoissonDiskSampler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float PoissonDiskSampler::radius(uint32_t _type, float _x, float _z) const
+{
+  float radius = m_radii[_type];
+  if(m_density)
+  {
+    float density = std::min(1.0f, std::max(m_density(_x,_z), std::max(m_minDensity, 1e-4f)));
+    radius /= std::sqrt(density);
+  }
+  return radius;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+std::vector<PoissonDiskSampler::Sample> PoissonDiskSampler::generate(float _minX, float _maxX,
+                                                                     float _minZ, float _maxZ) const
+{
+  if(m_radii.empty() || _maxX<=_minX || _maxZ<=_minZ)
+  {
+    return {};
+  }
+  float minRadius = *std::min_element(m_radii.begin(), m_radii.end());
+  float maxRadius = *std::max_element(m_radii.begin(), m_radii.end());
+  if(minRadius <= 0.0f)
+  {
+    return {};
+  }
+  if(m_density)
+  {
+    maxRadius /= std::sqrt(std::min(1.0f, std::max(m_minDensity, 1e-4f)));
+  }
+
+  //any two samples are at least minRadius apart, so a cell with a diagonal of minRadius holds at most one, and a
+  //candidate only has to look reach cells in each direction to find every sample it could be too close to
+  float cellSize = minRadius/std::sqrt(2.0f);
+  size_t numX = std::max(size_t(1), size_t(std::ceil((_maxX-_minX)/cellSize)));
+  size_t numZ = std::max(size_t(1), size_t(std::ceil((_maxZ-_minZ)/cellSize)));
+  size_t reach = size_t(std::ceil(maxRadius/cellSize));
+
+  //a tile reads the grid up to 2*reach cells outside itself - the samples that can grow into it, and their
+  //neighbours - so with tiles wider than that, tiles in the same pass never see each other's cells
+  size_t tileCells = std::max(size_t(std::ceil(m_tileSize/cellSize)), 2*reach+1);
+  size_t numTilesX = (numX+tileCells-1)/tileCells;
+  size_t numTilesZ = (numZ+tileCells-1)/tileCells;
+
+  //grid holds the index of the sample in each cell into the list of the tile the cell belongs to, or -1
+  std::vector<int32_t> grid(numX*numZ, -1);
+  std::vector<std::vector<Sample>> tileSamples(numTilesX*numTilesZ);
+  auto cellSample = [&](size_t _x, size_t _z) -> const Sample *
+  {
+    int32_t index = grid[_z*numX+_x];
+    if(index < 0)
+    {
+      return nullptr;
+    }
+    return &tileSamples[(_z/tileCells)*numTilesX + _x/tileCells][size_t(index)];
+  };
+
+  auto fillTile = [&](size_t _tile)
+  {
+    RandomStream stream(m_seed, _tile, m_streamId);
+    size_t x0 = (_tile%numTilesX)*tileCells;
+    size_t z0 = (_tile/numTilesX)*tileCells;
+    size_t x1 = std::min(numX, x0+tileCells);
+    size_t z1 = std::min(numZ, z0+tileCells);
+    std::vector<Sample> &samples = tileSamples[_tile];
+    std::vector<Sample> active;
+
+    auto tryAdd = [&](float _x, float _z, uint32_t _type)
+    {
+      if(_x<_minX || _x>_maxX || _z<_minZ || _z>_maxZ)
+      {
+        return false;
+      }
+      size_t cx = std::min(numX-1, size_t((_x-_minX)/cellSize));
+      size_t cz = std::min(numZ-1, size_t((_z-_minZ)/cellSize));
+      if(cx<x0 || cx>=x1 || cz<z0 || cz>=z1 || grid[cz*numX+cx]>=0)
+      {
+        return false;
+      }
+      float r = radius(_type, _x, _z);
+      for(size_t z=cz-std::min(cz,reach); z<=std::min(numZ-1,cz+reach); z++)
+      {
+        for(size_t x=cx-std::min(cx,reach); x<=std::min(numX-1,cx+reach); x++)
+        {
+          const Sample * neighbour = cellSample(x,z);
+          if(neighbour)
+          {
+            float minDistance = 0.5f*(r+neighbour->m_radius);
+            float dx = neighbour->m_x-_x;
+            float dz = neighbour->m_z-_z;
+            if(dx*dx+dz*dz < minDistance*minDistance)
+            {
+              return false;
+            }
+          }
+        }
+      }
+      grid[cz*numX+cx] = int32_t(samples.size());
+      samples.push_back({_x, _z, r, _type});
+      active.push_back(samples.back());
+      return true;
+    };
+
+    //samples that tiles from earlier passes placed near this one carry on growing into it, which stitches the
+    //tiles together; only a tile with none of those needs a random starting point
+    for(size_t z=z0-std::min(z0,2*reach); z<std::min(numZ,z1+2*reach); z++)
+    {
+      for(size_t x=x0-std::min(x0,2*reach); x<std::min(numX,x1+2*reach); x++)
+      {
+        const Sample * neighbour = (x>=x0 && x<x1 && z>=z0 && z<z1) ? nullptr : cellSample(x,z);
+        if(neighbour)
+        {
+          active.push_back(*neighbour);
+        }
+      }
+    }
+    if(active.empty())
+    {
+      float tileMaxX = std::min(_maxX, _minX+float(x1)*cellSize);
+      float tileMaxZ = std::min(_maxZ, _minZ+float(z1)*cellSize);
+      for(size_t k=0; k<m_numCandidates; k++)
+      {
+        float x = stream.uniform(_minX+float(x0)*cellSize, tileMaxX);
+        float z = stream.uniform(_minZ+float(z0)*cellSize, tileMaxZ);
+        if(tryAdd(x, z, uint32_t(stream.index(m_radii.size()))))
+        {
+          break;
+        }
+      }
+    }
+
+    while(!active.empty())
+    {
+      size_t j = stream.index(active.size());
+      Sample parent = active[j];
+      bool found = false;
+      for(size_t k=0; k<m_numCandidates && !found; k++)
+      {
+        uint32_t type = uint32_t(stream.index(m_radii.size()));
+        float minDistance = 0.5f*(parent.m_radius + radius(type, parent.m_x, parent.m_z));
+        float distance = stream.uniform(minDistance, 2.0f*minDistance);
+        float angle = stream.uniform(0.0f, 2.0f*float(M_PI));
+        found = tryAdd(parent.m_x+distance*std::cos(angle), parent.m_z+distance*std::sin(angle), type);
+      }
+      if(!found)
+      {
+        active[j] = active.back();
+        active.pop_back();
+      }
+    }
+  };
+
+  for(size_t pass=0; pass<4; pass++)
+  {
+    std::vector<size_t> tiles;
+    for(size_t t=0; t<tileSamples.size(); t++)
+    {
+      if((t%numTilesX)%2 + 2*((t/numTilesX)%2) == pass)
+      {
+        tiles.push_back(t);
+      }
+    }
+    parallelFor(tiles.size(), numWorkerThreads(m_numThreads), [&](size_t _i){ fillTile(tiles[_i]); });
+  }
+
+  std::vector<Sample> result;
+  for(auto &samples : tileSamples)
+  {
+    result.insert(result.end(), samples.begin(), samples.end());
+  }
+  return result;
+}
@@ -139,29 +139,18 @@ void print(std::vector<ngl::Vec3> _vec)
   }
 }
 
-void printIndices(std::vector<std::vector<std::vector<Instance>>> &_instanceCache)
+void printIndices(InstanceCache<Instance> &_instanceCache)
 {
-  for(auto &row : _instanceCache)
+  for(auto &instance : _instanceCache)
   {
-    for(auto &col : row)
-    {
-      for(auto &instance : col)
-      {
-        //print(instance.m_indices);
-      }
-    }
+    print(float(instance.m_instanceStart), " - ", float(instance.m_instanceEnd));
+    newLine();
   }
 }
-void printTransform(std::vector<std::vector<std::vector<Instance>>> &_instanceCache)
+void printTransform(InstanceCache<Instance> &_instanceCache)
 {
-  for(auto &row : _instanceCache)
+  for(auto &instance : _instanceCache)
   {
-    for(auto &col : row)
-    {
-      for(auto &instance : col)
-      {
-        print(instance.m_transform);
-      }
-    }
+    print(instance.m_transform);
   }
 }
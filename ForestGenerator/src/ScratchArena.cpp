@@ -0,0 +1,107 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ScratchArena.cpp
+/// @brief implementation file for ScratchArena class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <stdexcept>
+#include "ScratchArena.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ScratchArena::ScratchArena(size_t _initialSize) :
+  m_size(_initialSize), m_upstream(new CountingResource) {}
+
+ScratchArena::ScratchArena(const ScratchArena &_other) :
+  ScratchArena(_other.m_size) {}
+
+ScratchArena &ScratchArena::operator=(const ScratchArena &_other)
+{
+  if(m_depth != 0)
+  {
+    throw std::logic_error("ScratchArena assigned to while a Scope is open");
+  }
+  if(this != &_other)
+  {
+    m_size = _other.m_size;
+    m_arena.reset();
+    m_buffer = {};
+  }
+  return *this;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ScratchArena::Scope::Scope(ScratchArena &_arena) :
+  m_arena(_arena)
+{
+  if(m_arena.m_depth++ == 0 && !m_arena.m_arena)
+  {
+    m_arena.rebuild();
+  }
+}
+
+ScratchArena::Scope::~Scope()
+{
+  m_arena.m_depth--;
+  if(m_arena.m_depth == 0)
+  {
+    m_arena.reset();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+std::pmr::memory_resource * ScratchArena::resource()
+{
+  return m_arena.get();
+}
+
+void ScratchArena::reset()
+{
+  //if the last generation spilled onto the heap, grow the buffer so the next one doesn't have to
+  if(m_upstream->m_bytes > 0)
+  {
+    m_size = m_buffer.size() + m_upstream->m_bytes;
+    rebuild();
+  }
+  else
+  {
+    m_arena->release();
+  }
+}
+
+size_t ScratchArena::capacity() const
+{
+  return m_buffer.size();
+}
+
+size_t ScratchArena::overflow() const
+{
+  return m_upstream->m_bytes;
+}
+
+void ScratchArena::rebuild()
+{
+  m_arena.reset();
+  m_buffer.resize(m_size);
+  m_upstream->m_bytes = 0;
+  m_arena.reset(new std::pmr::monotonic_buffer_resource(m_buffer.data(), m_buffer.size(), m_upstream.get()));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void * ScratchArena::CountingResource::do_allocate(size_t _bytes, size_t _alignment)
+{
+  m_bytes += _bytes;
+  return std::pmr::new_delete_resource()->allocate(_bytes, _alignment);
+}
+
+void ScratchArena::CountingResource::do_deallocate(void *_p, size_t _bytes, size_t _alignment)
+{
+  std::pmr::new_delete_resource()->deallocate(_p, _bytes, _alignment);
+}
+
+bool ScratchArena::CountingResource::do_is_equal(const std::pmr::memory_resource &_other) const noexcept
+{
+  return this == &_other;
+}
@@ -0,0 +1,115 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpatialGrid.cpp
+/// @brief implementation file for SpatialGrid class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include "SpatialGrid.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SpatialGrid::build(const std::vector<ngl::Vec3> &_centres, const std::vector<float> &_radii, float _cellSize)
+{
+  m_centres = _centres;
+  m_radii = _radii;
+  m_maxRadius = m_radii.empty() ? 0.0f : *std::max_element(m_radii.begin(), m_radii.end());
+  m_cellSize = _cellSize > 0.0f ? _cellSize : 1.0f;
+  m_cells = {};
+  m_items = {};
+  m_numX = 0;
+  m_numZ = 0;
+  if(m_centres.empty())
+  {
+    return;
+  }
+
+  float minX = m_centres[0].m_x;
+  float maxX = minX;
+  float minZ = m_centres[0].m_z;
+  float maxZ = minZ;
+  for(auto &centre : m_centres)
+  {
+    minX = std::min(minX, centre.m_x);
+    maxX = std::max(maxX, centre.m_x);
+    minZ = std::min(minZ, centre.m_z);
+    maxZ = std::max(maxZ, centre.m_z);
+  }
+  m_originX = minX;
+  m_originZ = minZ;
+  m_numX = size_t((maxX-minX)/m_cellSize)+1;
+  m_numZ = size_t((maxZ-minZ)/m_cellSize)+1;
+  m_cells.resize(m_numX*m_numZ);
+
+  //counting sort of the spheres by cell
+  std::vector<uint32_t> cellOf(m_centres.size());
+  for(size_t i=0; i<m_centres.size(); i++)
+  {
+    size_t x = std::min(m_numX-1, size_t((m_centres[i].m_x-m_originX)/m_cellSize));
+    size_t z = std::min(m_numZ-1, size_t((m_centres[i].m_z-m_originZ)/m_cellSize));
+    cellOf[i] = uint32_t(z*m_numX+x);
+    m_cells[cellOf[i]].m_count++;
+  }
+  uint32_t start = 0;
+  for(auto &cell : m_cells)
+  {
+    cell.m_start = start;
+    start += cell.m_count;
+    cell.m_count = 0;
+  }
+  m_items.resize(m_centres.size());
+  for(size_t i=0; i<m_centres.size(); i++)
+  {
+    Cell &cell = m_cells[cellOf[i]];
+    ngl::Vec3 r(m_radii[i], m_radii[i], m_radii[i]);
+    ngl::Vec3 low = m_centres[i]-r;
+    ngl::Vec3 high = m_centres[i]+r;
+    if(cell.m_count == 0)
+    {
+      cell.m_min = low;
+      cell.m_max = high;
+    }
+    else
+    {
+      cell.m_min = ngl::Vec3(std::min(cell.m_min.m_x, low.m_x), std::min(cell.m_min.m_y, low.m_y),
+                             std::min(cell.m_min.m_z, low.m_z));
+      cell.m_max = ngl::Vec3(std::max(cell.m_max.m_x, high.m_x), std::max(cell.m_max.m_y, high.m_y),
+                             std::max(cell.m_max.m_z, high.m_z));
+    }
+    m_items[cell.m_start + cell.m_count++] = uint32_t(i);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SpatialGrid::query(const Frustum &_frustum, std::vector<uint32_t> &_visible, float _margin) const
+{
+  ngl::Vec3 margin(_margin, _margin, _margin);
+  for(auto &cell : m_cells)
+  {
+    if(cell.m_count == 0)
+    {
+      continue;
+    }
+    Frustum::Result result = _frustum.classifyBox(cell.m_min-margin, cell.m_max+margin);
+    if(result == Frustum::OUTSIDE)
+    {
+      continue;
+    }
+    const uint32_t * items = m_items.data()+cell.m_start;
+    if(result == Frustum::INSIDE)
+    {
+      _visible.insert(_visible.end(), items, items+cell.m_count);
+    }
+    else
+    {
+      for(uint32_t i=0; i<cell.m_count; i++)
+      {
+        if(_frustum.sphereVisible(m_centres[items[i]], m_radii[items[i]]+_margin))
+        {
+          _visible.push_back(items[i]);
+        }
+      }
+    }
+  }
+}
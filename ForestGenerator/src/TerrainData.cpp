@@ -7,6 +7,7 @@
 #include <cmath>
 #include <algorithm>
 #include "TerrainData.h"
+#include "Trace.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 ///CONSTRUCTOR FUNCTION
@@ -88,6 +89,7 @@ float TerrainData::Vertex::distanceTo(Vertex v) const
 
 void TerrainData::meshRefine(ngl::Vec3 _cameraPos, float _tolerance, float _lambda)
 {
+  FOREST_TRACE_ZONE("TerrainData::meshRefine");
   m_indices = {};
   m_parity = 0;
   m_indices.push_back(0);
@@ -100,10 +102,35 @@ void TerrainData::meshRefine(ngl::Vec3 _cameraPos, float _tolerance, float _lamb
   tstripAppend(3,0);
   submeshRefine(4,5,1, _cameraPos, _tolerance, _lambda);
   m_indices.push_back(0);
+  //the refined mesh is a triangle strip, so every index after the first two adds a triangle
+  FOREST_TRACE_COUNTER("triangles refined", m_indices.size()-2);
 
   fillVerticesAndIndicesForRendering();
 }
 
+MemoryReport TerrainData::memoryUsage() const
+{
+  MemoryReport report;
+  report.add("height map", MemoryReport::bytes(m_heightMap));
+  report.add("vertices", MemoryReport::bytes(m_vertices));
+  size_t childLists = 0;
+  for(auto &vertex : m_vertices)
+  {
+    childLists += MemoryReport::bytes(vertex.childList);
+  }
+  report.add("child lists", childLists);
+  size_t graphLevels = MemoryReport::bytes(m_verticesArrangedByGraphLevel);
+  for(auto &level : m_verticesArrangedByGraphLevel)
+  {
+    graphLevels += MemoryReport::bytes(level);
+  }
+  report.add("vertices by graph level", graphLevels);
+  report.add("refined indices", MemoryReport::bytes(m_indices));
+  report.add("render vertices", MemoryReport::bytes(m_vertsToBeRendered));
+  report.add("render indices", MemoryReport::bytes(m_indicesToBeRendered));
+  return report;
+}
+
 void TerrainData::fillVerticesAndIndicesForRendering()
 {
   m_vertsToBeRendered = {};
@@ -118,6 +145,11 @@ void TerrainData::fillVerticesAndIndicesForRendering()
   }
 }
 
+Heightmap TerrainData::heightmap() const
+{
+  return Heightmap(m_heightMap, m_dimension, m_scale);
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 ///PUBLIC MEMBER FUNCTIONS: BASIC
 //----------------------------------------------------------------------------------------------------------------------
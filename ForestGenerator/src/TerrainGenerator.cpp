@@ -28,6 +28,18 @@ void TerrainGenerator::generate()
 }
 
 
+Heightmap TerrainGenerator::heightmap() const
+{
+  return Heightmap(m_heightMap, m_dimension, m_scale);
+}
+
+MemoryReport TerrainGenerator::memoryUsage() const
+{
+  MemoryReport report;
+  report.add("height map", MemoryReport::bytes(m_heightMap));
+  return report;
+}
+
 double TerrainGenerator::getSceneX(const int _index) const
 {
   return ((_index%m_dimension)-m_dimension/2)*double(m_scale);
@@ -0,0 +1,276 @@
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Trace.cpp
+/// @brief implementation file for Trace class
+//----------------------------------------------------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Trace.h"
+
+namespace
+{
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief a zone ('X', with a duration) or a counter value ('C')
+  //--------------------------------------------------------------------------------------------------------------------
+  struct Event
+  {
+    const char * m_name;
+    char m_type;
+    int64_t m_start;
+    int64_t m_duration;
+    double m_value;
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief the ring buffer one thread records into. Only its owner writes to it, so its mutex is only contended
+  /// while the trace is being written out or cleared
+  //--------------------------------------------------------------------------------------------------------------------
+  struct ThreadBuffer
+  {
+    void push(const Event &_event)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_events.size() < m_capacity)
+      {
+        m_events.push_back(_event);
+      }
+      else if(m_capacity > 0)
+      {
+        m_events[m_next] = _event;
+        m_next = (m_next+1) % m_capacity;
+      }
+    }
+
+    std::mutex m_mutex;
+    std::vector<Event> m_events;
+    //--------------------------------------------------------------------------------------------------------------------
+    /// @brief where the next event goes once the buffer is full, which is also where the oldest one is
+    //--------------------------------------------------------------------------------------------------------------------
+    size_t m_next = 0;
+    size_t m_capacity = 0;
+    uint32_t m_threadId = 0;
+    bool m_inUse = false;
+  };
+
+  struct Registry
+  {
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    size_t m_eventsPerThread = 1<<16;
+    std::atomic<bool> m_enabled{true};
+    std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
+  };
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief never destroyed, so that threads which finish while the program exits can still give back their buffers
+  //--------------------------------------------------------------------------------------------------------------------
+  Registry &registry()
+  {
+    static Registry * registry = new Registry;
+    return *registry;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief each thread's hold on its buffer, which is returned to the registry for reuse when the thread finishes
+  //--------------------------------------------------------------------------------------------------------------------
+  struct BufferHandle
+  {
+    ~BufferHandle()
+    {
+      if(m_buffer)
+      {
+        std::lock_guard<std::mutex> lock(registry().m_mutex);
+        m_buffer->m_inUse = false;
+      }
+    }
+
+    ThreadBuffer * m_buffer = nullptr;
+  };
+
+  thread_local BufferHandle t_handle;
+
+  ThreadBuffer &threadBuffer()
+  {
+    if(!t_handle.m_buffer)
+    {
+      Registry &r = registry();
+      std::lock_guard<std::mutex> lock(r.m_mutex);
+      for(auto &buffer : r.m_buffers)
+      {
+        if(!buffer->m_inUse)
+        {
+          t_handle.m_buffer = buffer.get();
+          break;
+        }
+      }
+      if(!t_handle.m_buffer)
+      {
+        r.m_buffers.emplace_back(new ThreadBuffer);
+        t_handle.m_buffer = r.m_buffers.back().get();
+        t_handle.m_buffer->m_threadId = uint32_t(r.m_buffers.size());
+        t_handle.m_buffer->m_capacity = r.m_eventsPerThread;
+      }
+      t_handle.m_buffer->m_inUse = true;
+    }
+    return *t_handle.m_buffer;
+  }
+
+  //--------------------------------------------------------------------------------------------------------------------
+  /// @brief writes _name as a JSON string
+  //--------------------------------------------------------------------------------------------------------------------
+  void writeString(std::ostream &_out, const char * _name)
+  {
+    _out<<'"';
+    for(const char * c = _name; *c; c++)
+    {
+      if(*c=='"' || *c=='\\')
+      {
+        _out<<'\\';
+      }
+      _out<<*c;
+    }
+    _out<<'"';
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Trace::Scope::Scope(const char * _name) :
+  m_name(_name), m_start(enabled() ? now() : -1) {}
+
+Trace::Scope::~Scope()
+{
+  if(m_start >= 0)
+  {
+    zone(m_name, m_start, now());
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Trace::setEnabled(bool _enabled)
+{
+  registry().m_enabled.store(_enabled, std::memory_order_relaxed);
+}
+
+bool Trace::enabled()
+{
+  return registry().m_enabled.load(std::memory_order_relaxed);
+}
+
+int64_t Trace::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now()-registry().m_epoch).count();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Trace::zone(const char * _name, int64_t _start, int64_t _end)
+{
+  if(enabled())
+  {
+    threadBuffer().push({_name, 'X', _start, _end-_start, 0.0});
+  }
+}
+
+void Trace::counter(const char * _name, double _value)
+{
+  if(enabled())
+  {
+    threadBuffer().push({_name, 'C', now(), 0, _value});
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Trace::setEventsPerThread(size_t _numEvents)
+{
+  std::lock_guard<std::mutex> lock(registry().m_mutex);
+  registry().m_eventsPerThread = _numEvents;
+}
+
+size_t Trace::numEvents()
+{
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.m_mutex);
+  size_t result = 0;
+  for(auto &buffer : r.m_buffers)
+  {
+    std::lock_guard<std::mutex> bufferLock(buffer->m_mutex);
+    result += buffer->m_events.size();
+  }
+  return result;
+}
+
+void Trace::clear()
+{
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.m_mutex);
+  for(auto &buffer : r.m_buffers)
+  {
+    std::lock_guard<std::mutex> bufferLock(buffer->m_mutex);
+    buffer->m_events = {};
+    buffer->m_next = 0;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Trace::write(std::ostream &_out)
+{
+  Registry &r = registry();
+  std::lock_guard<std::mutex> lock(r.m_mutex);
+  std::ios::fmtflags flags = _out.flags();
+  _out<<std::fixed<<std::setprecision(3);
+  _out<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for(auto &buffer : r.m_buffers)
+  {
+    std::lock_guard<std::mutex> bufferLock(buffer->m_mutex);
+    const std::vector<Event> &events = buffer->m_events;
+    if(events.empty())
+    {
+      continue;
+    }
+    _out<<(first ? "\n" : ",\n");
+    first = false;
+    _out<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<buffer->m_threadId
+        <<",\"args\":{\"name\":\"thread "<<buffer->m_threadId<<"\"}}";
+    for(size_t i=0; i<events.size(); i++)
+    {
+      //once the ring buffer has wrapped the oldest event is at m_next
+      const Event &event = events[(buffer->m_next+i) % events.size()];
+      _out<<",\n{\"name\":";
+      writeString(_out, event.m_name);
+      _out<<",\"ph\":\""<<event.m_type<<"\",\"pid\":1,\"tid\":"<<buffer->m_threadId
+          <<",\"ts\":"<<double(event.m_start)/1000.0;
+      if(event.m_type=='X')
+      {
+        _out<<",\"dur\":"<<double(event.m_duration)/1000.0<<'}';
+      }
+      else
+      {
+        _out<<",\"args\":{\"value\":"<<event.m_value<<"}}";
+      }
+    }
+  }
+  _out<<"\n]}\n";
+  _out.flags(flags);
+}
+
+bool Trace::write(const std::string &_path)
+{
+  std::ofstream file(_path);
+  if(!file)
+  {
+    return false;
+  }
+  write(file);
+  return bool(file);
+}
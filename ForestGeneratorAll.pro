@@ -1,3 +1,12 @@
 TEMPLATE = subdirs
-SUBDIRS += ForestGenerator/ForestGenerator.pro
-SUBDIRS += Tests/Tests.pro
+SUBDIRS += core gui cli tests benchmarks
+
+core.file = ForestCore/ForestCore.pro
+gui.file = ForestGenerator/ForestGenerator.pro
+gui.depends = core
+cli.file = ForestCLI/ForestCLI.pro
+cli.depends = core
+tests.file = Tests/Tests.pro
+tests.depends = core
+benchmarks.file = Benchmarks/Benchmarks.pro
+benchmarks.depends = core
@@ -2,17 +2,16 @@ win32: include(gtest_dependency.pri)
 unix: LIBS+=-L/public/devel/lib -L/usr/local/lib -lgtest
 
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++17
 CONFIG -= app_bundle
 CONFIG += thread
 CONFIG -= qt
 
-INCLUDEPATH += ../ForestGenerator/include/
 SOURCES += main.cpp \
-            ../ForestGenerator/src/LSystem.cpp \
-            ../ForestGenerator/src/LSystem_CreateGeometry.cpp \
-            ../ForestGenerator/src/LSystem_InstanceMethods.cpp \
-            ../ForestGenerator/src/Instance.cpp
+            ../ForestGenerator/src/FrameStats.cpp
+
+# the tests cover the whole core library, Forest included, so they link it like the other front ends
+include($$PWD/../ForestCore/UseForestCore.pri)
 
 NGLPATH=$$(NGLDIR)
 isEmpty(NGLPATH){ # note brace must be here
@@ -1,5 +1,22 @@
 #include <gtest/gtest.h>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include "LSystem.h"
+#include "MemoryReport.h"
+#include "BackgroundBuild.h"
+#include "DensityMap.h"
+#include "ForestTileReader.h"
+#include "Forest.h"
+#include "FrameStats.h"
+#include "Heightmap.h"
+#include "InstanceCacheFile.h"
+#include "ParallelFor.h"
+#include "PoissonDiskSampler.h"
+#include "SpatialGrid.h"
+#include "Trace.h"
 
 
 int main(int argc, char *argv[])
@@ -68,20 +85,21 @@ TEST(LSystem, createGeometry)
   std::vector<std::string> rules = {"A=![B]////[B]////B", "B=FFFA"};
   LSystem L(axiom,rules,2,0.9f,30,0.9f,0);
   L.createGeometry();
+  const LSystem::Geometry &geometry = L.geometry();
 
-  EXPECT_EQ(L.m_vertices.size(),4);
-  EXPECT_EQ(L.m_vertices[0],ngl::Vec3(0,0,0));
-  EXPECT_EQ(L.m_vertices[1],ngl::Vec3(0,2,0));
-  EXPECT_EQ(L.m_vertices[2],ngl::Vec3(0,4,0));
-  EXPECT_EQ(L.m_vertices[3],ngl::Vec3(0,6,0));
+  EXPECT_EQ(geometry.m_vertices.size(),4);
+  EXPECT_EQ(geometry.m_vertices[0],ngl::Vec3(0,0,0));
+  EXPECT_EQ(geometry.m_vertices[1],ngl::Vec3(0,2,0));
+  EXPECT_EQ(geometry.m_vertices[2],ngl::Vec3(0,4,0));
+  EXPECT_EQ(geometry.m_vertices[3],ngl::Vec3(0,6,0));
 
-  EXPECT_EQ(L.m_indices.size(),6);
-  EXPECT_EQ(L.m_indices[0],0);
-  EXPECT_EQ(L.m_indices[1],1);
-  EXPECT_EQ(L.m_indices[2],1);
-  EXPECT_EQ(L.m_indices[3],2);
-  EXPECT_EQ(L.m_indices[4],2);
-  EXPECT_EQ(L.m_indices[5],3);
+  EXPECT_EQ(geometry.m_indices.size(),6);
+  EXPECT_EQ(geometry.m_indices[0],0);
+  EXPECT_EQ(geometry.m_indices[1],1);
+  EXPECT_EQ(geometry.m_indices[2],1);
+  EXPECT_EQ(geometry.m_indices[3],2);
+  EXPECT_EQ(geometry.m_indices[4],2);
+  EXPECT_EQ(geometry.m_indices[5],3);
 }
 
 TEST(LSystem, addInstancingCommands)
@@ -139,3 +157,1133 @@ TEST(LSystem, addInstancingCommands_nestedBranches)
   EXPECT_EQ(L.m_branches[2],"B");
   EXPECT_EQ(L.m_branches[3],"C[FFF]");
 }
+
+TEST(LSystem, generateTreeString_stochastic)
+{
+  std::string axiom = "A";
+  std::vector<std::string> rules = {"A=F[A]#:1", "A=FA#:1"};
+  LSystem L(axiom,rules,2,0.9f,30,0.9f,5);
+  L.m_useSeed = true;
+  L.m_seed = 7;
+
+  //the same seed should always give the same string, however many times the scratch arena has been reused
+  L.seedRandomEngine();
+  std::string treeString = L.generateTreeString();
+  for(int i=0; i<3; i++)
+  {
+    L.seedRandomEngine();
+    EXPECT_EQ(L.generateTreeString(),treeString);
+  }
+  EXPECT_EQ(std::count(treeString.begin(),treeString.end(),'F'),5);
+  EXPECT_EQ(std::count(treeString.begin(),treeString.end(),'5'),1);
+}
+
+TEST(ScratchArena, growsAfterOverflow)
+{
+  ScratchArena arena(64);
+  {
+    ScratchArena::Scope scope(arena);
+    std::pmr::string big(1000,'x',arena.resource());
+    EXPECT_GT(arena.overflow(),0);
+  }
+  //closing the outermost scope resets the arena and grows it to fit what was needed
+  EXPECT_GE(arena.capacity(),1000);
+  EXPECT_EQ(arena.overflow(),0);
+  {
+    ScratchArena::Scope scope(arena);
+    std::pmr::string big(1000,'x',arena.resource());
+    EXPECT_EQ(arena.overflow(),0);
+  }
+}
+
+TEST(ScratchArena, copiesAllocateOnFirstUse)
+{
+  ScratchArena arena(4096);
+  {
+    ScratchArena::Scope scope(arena);
+  }
+  ScratchArena copy = arena;
+  EXPECT_EQ(copy.capacity(),0);
+  {
+    ScratchArena::Scope scope(copy);
+    EXPECT_EQ(copy.capacity(),4096);
+    //the buffer can't be swapped out from under a Scope
+    EXPECT_THROW(copy = arena, std::logic_error);
+    EXPECT_EQ(copy.capacity(),4096);
+  }
+  copy = arena;
+  EXPECT_EQ(copy.capacity(),0);
+}
+
+TEST(LSystem, findBranches)
+{
+  std::string axiom = "FFFA";
+  std::vector<std::string> rules = {"A=F[B[F]]//[F]][A[", "B=F"};
+  LSystem L(axiom,rules,2,0.9f,30,0.9f,4);
+
+  EXPECT_TRUE(L.isNonTerminal('A'));
+  EXPECT_TRUE(L.isNonTerminal('B'));
+  EXPECT_FALSE(L.isNonTerminal('F'));
+
+  //[F] contains no non-terminal, the stray ] is ignored and the final [ and the [ before A are never closed
+  std::pmr::vector<LSystem::Branch> branches;
+  L.findBranches(L.m_rules[0].m_RHS[0], branches);
+  ASSERT_EQ(branches.size(),1);
+  EXPECT_EQ(branches[0].m_open,1);
+  EXPECT_EQ(branches[0].m_close,6);
+  EXPECT_EQ(L.m_rules[0].m_numBranches,std::vector<int>({1}));
+}
+
+TEST(RandomStream, counterBased)
+{
+  RandomStream a(42, 1, 2);
+  RandomStream b(42, 1, 2);
+  RandomStream c(42, 2, 1);
+
+  //the same key always gives the same sequence, and any draw can be computed directly from its counter
+  std::vector<uint64_t> sequence;
+  for(uint64_t i=0; i<10; i++)
+  {
+    sequence.push_back(a());
+  }
+  for(uint64_t i=10; i>0; i--)
+  {
+    EXPECT_EQ(b.at(i-1),sequence[i-1]);
+  }
+  EXPECT_NE(c.at(0),sequence[0]);
+
+  for(int i=0; i<1000; i++)
+  {
+    float u = a.uniform();
+    EXPECT_GE(u,0.0f);
+    EXPECT_LT(u,1.0f);
+    EXPECT_LT(a.index(7),7);
+  }
+}
+
+TEST(LSystem, heroTreesIndependent)
+{
+  std::string axiom = "A";
+  std::vector<std::string> rules = {"A=F[A]A:1", "A=FA:1"};
+  LSystem L(axiom,rules,2,0.9f,30,0.9f,6);
+  L.m_useSeed = true;
+  L.m_seed = 3;
+  L.seedRandomEngine();
+
+  //tree strings only depend on (seed, tree index), not on how many draws were made before them
+  L.m_treeIndex = 1;
+  std::string tree1 = L.generateTreeString();
+  L.m_treeIndex = 0;
+  std::string tree0 = L.generateTreeString();
+  L.m_treeIndex = 1;
+  EXPECT_EQ(L.generateTreeString(),tree1);
+  EXPECT_NE(tree0,tree1);
+}
+
+TEST(InstanceCache, flatStorage)
+{
+  InstanceCache<int> cache;
+  cache.resize(2,3);
+  EXPECT_EQ(cache.size(),0);
+  EXPECT_EQ(cache.push_back(1,2,10),0);
+  EXPECT_EQ(cache.push_back(0,1,20),0);
+  EXPECT_EQ(cache.push_back(1,2,11),1);
+  EXPECT_EQ(cache.push_back(0,1,21),1);
+  //elements can be read by (id, age, index) while they're being added
+  EXPECT_EQ(cache.size(),4);
+  EXPECT_EQ(cache.size(1,2),2);
+  EXPECT_EQ(cache.at(0,1,1),21);
+  cache.finalize();
+
+  //elements are stored in (id, age, index) order whatever order they were added in
+  std::vector<int> flat(cache.begin(),cache.end());
+  EXPECT_EQ(flat,std::vector<int>({20,21,10,11}));
+  EXPECT_EQ(cache.size(0,1),2);
+  EXPECT_EQ(cache.size(1,0),0);
+  EXPECT_EQ(cache.at(1,2,1),11);
+  EXPECT_THROW(cache.at(1,0,0),std::out_of_range);
+  EXPECT_THROW(cache.size(2,0),std::out_of_range);
+  //elements added after a finalize() go behind the ones already in their slot
+  EXPECT_EQ(cache.push_back(0,1,22),2);
+  EXPECT_EQ(cache.push_back(0,0,30),0);
+  EXPECT_EQ(cache.at(0,1,2),22);
+  cache.finalize();
+  EXPECT_EQ(std::vector<int>(cache.begin(),cache.end()),std::vector<int>({30,20,21,22,10,11}));
+  EXPECT_EQ(cache.offsets(),std::vector<size_t>({0,1,4,4,4,4,6}));
+
+  //a cache of move-only elements can take the same shape, and flat indices line up
+  InstanceCache<std::unique_ptr<int>> other;
+  other.resizeLike(cache);
+  EXPECT_EQ(other.size(),cache.size());
+  EXPECT_EQ(other.offset(1,2),4);
+  for(size_t k=0; k<cache.size(); k++)
+  {
+    other[k].reset(new int(cache[k]));
+  }
+  EXPECT_EQ(*other.at(0,1,2),22);
+}
+
+TEST(LSystem, exitPointRuns)
+{
+  std::string axiom = "FA";
+  std::vector<std::string> rules = {"A=F[&A]/[^A]A:1", "A=F&[//A]A:2"};
+  LSystem L(axiom,rules,4,0.9f,30,0.9f,6);
+  L.m_useSeed = true;
+  L.m_seed = 5;
+  L.fillInstanceCache(3);
+  const LSystem::HeroTrees &heroTrees = L.heroTrees();
+
+  //each instance's exit points are a separate contiguous run of m_exitPoints, and together they cover all of it
+  std::vector<size_t> owner(heroTrees.m_exitPoints.size(), heroTrees.m_instanceCache.size());
+  for(size_t k=0; k<heroTrees.m_instanceCache.size(); k++)
+  {
+    const Instance &instance = heroTrees.m_instanceCache[k];
+    ASSERT_LE(instance.m_exitPointStart+instance.m_numExitPoints, heroTrees.m_exitPoints.size());
+    for(uint32_t e=instance.m_exitPointStart; e<instance.m_exitPointStart+instance.m_numExitPoints; e++)
+    {
+      EXPECT_EQ(owner[e], heroTrees.m_instanceCache.size());
+      owner[e] = k;
+      EXPECT_LT(heroTrees.m_exitPoints[e].m_exitId, heroTrees.m_instanceCache.numIds());
+      EXPECT_LT(heroTrees.m_exitPoints[e].m_exitAge, heroTrees.m_instanceCache.numAges());
+    }
+  }
+  EXPECT_GT(heroTrees.m_exitPoints.size(), 0);
+  EXPECT_EQ(std::count(owner.begin(), owner.end(), heroTrees.m_instanceCache.size()), 0);
+}
+
+TEST(LSystem, copiesShareGeneratedData)
+{
+  std::string axiom = "FA";
+  std::vector<std::string> rules = {"A=F[&A]/[^A]A:1", "A=F&[//A]A:2"};
+  LSystem L(axiom,rules,4,0.9f,30,0.9f,4);
+  L.m_useSeed = true;
+  L.m_seed = 5;
+  LSystem copy = L;
+  EXPECT_EQ(copy.m_geometry,L.m_geometry);
+
+  //regenerating makes new data, leaving copies with what they had
+  const LSystem::Geometry * geometry = L.m_geometry.get();
+  copy.m_stepSize = 8;
+  copy.createGeometry();
+  EXPECT_EQ(L.m_geometry.get(),geometry);
+  EXPECT_NE(copy.geometry().m_vertices,L.geometry().m_vertices);
+
+  L.fillInstanceCache(2);
+  EXPECT_GT(L.heroTrees().m_instanceCache.size(),0);
+  EXPECT_EQ(copy.heroTrees().m_instanceCache.size(),0);
+  LSystem grown = L;
+  EXPECT_EQ(grown.m_heroTrees,L.m_heroTrees);
+}
+
+TEST(InstanceCacheFile, roundTrip)
+{
+  std::string axiom = "FA";
+  std::vector<std::string> rules = {"A=F[&A]/[^A]A:1", "A=F&[//A]A:2"};
+  LSystem L(axiom,rules,4,0.9f,30,0.9f,6);
+  L.m_useSeed = true;
+  L.m_seed = 5;
+  LSystem loaded = L;
+  uint64_t key = InstanceCacheFile::key(L,3);
+  L.m_seed = 6;
+  EXPECT_NE(InstanceCacheFile::key(L,3),key);
+  L.m_seed = 5;
+  EXPECT_NE(InstanceCacheFile::key(L,4),key);
+  L.fillInstanceCache(3);
+
+  std::string path = InstanceCacheFile::path((std::filesystem::temp_directory_path()/"instanceCacheTest").string(),key);
+  ASSERT_TRUE(InstanceCacheFile::write(path,key,L));
+  InstanceCacheFile file;
+  EXPECT_FALSE(file.open(path,key+1));
+  ASSERT_TRUE(file.open(path,key));
+  ASSERT_TRUE(file.read(loaded));
+  file.close();
+  std::filesystem::remove(path);
+
+  const LSystem::HeroTrees &expected = L.heroTrees();
+  const LSystem::HeroTrees &actual = loaded.heroTrees();
+  EXPECT_EQ(actual.m_vertices.size(),expected.m_vertices.size());
+  for(size_t i=0; i<expected.m_vertices.size(); i++)
+  {
+    EXPECT_EQ(actual.m_vertices[i],expected.m_vertices[i]);
+  }
+  EXPECT_EQ(actual.m_indices,expected.m_indices);
+  EXPECT_EQ(actual.m_instanceCache.offsets(),expected.m_instanceCache.offsets());
+  for(size_t k=0; k<expected.m_instanceCache.size(); k++)
+  {
+    EXPECT_EQ(actual.m_instanceCache[k].m_transform,expected.m_instanceCache[k].m_transform);
+    EXPECT_EQ(actual.m_instanceCache[k].m_instanceStart,expected.m_instanceCache[k].m_instanceStart);
+    EXPECT_EQ(actual.m_instanceCache[k].m_instanceEnd,expected.m_instanceCache[k].m_instanceEnd);
+    EXPECT_EQ(actual.m_instanceCache[k].m_numExitPoints,expected.m_instanceCache[k].m_numExitPoints);
+  }
+  ASSERT_EQ(actual.m_exitPoints.size(),expected.m_exitPoints.size());
+  for(size_t e=0; e<expected.m_exitPoints.size(); e++)
+  {
+    EXPECT_EQ(actual.m_exitPoints[e].m_exitId,expected.m_exitPoints[e].m_exitId);
+    EXPECT_EQ(actual.m_exitPoints[e].m_exitTransform.toMat4(),expected.m_exitPoints[e].m_exitTransform.toMat4());
+  }
+}
+
+TEST(InstanceCacheFile, rejectsCorruptFiles)
+{
+  LSystem L("FA",{"A=F[&A]/[^A]A:1", "A=F&[//A]A:2"},4,0.9f,30,0.9f,6);
+  L.m_useSeed = true;
+  L.m_seed = 5;
+  LSystem loaded = L;
+  uint64_t key = InstanceCacheFile::key(L,3);
+  L.fillInstanceCache(3);
+  std::string path = InstanceCacheFile::path((std::filesystem::temp_directory_path()/"instanceCacheCorrupt").string(),key);
+  ASSERT_TRUE(InstanceCacheFile::write(path,key,L));
+
+  //overwrites the bytes at _offset of the file, then checks it's refused and loaded is untouched
+  auto expectRejected = [&](size_t _offset, const void *_bytes, size_t _size)
+  {
+    std::vector<char> original(_size);
+    {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekg(std::streamoff(_offset));
+      file.read(original.data(), std::streamsize(_size));
+      file.seekp(std::streamoff(_offset));
+      file.write(static_cast<const char *>(_bytes), std::streamsize(_size));
+    }
+    InstanceCacheFile file;
+    ASSERT_TRUE(file.open(path,key));
+    EXPECT_FALSE(file.read(loaded));
+    EXPECT_EQ(loaded.m_heroTrees,nullptr);
+    file.close();
+    std::fstream restore(path, std::ios::binary | std::ios::in | std::ios::out);
+    restore.seekp(std::streamoff(_offset));
+    restore.write(original.data(), std::streamsize(_size));
+  };
+
+  InstanceCacheFile file;
+  ASSERT_TRUE(file.open(path,key));
+  InstanceCacheFile::Header header = file.header();
+  file.close();
+  size_t indices = (sizeof(InstanceCacheFile::Header)+15)/16*16 + (header.m_numVertices*sizeof(ngl::Vec3)+15)/16*16;
+  size_t offsets = indices + (header.m_numIndices*sizeof(int16_t)+15)/16*16;
+  size_t instances = offsets + ((header.m_numIds*header.m_numAges+1)*sizeof(uint64_t)+15)/16*16;
+  size_t exitPoints = instances + (header.m_numInstances*sizeof(InstanceCacheFile::InstanceRecord)+15)/16*16;
+  ASSERT_GT(header.m_numExitPoints,0u);
+
+  //an index past the last vertex
+  int16_t index = int16_t(header.m_numVertices);
+  expectRejected(indices+sizeof(int16_t),&index,sizeof(index));
+  //an instance whose range of indices ends past the last index
+  uint64_t end = header.m_numIndices+1;
+  expectRejected(instances+offsetof(InstanceCacheFile::InstanceRecord,m_instanceEnd),&end,sizeof(end));
+  //an instance whose range of indices starts after it ends
+  uint64_t start = header.m_numIndices+1;
+  expectRejected(instances+offsetof(InstanceCacheFile::InstanceRecord,m_instanceStart),&start,sizeof(start));
+  //exit points to an id or an age the instance cache has no slot for
+  uint32_t id = uint32_t(header.m_numIds);
+  expectRejected(exitPoints+offsetof(Instance::ExitPoint,m_exitId),&id,sizeof(id));
+  uint32_t age = uint32_t(header.m_numAges);
+  expectRejected(exitPoints+offsetof(Instance::ExitPoint,m_exitAge),&age,sizeof(age));
+
+  ASSERT_TRUE(file.open(path,key));
+  EXPECT_TRUE(file.read(loaded));
+  file.close();
+  std::filesystem::remove(path);
+}
+
+TEST(ForestTileWriter, streamAndSeek)
+{
+  //tiles are queued faster than they're written, so writeTile() has to wait on the writer thread
+  std::string path = (std::filesystem::temp_directory_path()/"forestTilesTest.fgtiles").string();
+  ForestTileWriter writer;
+  writer.m_maxQueuedTiles = 1;
+  ASSERT_TRUE(writer.open(path,10.0f));
+  std::vector<ForestTileWriter::Tile> tiles;
+  for(int32_t t=0; t<6; t++)
+  {
+    ForestTileWriter::Tile tile;
+    tile.m_x = t-3;
+    tile.m_z = 2*t;
+    for(uint32_t i=0; i<uint32_t(100*t); i++)
+    {
+      tile.m_treeTypes.push_back(i%2);
+      tile.m_prototypes.push_back(i%7);
+      ngl::Mat4 m;
+      m.m_m[3][0] = float(i);
+      m.m_m[3][2] = float(t);
+      tile.m_transforms.push_back(m);
+    }
+    tiles.push_back(tile);
+    writer.writeTile(tile);
+  }
+  ASSERT_TRUE(writer.close());
+  EXPECT_EQ(ForestTileWriter::tileCoordinate(-0.5f,10.0f),-1);
+  EXPECT_EQ(ForestTileWriter::tileCoordinate(19.5f,10.0f),1);
+
+  ForestTileReader reader;
+  ASSERT_TRUE(reader.open(path));
+  EXPECT_EQ(reader.tiles().size(),tiles.size());
+  EXPECT_EQ(reader.header().m_numInstances,1500);
+  EXPECT_EQ(reader.findTile(0,0),reader.tiles().size());
+  //read the tiles back out of order, each by seeking to it
+  for(size_t t=tiles.size(); t-->0;)
+  {
+    size_t index = reader.findTile(tiles[t].m_x,tiles[t].m_z);
+    ASSERT_LT(index,reader.tiles().size());
+    ForestTileWriter::Tile tile;
+    ASSERT_TRUE(reader.readTile(index,tile));
+    EXPECT_EQ(tile.m_treeTypes,tiles[t].m_treeTypes);
+    EXPECT_EQ(tile.m_prototypes,tiles[t].m_prototypes);
+    ASSERT_EQ(tile.m_transforms.size(),tiles[t].m_transforms.size());
+    for(size_t i=0; i<tile.m_transforms.size(); i++)
+    {
+      EXPECT_EQ(tile.m_transforms[i].toMat4(),tiles[t].m_transforms[i].toMat4());
+    }
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(ForestTileWriter, failsFast)
+{
+  //a writer that isn't open never takes a tile, rather than waiting for a thread that isn't there
+  ForestTileWriter closed;
+  closed.m_maxQueuedTiles = 1;
+  EXPECT_FALSE(closed.writeTile(ForestTileWriter::Tile()));
+  EXPECT_FALSE(closed.writeTile(ForestTileWriter::Tile()));
+
+  //once a tile fails to write, the writer thread stops and later tiles are turned away instead of filling the queue
+  std::string path = (std::filesystem::temp_directory_path()/"forestTilesFailTest.fgtiles").string();
+  ForestTileWriter writer;
+  writer.m_maxQueuedTiles = 1;
+  ASSERT_TRUE(writer.open(path,10.0f));
+  ForestTileWriter::Tile bad;
+  bad.m_treeTypes = {0,1};
+  bad.m_transforms.resize(1);
+  EXPECT_TRUE(writer.writeTile(bad));
+  bool refused = false;
+  for(int t=0; t<1000 && !refused; t++)
+  {
+    refused = !writer.writeTile(ForestTileWriter::Tile());
+  }
+  EXPECT_TRUE(refused);
+  EXPECT_FALSE(writer.close());
+  EXPECT_FALSE(writer.error().empty());
+  std::filesystem::remove(path);
+}
+
+TEST(AffineTransform, multiplyBatch)
+{
+  ngl::Mat4 root;
+  root.rotateY(30.0f);
+  root.m_30 = 1.0f;
+  root.m_31 = -2.0f;
+  root.m_32 = 0.5f;
+
+  std::vector<AffineTransform> in;
+  for(int i=0; i<5; i++)
+  {
+    ngl::Mat4 m;
+    m.euler(float(20*i), 1.0f, float(i), 0.5f);
+    m.m_30 = float(i);
+    m.m_31 = 2.0f*i;
+    in.push_back(m);
+  }
+
+  //the batched multiply agrees with ngl's own operator*
+  std::vector<AffineTransform> out(in.size());
+  multiplyBatch(root, in.data(), in.size(), out.data());
+  for(size_t i=0; i<in.size(); i++)
+  {
+    ngl::Mat4 expected = root * in[i].toMat4();
+    ngl::Mat4 result = out[i].toMat4();
+    for(int j=0; j<16; j++)
+    {
+      EXPECT_NEAR(result.m_openGL[j], expected.m_openGL[j], 1e-5f);
+    }
+  }
+}
+
+TEST(ParallelFor, coversEveryIndexOnce)
+{
+  for(size_t threads : {size_t(1), size_t(3), size_t(8)})
+  {
+    std::vector<int> hits(100, 0);
+    parallelFor(hits.size(), threads, [&](size_t _i){ hits[_i]++; });
+    EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), 100);
+  }
+}
+
+TEST(BackgroundBuild, newestJobWins)
+{
+  BackgroundBuild<int> build;
+  //the first job only finishes once it's cancelled, which starting the second does
+  std::atomic<bool> firstStarted(false);
+  build.start([&](BuildProgress &_progress)
+  {
+    firstStarted = true;
+    while(!_progress.cancelled())
+    {
+      std::this_thread::yield();
+    }
+    return 1;
+  });
+  while(!firstStarted)
+  {
+    std::this_thread::yield();
+  }
+  build.start([](BuildProgress &_progress)
+  {
+    _progress.set("second", 0.5f);
+    return 2;
+  });
+
+  std::unique_ptr<int> result;
+  while(!result)
+  {
+    result = build.take();
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(*result, 2);
+  EXPECT_FALSE(build.take());
+  EXPECT_STREQ(build.progress()->stage(), "second");
+
+  //a cancelled job's result is thrown away, even though the job goes on to return one. The job's own progress says
+  //when its worker has finished, as the build forgets it on cancel()
+  std::atomic<BuildProgress *> third(nullptr);
+  build.start([&](BuildProgress &_progress)
+  {
+    third = &_progress;
+    while(!_progress.cancelled())
+    {
+      std::this_thread::yield();
+    }
+    return 3;
+  });
+  while(!third)
+  {
+    std::this_thread::yield();
+  }
+  build.cancel();
+  EXPECT_FALSE(build.running());
+  while(!third.load()->finished())
+  {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(build.take());
+  EXPECT_FALSE(third.load()->failed());
+
+  //a job that throws publishes nothing and reports what it threw
+  build.start([](BuildProgress &) -> int { throw std::runtime_error("out of trees"); });
+  while(build.running())
+  {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(build.take());
+  ASSERT_TRUE(build.progress());
+  EXPECT_TRUE(build.progress()->failed());
+  EXPECT_EQ(build.progress()->error(), "out of trees");
+}
+
+TEST(SpatialGrid, frustumQuery)
+{
+  //with the identity as MVP the frustum is the cube [-1,1]^3
+  Frustum frustum((ngl::Mat4()));
+  EXPECT_TRUE(frustum.sphereVisible(ngl::Vec3(0,0,0),0.1f));
+  EXPECT_TRUE(frustum.sphereVisible(ngl::Vec3(1.5f,0,0),0.6f));
+  EXPECT_FALSE(frustum.sphereVisible(ngl::Vec3(1.5f,0,0),0.4f));
+  EXPECT_EQ(frustum.classifyBox(ngl::Vec3(-0.5f,-0.5f,-0.5f),ngl::Vec3(0.5f,0.5f,0.5f)),Frustum::INSIDE);
+  EXPECT_EQ(frustum.classifyBox(ngl::Vec3(0.5f,-0.5f,-0.5f),ngl::Vec3(1.5f,0.5f,0.5f)),Frustum::INTERSECTS);
+  EXPECT_EQ(frustum.classifyBox(ngl::Vec3(1.5f,-0.5f,-0.5f),ngl::Vec3(2.5f,0.5f,0.5f)),Frustum::OUTSIDE);
+
+  //the grid finds exactly the spheres that a test of every sphere would
+  std::vector<ngl::Vec3> centres;
+  std::vector<float> radii;
+  RandomStream stream(1);
+  for(int i=0; i<500; i++)
+  {
+    centres.push_back(ngl::Vec3(stream.uniform(-4,4),stream.uniform(-0.5f,0.5f),stream.uniform(-4,4)));
+    radii.push_back(stream.uniform(0.0f,0.3f));
+  }
+  SpatialGrid grid;
+  grid.build(centres,radii,0.7f);
+  std::vector<uint32_t> visible;
+  grid.query(frustum,visible);
+  std::sort(visible.begin(),visible.end());
+  std::vector<uint32_t> expected;
+  for(uint32_t i=0; i<centres.size(); i++)
+  {
+    if(frustum.sphereVisible(centres[i],radii[i]))
+    {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(visible,expected);
+  EXPECT_LT(visible.size(),centres.size());
+}
+
+TEST(PoissonDiskSampler, spacingAndTiling)
+{
+  PoissonDiskSampler sampler;
+  sampler.m_radii = {2.0f, 3.0f};
+  sampler.m_tileSize = 15.0f;
+  sampler.m_seed = 5;
+  sampler.m_numThreads = 1;
+  std::vector<PoissonDiskSampler::Sample> samples = sampler.generate(-50,50,-40,40);
+  ASSERT_GT(samples.size(), 300u);
+
+  //no two samples are closer than the mean of their radii, including across tile borders
+  for(size_t i=0; i<samples.size(); i++)
+  {
+    EXPECT_EQ(samples[i].m_radius, sampler.m_radii[samples[i].m_type]);
+    for(size_t j=i+1; j<samples.size(); j++)
+    {
+      float dx = samples[i].m_x-samples[j].m_x;
+      float dz = samples[i].m_z-samples[j].m_z;
+      float minDistance = 0.5f*(samples[i].m_radius+samples[j].m_radius);
+      EXPECT_GE(dx*dx+dz*dz, minDistance*minDistance*0.9999f);
+    }
+  }
+
+  //the area is covered - every point is within twice the largest radius of a sample
+  for(float x=-50; x<=50; x+=2.5f)
+  {
+    for(float z=-40; z<=40; z+=2.5f)
+    {
+      float closest = 1e9f;
+      for(auto &sample : samples)
+      {
+        closest = std::min(closest, (sample.m_x-x)*(sample.m_x-x) + (sample.m_z-z)*(sample.m_z-z));
+      }
+      EXPECT_LT(closest, 36.0f);
+    }
+  }
+
+  //the result doesn't depend on the number of threads
+  sampler.m_numThreads = 4;
+  std::vector<PoissonDiskSampler::Sample> threaded = sampler.generate(-50,50,-40,40);
+  ASSERT_EQ(threaded.size(), samples.size());
+  for(size_t i=0; i<samples.size(); i++)
+  {
+    EXPECT_EQ(threaded[i].m_x, samples[i].m_x);
+    EXPECT_EQ(threaded[i].m_z, samples[i].m_z);
+    EXPECT_EQ(threaded[i].m_type, samples[i].m_type);
+  }
+}
+
+TEST(DensityMap, aliasSampling)
+{
+  //cells are drawn in proportion to their weights, and never when the weight is 0
+  DensityMap map;
+  map.resize(4,2,0,8,0,2);
+  std::vector<float> weights = {0,1,2,1, 3,0,0,1};
+  map.m_values = weights;
+  map.buildSampler();
+  EXPECT_EQ(map.m_total, 8.0);
+
+  RandomStream stream(3);
+  std::vector<size_t> counts(weights.size(), 0);
+  const size_t numSamples = 80000;
+  for(size_t i=0; i<numSamples; i++)
+  {
+    float x, z;
+    ASSERT_TRUE(map.sample(stream,x,z));
+    EXPECT_TRUE(x>=0.0f && x<8.0f && z>=0.0f && z<2.0f);
+    counts[map.cellIndex(x,z)]++;
+  }
+  for(size_t i=0; i<weights.size(); i++)
+  {
+    EXPECT_NEAR(double(counts[i])/numSamples, weights[i]/8.0, 0.01);
+  }
+  EXPECT_EQ(counts[0], 0u);
+
+  //a map with no weight can't be sampled
+  map.m_values.assign(8, 0.0f);
+  map.buildSampler();
+  float x = 0, z = 0;
+  EXPECT_FALSE(map.sample(stream,x,z));
+
+  PreferenceCurve slope = {0.0f, 20.0f, 10.0f};
+  EXPECT_EQ(slope.evaluate(10.0f), 1.0f);
+  EXPECT_FLOAT_EQ(slope.evaluate(25.0f), 0.5f);
+  EXPECT_EQ(slope.evaluate(40.0f), 0.0f);
+  EXPECT_EQ(PreferenceCurve().evaluate(-1000.0f), 1.0f);
+}
+
+TEST(FrameStats, gpuTimesArriveLate)
+{
+  std::string path = (std::filesystem::temp_directory_path()/"frameStatsTest.csv").string();
+  FrameStats stats;
+  ASSERT_TRUE(stats.openLog(path));
+
+  stats.m_current.m_triangles = 100;
+  stats.m_current.m_drawCalls = 2;
+  uint64_t first = stats.endFrame(4.0, true);
+  stats.m_current.m_triangles = 300;
+  stats.m_current.m_drawCalls = 4;
+  uint64_t second = stats.endFrame(8.0, true);
+  //frames waiting on the GPU aren't finished yet
+  EXPECT_EQ(stats.average().m_cpuTime, 0.0);
+
+  //the first frame's query was lost, so it finishes without a GPU time when the second's arrives
+  stats.setGPUTime(second, 2.0);
+  stats.endFrame(6.0, false);
+  EXPECT_EQ(first, 0u);
+  FrameStats::Frame mean = stats.average();
+  EXPECT_DOUBLE_EQ(mean.m_cpuTime, 6.0);
+  EXPECT_DOUBLE_EQ(mean.m_gpuTime, 2.0);
+  EXPECT_EQ(mean.m_triangles, 133u);
+  EXPECT_EQ(mean.m_drawCalls, 2u);
+  EXPECT_EQ(mean.m_index, 2u);
+
+  //only the most recent m_historySize frames are averaged
+  stats.m_historySize = 1;
+  stats.endFrame(1.0, false);
+  EXPECT_DOUBLE_EQ(stats.average().m_cpuTime, 1.0);
+  EXPECT_LT(stats.average().m_gpuTime, 0.0);
+
+  stats.closeLog();
+  std::ifstream log(path);
+  std::vector<std::string> lines;
+  for(std::string line; std::getline(log, line); )
+  {
+    lines.push_back(line);
+  }
+  ASSERT_EQ(lines.size(), 5u);
+  EXPECT_EQ(lines[0], "frame,cpu_ms,gpu_ms,triangles,lines,instances,draw_calls,uploaded_bytes");
+  EXPECT_EQ(lines[1], "0,4,,100,0,0,2,0");
+  EXPECT_EQ(lines[2], "1,8,2,300,0,0,4,0");
+  std::filesystem::remove(path);
+}
+
+TEST(MemoryReport, LSystemFootprint)
+{
+  LSystem L("FFFA", {"A=![B]////[B]////B", "B=FFFA"}, 2, 0.9f, 30, 0.9f, 4);
+  MemoryReport before = L.memoryUsage();
+  L.fillInstanceCache(4);
+  MemoryReport after = L.memoryUsage();
+  ASSERT_EQ(before.m_entries.size(), after.m_entries.size());
+  auto bytes = [](const MemoryReport &_report, const std::string &_name)
+  {
+    for(auto &entry : _report.m_entries)
+    {
+      if(entry.m_name == _name)
+      {
+        return entry.m_bytes;
+      }
+    }
+    return size_t(0);
+  };
+  EXPECT_GE(bytes(after, "hero vertices"), L.heroTrees().m_vertices.size()*sizeof(ngl::Vec3));
+  EXPECT_GE(bytes(after, "hero indices"), L.heroTrees().m_indices.size()*sizeof(GLshort));
+  EXPECT_GT(bytes(after, "instance cache"), bytes(before, "instance cache"));
+  EXPECT_GT(after.total(), before.total());
+
+  //nested reports are prefixed, and the total covers every entry
+  MemoryReport forest;
+  forest.add("tree data", 1000);
+  forest.add("species 0", after);
+  EXPECT_EQ(forest.m_entries.size(), after.m_entries.size()+1);
+  EXPECT_EQ(forest.m_entries[1].m_name, "species 0/"+after.m_entries[0].m_name);
+  EXPECT_EQ(forest.total(), after.total()+1000);
+
+  std::ostringstream out;
+  forest.print(out);
+  EXPECT_NE(out.str().find("species 0/hero vertices"), std::string::npos);
+  EXPECT_NE(out.str().find("total"), std::string::npos);
+}
+
+TEST(Heightmap, bilinearQueries)
+{
+  //a plane h = 0.5x + 0.25z sampled on a 9x9 grid with spacing 2, centred on the origin
+  const int dimension = 9;
+  const float scale = 2.0f;
+  std::vector<float> values;
+  for(int i=0; i<dimension*dimension; i++)
+  {
+    float x = float(i%dimension - dimension/2)*scale;
+    float z = float(i/dimension - dimension/2)*scale;
+    values.push_back(0.5f*x + 0.25f*z);
+  }
+  Heightmap heightmap(values, dimension, scale);
+
+  //bilinear interpolation reproduces the plane exactly, between samples as well as on them
+  EXPECT_FLOAT_EQ(heightmap.height(0.0f, 0.0f), 0.0f);
+  EXPECT_FLOAT_EQ(heightmap.height(3.3f, -1.7f), 0.5f*3.3f - 0.25f*1.7f);
+  EXPECT_FLOAT_EQ(heightmap.height(8.0f, 8.0f), 6.0f);
+  //and clamps to the edge outside the map
+  EXPECT_FLOAT_EQ(heightmap.height(100.0f, 0.0f), 4.0f);
+
+  ngl::Vec3 normal = heightmap.normal(1.0f, 1.0f);
+  ngl::Vec3 expected(-0.5f, 1.0f, -0.25f);
+  expected.normalize();
+  EXPECT_NEAR(normal.m_x, expected.m_x, 1e-5f);
+  EXPECT_NEAR(normal.m_y, expected.m_y, 1e-5f);
+  EXPECT_NEAR(normal.m_z, expected.m_z, 1e-5f);
+  EXPECT_NEAR(heightmap.slope(-3.0f, 5.0f), std::atan(std::sqrt(0.3125f))*180.0f/float(M_PI), 1e-3f);
+
+  //the batch query gives the same heights as single queries
+  std::vector<float> xs = {-9.0f, -2.5f, 0.1f, 7.9f};
+  std::vector<float> zs = {1.0f, 6.5f, -8.0f, 3.3f};
+  std::vector<float> heights(xs.size());
+  heightmap.heights(xs.data(), zs.data(), xs.size(), heights.data());
+  for(size_t i=0; i<xs.size(); i++)
+  {
+    EXPECT_FLOAT_EQ(heights[i], heightmap.height(xs[i], zs[i]));
+  }
+
+  //a map without heights is flat
+  EXPECT_EQ(Heightmap().height(1.0f, 2.0f), 0.0f);
+  EXPECT_EQ(Heightmap().slope(1.0f, 2.0f), 0.0f);
+}
+
+TEST(Trace, zonesFromEveryThread)
+{
+  Trace::clear();
+  Trace::setEnabled(true);
+  {
+    Trace::Scope scope("outer");
+    //the calling thread records before the workers start, so it takes a buffer that no worker can be handed
+    Trace::counter("start", 0.0);
+    parallelFor(4, 4, [](size_t _i)
+    {
+      Trace::Scope inner("inner");
+      Trace::counter("index", double(_i));
+    });
+  }
+  EXPECT_EQ(Trace::numEvents(), 10u);
+
+  //nothing is recorded while tracing is turned off
+  Trace::setEnabled(false);
+  {
+    Trace::Scope scope("ignored");
+  }
+  Trace::setEnabled(true);
+  EXPECT_EQ(Trace::numEvents(), 10u);
+
+  std::ostringstream out;
+  Trace::write(out);
+  std::string json = out.str();
+  EXPECT_EQ(json.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+  EXPECT_NE(json.find("\"name\":\"outer\",\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"index\",\"ph\":\"C\""), std::string::npos);
+  EXPECT_EQ(json.find("ignored"), std::string::npos);
+  auto count = [&json](const std::string &_text)
+  {
+    size_t n = 0;
+    for(size_t pos = json.find(_text); pos != std::string::npos; pos = json.find(_text, pos+1))
+    {
+      n++;
+    }
+    return n;
+  };
+  EXPECT_EQ(count("\"name\":\"inner\",\"ph\":\"X\""), 4u);
+  EXPECT_EQ(count("\"name\":\"index\",\"ph\":\"C\""), 4u);
+  //one track per buffer that recorded something. The calling thread has held its buffer since it recorded "start",
+  //and the worker threads may have handed theirs on to each other as they finished
+  size_t numThreads = count("thread_name");
+  EXPECT_GE(numThreads, 2u);
+  EXPECT_LE(numThreads, 4u);
+
+  Trace::clear();
+  EXPECT_EQ(Trace::numEvents(), 0u);
+}
+
+//--------------------------------------------------------------------------------------------------------------------
+/// @brief a small seeded forest with one tree type per entry of _angles, which only differ by their branching angle
+//--------------------------------------------------------------------------------------------------------------------
+static Forest testForest(const std::vector<float> &_angles)
+{
+  Forest forest;
+  for(float angle : _angles)
+  {
+    LSystem treeType("FFFA",{"A=\"[B]////[B]////B","B=&FFFA"},2,0.9f,20,0.9f,3);
+    treeType.m_angle = angle;
+    treeType.m_useSeed = true;
+    forest.m_treeTypes.push_back(treeType);
+  }
+  forest.m_width = 300.0f;
+  forest.m_length = 300.0f;
+  forest.m_numTrees = 2000;
+  forest.m_numHeroTrees = 2;
+  forest.m_terrainGen = TerrainGenerator(64,300.0f);
+  forest.m_useSeed = true;
+  forest.m_seed = 7;
+  return forest;
+}
+
+static void expectSameTransforms(const std::vector<Forest::TransformCache> &_actual,
+                                 const std::vector<Forest::TransformCache> &_expected)
+{
+  ASSERT_EQ(_actual.size(),_expected.size());
+  for(size_t t=0; t<_expected.size(); t++)
+  {
+    EXPECT_EQ(_actual[t].m_offsets,_expected[t].m_offsets);
+    ASSERT_EQ(_actual[t].m_transforms.size(),_expected[t].m_transforms.size());
+    EXPECT_EQ(std::memcmp(_actual[t].m_transforms.data(),_expected[t].m_transforms.data(),
+                          _expected[t].m_transforms.size()*sizeof(AffineTransform)),0);
+  }
+}
+
+TEST(Forest, reuseMatchesFreshBuild)
+{
+  Forest previous = testForest({20.0f,25.0f});
+  previous.generate();
+
+  //only the second tree type's rules change, so it's the only one regrown and rebaked
+  Forest forest = testForest({20.0f,30.0f});
+  forest.reuse(previous);
+  forest.generate();
+  EXPECT_EQ(forest.m_changedTreeTypes,std::vector<bool>({false,true}));
+  EXPECT_EQ(forest.m_regrownTreeTypes,std::vector<bool>({false,true}));
+  std::vector<std::string> stages;
+  for(auto &stage : forest.m_stageTimes)
+  {
+    stages.push_back(stage.first);
+  }
+  EXPECT_EQ(stages,std::vector<std::string>({"instance caches","forest"}));
+
+  Forest fresh = testForest({20.0f,30.0f});
+  fresh.generate();
+  ASSERT_EQ(forest.m_treeData.size(),fresh.m_treeData.size());
+  for(size_t i=0; i<fresh.m_treeData.size(); i++)
+  {
+    EXPECT_EQ(forest.m_treeData[i].m_type,fresh.m_treeData[i].m_type);
+    EXPECT_EQ(forest.m_treeData[i].m_transform.toMat4(),fresh.m_treeData[i].m_transform.toMat4());
+    EXPECT_EQ(forest.m_treeData[i].m_importance,fresh.m_treeData[i].m_importance);
+  }
+  ASSERT_EQ(forest.m_prototypes.size(),fresh.m_prototypes.size());
+  for(size_t t=0; t<fresh.m_prototypes.size(); t++)
+  {
+    ASSERT_EQ(forest.m_prototypes[t].size(),fresh.m_prototypes[t].size());
+    for(size_t p=0; p<fresh.m_prototypes[t].size(); p++)
+    {
+      const Forest::Prototype &actual = forest.m_prototypes[t][p];
+      const Forest::Prototype &expected = fresh.m_prototypes[t][p];
+      EXPECT_EQ(actual.m_slots,expected.m_slots);
+      EXPECT_EQ(actual.m_ages,expected.m_ages);
+      ASSERT_EQ(actual.m_transforms.size(),expected.m_transforms.size());
+      EXPECT_EQ(std::memcmp(actual.m_transforms.data(),expected.m_transforms.data(),
+                            expected.m_transforms.size()*sizeof(AffineTransform)),0);
+    }
+  }
+  EXPECT_EQ(forest.m_treePrototypes,fresh.m_treePrototypes);
+  expectSameTransforms(forest.m_transformCache,fresh.m_transformCache);
+}
+
+TEST(Forest, unchangedKeysSkipEveryStage)
+{
+  Forest previous = testForest({20.0f,25.0f});
+  previous.generate();
+
+  Forest forest = testForest({20.0f,25.0f});
+  EXPECT_EQ(forest.buildKeys(),previous.m_builtKeys);
+  forest.reuse(previous);
+  EXPECT_TRUE(forest.generate());
+  EXPECT_TRUE(forest.m_stageTimes.empty());
+  EXPECT_EQ(forest.m_changedTreeTypes,std::vector<bool>({false,false}));
+  expectSameTransforms(forest.m_transformCache,previous.m_transformCache);
+}
+
+TEST(Forest, rescatterKeepsPrototypes)
+{
+  Forest previous = testForest({20.0f,25.0f});
+  previous.generate();
+  //mark a prototype, so it can be told apart from a freshly baked one
+  previous.m_prototypes[1][0].m_radius = 1000.0f;
+
+  //a new tree count moves every tree, but the prototypes don't depend on where the trees stand
+  Forest forest = testForest({20.0f,25.0f});
+  forest.m_numTrees = 1500;
+  forest.reuse(previous);
+  EXPECT_EQ(forest.buildKeys().m_prototypes,previous.m_builtKeys.m_prototypes);
+  forest.generate();
+  std::vector<std::string> stages;
+  for(auto &stage : forest.m_stageTimes)
+  {
+    stages.push_back(stage.first);
+  }
+  EXPECT_EQ(stages,std::vector<std::string>({"scatter","forest"}));
+  EXPECT_EQ(forest.m_changedTreeTypes,std::vector<bool>({true,true}));
+  EXPECT_EQ(forest.m_regrownTreeTypes,std::vector<bool>({false,false}));
+  EXPECT_EQ(forest.m_prototypes[1][0].m_radius,1000.0f);
+  EXPECT_EQ(forest.m_treeData.size(),1500u);
+
+  Forest fresh = testForest({20.0f,25.0f});
+  fresh.m_numTrees = 1500;
+  fresh.generate();
+  EXPECT_EQ(forest.m_treePrototypes,fresh.m_treePrototypes);
+  expectSameTransforms(forest.m_transformCache,fresh.m_transformCache);
+}
+
+TEST(Forest, treesStandOnTheTerrain)
+{
+  Forest forest = testForest({20.0f});
+  forest.generate();
+  Heightmap heightmap = forest.m_terrainGen.heightmap();
+  ASSERT_EQ(forest.m_treeData.size(),2000u);
+  for(const Forest::Tree &tree : forest.m_treeData)
+  {
+    //the root of the tree is drawn where its translation puts it, on the ground and inside the forest
+    ngl::Vec3 root = tree.m_transform.transformPoint(ngl::Vec3(0.0f,0.0f,0.0f));
+    EXPECT_EQ(root.m_x,tree.m_transform.m_m[3][0]);
+    EXPECT_EQ(root.m_y,tree.m_transform.m_m[3][1]);
+    EXPECT_EQ(root.m_z,tree.m_transform.m_m[3][2]);
+    EXPECT_LE(std::abs(root.m_x),forest.m_width*0.5f);
+    EXPECT_LE(std::abs(root.m_z),forest.m_length*0.5f);
+    EXPECT_NEAR(root.m_y,heightmap.height(root.m_x,root.m_z),1e-3f);
+    //and the scale is all in the basis
+    ngl::Vec3 up(tree.m_transform.m_m[1][0],tree.m_transform.m_m[1][1],tree.m_transform.m_m[1][2]);
+    EXPECT_GE(up.length(),0.6f-1e-5f);
+    EXPECT_LE(up.length(),0.8f+1e-5f);
+  }
+}
+
+TEST(Forest, sameForestOnAnyNumberOfThreads)
+{
+  Forest serial = testForest({20.0f,25.0f});
+  serial.m_numThreads = 1;
+  serial.generate();
+  for(size_t threads : {size_t(2), size_t(7)})
+  {
+    Forest parallel = testForest({20.0f,25.0f});
+    parallel.m_numThreads = threads;
+    parallel.generate();
+    EXPECT_EQ(parallel.m_treePrototypes,serial.m_treePrototypes);
+    expectSameTransforms(parallel.m_transformCache,serial.m_transformCache);
+  }
+}
+
+TEST(Forest, thinning)
+{
+  Forest forest;
+  forest.m_thinningStart = 100.0f;
+  forest.m_thinningEnd = 300.0f;
+  forest.m_minDensity = 0.2f;
+  forest.m_thinningFadeBand = 0.1f;
+  //the density falls steadily from 1 at the start of thinning to m_minDensity at its end
+  EXPECT_EQ(forest.thinningDensity(50.0f),1.0f);
+  EXPECT_NEAR(forest.thinningDensity(300.0f),0.2f,1e-6f);
+  EXPECT_NEAR(forest.thinningDensity(1000.0f),0.2f,1e-6f);
+  for(float distance=0.0f; distance<400.0f; distance+=10.0f)
+  {
+    EXPECT_LE(forest.thinningDensity(distance+10.0f),forest.thinningDensity(distance));
+  }
+
+  //importance is uniform over [0,1), so sampling it evenly gives the fractions of trees drawn
+  const size_t numTrees = 100000;
+  float coverageAtFullDensity = 0.0f;
+  for(float density : {1.0f, 0.8f, 0.5f, 0.25f, 0.1f})
+  {
+    size_t whole = 0;
+    size_t drawn = 0;
+    float coverage = 0.0f;
+    float previous = 0.0f;
+    for(size_t i=0; i<numTrees; i++)
+    {
+      float importance = (float(i)+0.5f)/float(numTrees);
+      float scale = forest.thinningScale(importance,density);
+      //more important trees are never drawn smaller
+      EXPECT_GE(scale,previous);
+      previous = scale;
+      whole += scale >= 1.0f/std::sqrt(density)-1e-5f;
+      drawn += scale > 0.0f;
+      coverage += scale*scale;
+    }
+    //a fraction density of the trees are drawn whole, the fade band adds a fraction of that, and the canopy area
+    //stays the same at every density
+    EXPECT_NEAR(float(whole)/numTrees,density,1e-3f);
+    EXPECT_NEAR(float(drawn)/numTrees,std::min(1.0f,density*1.1f),1e-3f);
+    if(density == 1.0f)
+    {
+      coverageAtFullDensity = coverage;
+    }
+    else
+    {
+      EXPECT_NEAR(coverage/numTrees,1.0f+0.1f/3.0f,1e-3f);
+    }
+  }
+  EXPECT_NEAR(coverageAtFullDensity/numTrees,1.0f,1e-6f);
+}
+
+TEST(Forest, cullThinnedTrees)
+{
+  Forest forest = testForest({20.0f});
+  forest.generate();
+  forest.m_thinningStart = 1.0f;
+  forest.m_thinningEnd = 60.0f;
+  forest.m_minDensity = 0.25f;
+
+  //with a scale as MVP the frustum is the box [-40,40] x [-1000,1000] x [-40,40]
+  ngl::Mat4 MVP;
+  MVP.m_00 = 1.0f/40.0f;
+  MVP.m_11 = 1.0f/1000.0f;
+  MVP.m_22 = 1.0f/40.0f;
+  ngl::Vec3 eye(0.0f,0.0f,0.0f);
+  forest.cull(MVP,eye);
+
+  //every tree whose sphere, scaled about its root like the tree, reaches into the frustum is kept, however far the
+  //thinning has grown it past its sphere in the grid
+  Frustum frustum(MVP);
+  std::vector<uint32_t> expected;
+  size_t grown = 0;
+  for(uint32_t i=0; i<forest.m_treeData.size(); i++)
+  {
+    ngl::Vec3 centre = forest.m_treeGrid.m_centres[i];
+    float radius = forest.m_treeGrid.m_radii[i];
+    float scale = forest.thinningScale(forest.m_treeData[i].m_importance,
+                                       forest.thinningDensity((centre-eye).length()));
+    ngl::Vec3 root = forest.m_treeData[i].m_transform.transformPoint(ngl::Vec3(0.0f,0.0f,0.0f));
+    if(scale > 0.0f && frustum.sphereVisible(root+(centre-root)*scale,radius*scale))
+    {
+      expected.push_back(i);
+      grown += !frustum.sphereVisible(centre,radius);
+    }
+  }
+  std::vector<uint32_t> visible = forest.m_visibleTrees;
+  std::sort(visible.begin(),visible.end());
+  EXPECT_EQ(visible,expected);
+  EXPECT_GT(grown,0u);
+  ASSERT_EQ(forest.m_visibleScales.size(),forest.m_visibleTrees.size());
+}
+
+TEST(Forest, lodPrototypesStopAtLODAge)
+{
+  //a hand built tree type with 2 ids and 3 ages, laid out by slot id*3+age as
+  //  0 R (0,0) - exits to X (1,1) and Y (0,2)
+  //  1 Y (0,2) - exits to W (1,2)
+  //  2 Z (1,0)
+  //  3 X (1,1) - exits to Z (1,0)
+  //  4 W (1,2)
+  //so the prototype walks R, X, Z, Y, W with path ages 0, 1, 1, 2, 2. Z is age 0 itself, but hangs off X
+  LSystem treeType("FFFA",{"A=\"[B]////[B]////B","B=&FFFA"},2,0.9f,20,0.9f,3);
+  std::shared_ptr<LSystem::HeroTrees> heroTrees = std::make_shared<LSystem::HeroTrees>();
+  heroTrees->m_exitPoints = {Instance::ExitPoint(1,1,ngl::Mat4()), Instance::ExitPoint(0,2,ngl::Mat4()),
+                             Instance::ExitPoint(1,2,ngl::Mat4()), Instance::ExitPoint(1,0,ngl::Mat4())};
+  std::vector<Instance> instances(5);
+  instances[0].m_numExitPoints = 2;
+  instances[1].m_exitPointStart = 2;
+  instances[1].m_numExitPoints = 1;
+  instances[3].m_exitPointStart = 3;
+  instances[3].m_numExitPoints = 1;
+  heroTrees->m_instanceCache.assign(2,3,{0,1,1,2,3,4,5},std::move(instances));
+  treeType.m_heroTrees = heroTrees;
+
+  Forest forest;
+  forest.m_treeTypes = {treeType};
+  forest.m_numPrototypes = 1;
+  forest.m_lodAge = 2;
+  forest.bakePrototypes();
+  ASSERT_EQ(forest.m_prototypes.size(),1u);
+  ASSERT_EQ(forest.m_prototypes[0].size(),1u);
+  EXPECT_EQ(forest.m_prototypes[0][0].m_slots,std::vector<uint32_t>({0,3,2,1,4}));
+  EXPECT_EQ(forest.m_prototypes[0][0].m_ages,std::vector<uint32_t>({0,1,1,2,2}));
+
+  std::vector<std::vector<uint32_t>> slots = {{0}, {0,3,2}, {0,3,2,1,4}};
+  std::vector<std::vector<uint32_t>> ages = {{0}, {0,1,1}, {0,1,1,2,2}};
+  for(size_t lodAge=0; lodAge<3; lodAge++)
+  {
+    forest.m_lodAge = lodAge;
+    forest.bakeLODPrototypes();
+    ASSERT_EQ(forest.m_lodPrototypes.size(),1u);
+    ASSERT_EQ(forest.m_lodPrototypes[0].size(),1u);
+    const Forest::Prototype &lod = forest.m_lodPrototypes[0][0];
+    EXPECT_EQ(lod.m_slots,slots[lodAge]);
+    EXPECT_EQ(lod.m_ages,ages[lodAge]);
+    EXPECT_EQ(lod.m_transforms.size(),slots[lodAge].size());
+  }
+}